@@ -0,0 +1,127 @@
+/**
+ * @file capture.h
+ *
+ * yamdns -- yet another very simple mdns.
+ * Copyright (C) 2013  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __YAMDNS_CAPTURE_H
+#define __YAMDNS_CAPTURE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/socket.h>
+
+/*------------------------------------------------------------------------*/
+
+/** size of one capture file */
+#define MDNS_CAPTURE_SIZE (16 << 20)
+
+/** number of rotated files */
+#define MDNS_CAPTURE_FILES 4
+
+/** max number of interfaces */
+#define MDNS_CAPTURE_IFACES 16
+
+/** max length of interface name */
+#define MDNS_CAPTURE_IFNAME 64
+
+/*------------------------------------------------------------------------*/
+
+/** received packet */
+#define MDNS_CAPTURE_IN 1
+
+/** sent packet */
+#define MDNS_CAPTURE_OUT 2
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * capture of packets into pcapng files
+ *
+ * Current file is mapped into memory with its full size and blocks are
+ * copied into mapping. When file is full, it is truncated to its blocks
+ * and the next file is started, so files path.0 ... path.N form a ring.
+ * Datagrams are prefixed by IP and UDP headers, so Wireshark decodes them.
+ */
+typedef struct mdns_capture {
+	/** prefix of file names */
+	const char* path;
+
+	/** current file, -1 if capture is closed */
+	int fd;
+
+	/** mapping of current file */
+	uint8_t* map;
+
+	/** length of blocks in current file */
+	size_t pos;
+
+	/** number of current file */
+	unsigned file;
+
+	/** names of interfaces, repeated in each file */
+	char names[MDNS_CAPTURE_IFACES][MDNS_CAPTURE_IFNAME];
+
+	/** number of interfaces */
+	unsigned ifaces;
+
+	/** number of captured packets */
+	unsigned long packets;
+
+	/** number of started files */
+	unsigned long files;
+} mdns_capture_t;
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief start capture into the first file
+ * @param [out] c capture
+ * @param [in] path prefix of file names
+ * @return zero, if successful
+ */
+int mdns_capture_open(mdns_capture_t* c, const char* path);
+
+/**
+ * @brief finish current file
+ * @param [in,out] c capture
+ */
+void mdns_capture_close(mdns_capture_t* c);
+
+/**
+ * @brief describe interface
+ * @param [in,out] c capture
+ * @param [in] name name of interface
+ * @return number of interface or -1
+ */
+int mdns_capture_iface(mdns_capture_t* c, const char* name);
+
+/**
+ * @brief write datagram
+ * @param [in,out] c capture
+ * @param [in] iface number of interface
+ * @param [in] dir MDNS_CAPTURE_IN or MDNS_CAPTURE_OUT
+ * @param [in] src source address, destination is mDNS group of its family
+ * @param [in] ts time of packet, NULL for current time
+ * @param [in] buf datagram
+ * @param [in] len length of datagram
+ * @return zero, if successful
+ */
+int mdns_capture_packet(mdns_capture_t* c, unsigned iface, int dir, const struct sockaddr* src, const struct timespec* ts, const void* buf, size_t len);
+
+#endif /* __YAMDNS_CAPTURE_H */
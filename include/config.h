@@ -0,0 +1,58 @@
+/**
+ * @file config.h
+ *
+ * yamdns -- yet another very simple mdns.
+ * Copyright (C) 2013  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __YAMDNS_CONFIG_H
+#define __YAMDNS_CONFIG_H
+
+#include "records.h"
+
+/**
+ * @brief load services from config file into table
+ * @param [in,out] t table of records
+ * @param [in] path path to config file
+ * @param [in] host dotted host name, target of services
+ * @return zero, if successful
+ *
+ * One service per line, empty lines and lines started with '#' are ignored:
+ * @code
+ * # instance     type       port  TXT strings...
+ * "My Printer"   _ipp._tcp  631   txtvers=1 rp=printers/a
+ * @endcode
+ */
+int mdns_config_load(mdns_records_t* t, const char* path, const char* host);
+
+/**
+ * @brief start watching for changes of config file
+ * @param [in] path path to config file
+ * @return inotify descriptor or -1
+ *
+ * Directory of file is watched, so replacing of file by rename() is detected too.
+ */
+int mdns_config_watch(const char* path);
+
+/**
+ * @brief read pending inotify events
+ * @param [in] fd inotify descriptor
+ * @param [in] path path to config file
+ * @return non zero, if config file was changed
+ */
+int mdns_config_changed(int fd, const char* path);
+
+#endif /* __YAMDNS_CONFIG_H */
@@ -21,6 +21,149 @@
 #ifndef __DUMP_H
 #define __DUMP_H
 
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/socket.h>
+
+/*------------------------------------------------------------------------*/
+
+/** max number of names and types of filter */
+#define MDNS_DUMP_FILTER_MAX 16
+
+/** received packet */
+#define MDNS_DUMP_IN 1
+
+/** sent packet */
+#define MDNS_DUMP_OUT 2
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * output of dump
+ *
+ * Text is formatted into buffer and written to descriptor by flush, so
+ * dump of one packet is one write(). Without descriptor text is only kept
+ * in buffer, text beyond its size is lost.
+ */
+typedef struct mdns_dump {
+	/** buffer supplied by caller */
+	char* buf;
+
+	/** size of buffer */
+	size_t size;
+
+	/** length of text */
+	size_t len;
+
+	/** output descriptor or -1 */
+	int fd;
+} mdns_dump_t;
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * filter of dumped packets
+ *
+ * Empty lists and zero fields match everything. Only records and questions
+ * of listed names and types are dumped, packet without them is skipped.
+ */
+typedef struct mdns_dump_filter {
+	/** dotted names, subdomains match too */
+	const char* names[MDNS_DUMP_FILTER_MAX];
+
+	/** number of names */
+	unsigned names_count;
+
+	/** types of records and questions */
+	uint16_t types[MDNS_DUMP_FILTER_MAX];
+
+	/** number of types */
+	unsigned types_count;
+
+	/** mask of MDNS_DUMP_IN and MDNS_DUMP_OUT */
+	int dir;
+
+	/** source address of received packets, AF_UNSPEC for any */
+	struct sockaddr_storage source;
+} mdns_dump_filter_t;
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief initialize output
+ * @param [out] d output
+ * @param [in] buf buffer for text
+ * @param [in] size size of buffer
+ * @param [in] fd output descriptor or -1
+ */
+void mdns_dump_init(mdns_dump_t* d, char* buf, size_t size, int fd);
+
+/**
+ * @brief put text as is
+ * @param [in,out] d output
+ * @param [in] str text
+ * @param [in] len length of text
+ */
+void mdns_dump_write(mdns_dump_t* d, const char* str, size_t len);
+
+/**
+ * @brief format text
+ * @param [in,out] d output
+ * @param [in] fmt format like printf()
+ */
+void mdns_dump_printf(mdns_dump_t* d, const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+
+/**
+ * @brief put printable characters of buffer
+ * @param [in,out] d output
+ * @param [in] buf pointer to buffer
+ * @param [in] len length
+ */
+void mdns_dump_str(mdns_dump_t* d, const void* buf, size_t len);
+
+/**
+ * @brief put hexdump
+ * @param [in,out] d output
+ * @param [in] buf pointer to data
+ * @param [in] len length of data
+ */
+void mdns_dump_hex(mdns_dump_t* d, const void* buf, size_t len);
+
+/**
+ * @brief write text to descriptor
+ * @param [in,out] d output
+ * @return zero, if successful
+ */
+int mdns_dump_flush(mdns_dump_t* d);
+
+/**
+ * @brief check source and direction of packet
+ * @param [in] f filter or NULL
+ * @param [in] dir MDNS_DUMP_IN, MDNS_DUMP_OUT or zero if unknown
+ * @param [in] from source address or NULL
+ * @return non zero, if packet can be dumped
+ */
+int mdns_dump_filter_packet(const mdns_dump_filter_t* f, int dir, const struct sockaddr* from);
+
+/**
+ * @brief check name and type of record or question
+ * @param [in] f filter or NULL
+ * @param [in] name dotted name
+ * @param [in] type type of record
+ * @return non zero, if record can be dumped
+ */
+int mdns_dump_filter_record(const mdns_dump_filter_t* f, const char* name, uint16_t type);
+
+/**
+ * @brief add condition to filter
+ * @param [in,out] f filter
+ * @param [in] arg in, out, from=address, type=name or number, or dotted name
+ * @return zero, if successful
+ */
+int mdns_dump_filter_add(mdns_dump_filter_t* f, const char* arg);
+
+/*------------------------------------------------------------------------*/
+
 /**
  * @brief print pritable characters of buffer
  * @param [in] str pointer to buffer
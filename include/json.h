@@ -0,0 +1,65 @@
+/**
+ * @file json.h
+ *
+ * yamdns -- yet another very simple mdns.
+ * Copyright (C) 2013  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __YAMDNS_JSON_H
+#define __YAMDNS_JSON_H
+
+#include <time.h>
+#include <sys/socket.h>
+
+#include "dump.h"
+
+/*------------------------------------------------------------------------*/
+
+/** origin of decoded packet */
+typedef struct mdns_json_source {
+	/** time of packet */
+	struct timespec ts;
+
+	/** number of interface */
+	unsigned iface;
+
+	/** MDNS_DUMP_IN, MDNS_DUMP_OUT or zero if unknown */
+	int dir;
+
+	/** source address or NULL */
+	const struct sockaddr* from;
+} mdns_json_source_t;
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief write NDJSON events of packet, one object per question and record
+ * @param [in,out] d output, written once per packet
+ * @param [in] f filter or NULL, see mdns_packet_dump_to()
+ * @param [in] src origin of packet
+ * @param [in] buf packet
+ * @param [in] len length of packet
+ * @return number of objects
+ *
+ * Every object has fields of packet: time, iface, dir, from, port, id and
+ * flags, then section, name, type, type_name and class. Questions add
+ * unicast, records add flush, ttl and rdata with fields of their type.
+ * Malformed packet ends with object of error and length. Output is valid
+ * UTF-8, bytes of names and strings, which are not, are escaped as \u00XX.
+ */
+unsigned mdns_json_packet(mdns_dump_t* d, const mdns_dump_filter_t* f, const mdns_json_source_t* src, const void* buf, size_t len);
+
+#endif /* __YAMDNS_JSON_H */
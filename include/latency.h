@@ -0,0 +1,134 @@
+/**
+ * @file latency.h
+ *
+ * yamdns -- yet another very simple mdns.
+ * Copyright (C) 2013  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __YAMDNS_LATENCY_H
+#define __YAMDNS_LATENCY_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+/*------------------------------------------------------------------------*/
+
+/** sub-buckets of each power of two, precision is 1/16 */
+#define MDNS_HIST_SUB_BITS 4
+
+/** values from 2^MDNS_HIST_MAGNITUDES ns, about 18 minutes, share the last bucket */
+#define MDNS_HIST_MAGNITUDES 40
+
+/** number of counters */
+#define MDNS_HIST_BUCKETS ((MDNS_HIST_MAGNITUDES - MDNS_HIST_SUB_BITS + 1) << MDNS_HIST_SUB_BITS)
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * log-linear histogram of nanoseconds
+ *
+ * Values below 2^MDNS_HIST_SUB_BITS are counted exactly. Each next power
+ * of two is split into 2^MDNS_HIST_SUB_BITS equal buckets, so relative
+ * error of any value is below 1/16, like in HDR histogram.
+ */
+typedef struct mdns_hist {
+	/** number of values */
+	uint64_t count;
+
+	/** max value */
+	uint64_t max;
+
+	/** counters */
+	uint32_t buckets[MDNS_HIST_BUCKETS];
+} mdns_hist_t;
+
+/*------------------------------------------------------------------------*/
+
+/** stages of query inside daemon */
+typedef struct mdns_latency {
+	/** from kernel timestamp to processing */
+	mdns_hist_t queue;
+
+	/** parsing of packet without handlers */
+	mdns_hist_t parse;
+
+	/** search of answers */
+	mdns_hist_t lookup;
+
+	/** building of response packets */
+	mdns_hist_t build;
+
+	/** from kernel timestamp to transmit handler */
+	mdns_hist_t total;
+} mdns_latency_t;
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief record value
+ * @param [in,out] h histogram
+ * @param [in] ns value in nanoseconds
+ */
+void mdns_hist_record(mdns_hist_t* h, uint64_t ns);
+
+/**
+ * @brief find value at percentile
+ * @param [in] h histogram
+ * @param [in] p percentile, from 0 to 100
+ * @return the highest value equivalent to bucket of percentile
+ */
+uint64_t mdns_hist_percentile(const mdns_hist_t* h, double p);
+
+/**
+ * @brief print summary of all stages
+ * @param [in] l latencies
+ * @param [in] f output stream
+ */
+void mdns_latency_print(const mdns_latency_t* l, FILE* f);
+
+/**
+ * @brief read clock of stages
+ * @return monotonic time in nanoseconds
+ */
+static inline uint64_t mdns_latency_clock(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return(ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+}
+
+/**
+ * @brief elapsed time since kernel timestamp
+ * @param [in] stamp SO_TIMESTAMPNS of packet
+ * @return nanoseconds, zero if clock was stepped back
+ */
+static inline uint64_t mdns_latency_since(const struct timespec* stamp)
+{
+	struct timespec ts;
+	int64_t ns;
+
+	/* kernel timestamps are wall clock */
+	clock_gettime(CLOCK_REALTIME, &ts);
+
+	ns = (int64_t)(ts.tv_sec - stamp->tv_sec) * 1000000000LL + ts.tv_nsec - stamp->tv_nsec;
+
+	return(ns > 0 ? ns : 0);
+}
+
+#endif /* __YAMDNS_LATENCY_H */
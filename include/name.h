@@ -0,0 +1,98 @@
+/**
+ * @file name.h
+ *
+ * yamdns -- yet another very simple mdns.
+ * Copyright (C) 2013  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __YAMDNS_NAME_H
+#define __YAMDNS_NAME_H
+
+#include <yamdns/type.h>
+
+/*------------------------------------------------------------------------*/
+
+/** max number of labels, each takes at least two octets */
+#define MDNS_MAX_LABELS (MDNS_MAX_NAME / 2)
+
+/**
+ * name in wire format with offsets of its labels
+ *
+ * Comparison ignores ASCII case only, as DNS does. Length octets are
+ * below 'A', so they are compared together with labels.
+ */
+typedef struct mdns_name {
+	/** hash of dotted name, see mdns_name_hash() */
+	uint32_t hash;
+
+	/** length of wire with terminating zero */
+	uint16_t len;
+
+	/** number of labels */
+	uint16_t count;
+
+	/** offsets of length octets of labels in wire */
+	uint8_t labels[MDNS_MAX_LABELS];
+
+	/** uncompressed encoded name */
+	uint8_t wire[MDNS_MAX_NAME];
+} mdns_name_t;
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief encode dotted name into labels
+ * @param [out] buf buffer for encoded name
+ * @param [in] size size of buffer
+ * @param [in] dotted dotted name, last dot is optional
+ * @return length of encoded name, zero if name is invalid or buffer is too small
+ */
+size_t mdns_name_wire(void* buf, size_t size, const char* dotted);
+
+/**
+ * @brief parse dotted name
+ * @param [out] n name
+ * @param [in] dotted dotted name, last dot is optional
+ * @return zero, if successful
+ */
+int mdns_name_parse(mdns_name_t* n, const char* dotted);
+
+/**
+ * @brief check whether name is suffix itself or its subdomain
+ * @param [in] n name
+ * @param [in] suffix parent name
+ * @return non zero, if suffix matches whole labels of name
+ */
+int mdns_name_suffix(const mdns_name_t* n, const mdns_name_t* suffix);
+
+/**
+ * @brief compare memory ignoring ASCII case
+ * @param [in] a the first buffer
+ * @param [in] b the second buffer
+ * @param [in] len length of buffers
+ * @return non zero, if buffers are equal
+ */
+int mdns_name_caseeq(const void* a, const void* b, size_t len);
+
+/**
+ * @brief compare dotted names ignoring ASCII case
+ * @param [in] a the first name
+ * @param [in] b the second name
+ * @return zero, if names are equal
+ */
+int mdns_name_casecmp(const char* a, const char* b);
+
+#endif /* __YAMDNS_NAME_H */
@@ -22,6 +22,42 @@
 #define __YAMDNS_NETWORK_H
 
 #include <arpa/inet.h>
+#include <time.h>
+#include <sys/socket.h>
+
+#include <yamdns/define.h>
+
+/** max number of packets in one batch */
+#ifndef MDNS_BATCH_MAX
+#define MDNS_BATCH_MAX 64
+#endif
+
+/** batch of outgoing packets, sent by one sendmmsg() */
+typedef struct mdns_batch {
+	/** socket descriptor */
+	int sockfd;
+
+	/** multicast group of socket family */
+	union {
+		struct sockaddr_in sin;
+		struct sockaddr_in6 sin6;
+	} to;
+
+	/** length of group address */
+	socklen_t to_len;
+
+	/** number of queued packets */
+	unsigned count;
+
+	/** headers for sendmmsg() */
+	struct mmsghdr msgs[MDNS_BATCH_MAX];
+
+	/** data of packets */
+	struct iovec iov[MDNS_BATCH_MAX];
+
+	/** copies of packets */
+	uint8_t bufs[MDNS_BATCH_MAX][MDNS_MAX_PACKET];
+} mdns_batch_t;
 
 /**
  * @brief create and bind socket for mdns
@@ -31,6 +67,24 @@
  */
 int mdns_socket(struct in_addr ifaddr, int timeout);
 
+/**
+ * @brief create and bind IPv6 socket for mdns
+ * @param [in] ifindex interface index
+ * @param [in] timeout default timeout for socket read ops
+ * @return socket descriptor or -1
+ *
+ * Socket is IPv6 only, so IPv4 traffic is left to socket of mdns_socket().
+ */
+int mdns_socket6(unsigned ifindex, int timeout);
+
+/**
+ * @brief close IPv6 mdns socket
+ * @param [in] ifindex interface index
+ * @param [in] sockfd socket desctriptor
+ * @return zero, if successful
+ */
+int mdns_close6(unsigned ifindex, int sockfd);
+
 /**
  * @brief close mdns socket
  * @param [in] ifaddr interface address
@@ -39,6 +93,19 @@ int mdns_socket(struct in_addr ifaddr, int timeout);
  */
 int mdns_close(struct in_addr ifaddr, int sockfd);
 
+/**
+ * @brief receive mDNS packet with kernel drop counter and timestamp
+ * @param [in] sockfd socket desctriptor
+ * @param [out] buf buffer of packet
+ * @param [in] len size of buffer
+ * @param [out] from source address, sockaddr_in or sockaddr_in6
+ * @param [in] from_len size of source address
+ * @param [out] drops counter of datagrams dropped by kernel, kept if absent
+ * @param [out] stamp kernel receive time, SO_TIMESTAMPNS, kept if absent
+ * @return the same as recvmsg()
+ */
+int mdns_recv(int sockfd, void* buf, size_t len, void* from, socklen_t from_len, uint32_t* drops, struct timespec* stamp);
+
 /**
  * @brief send mDNS packet
  * @param [in] sockfd socket desctriptor
@@ -48,4 +115,29 @@ int mdns_close(struct in_addr ifaddr, int sockfd);
  */
 int mdns_send(int sockfd, void* buf, size_t len);
 
+/**
+ * @brief initialize empty batch
+ * @param [out] b batch
+ * @param [in] sockfd socket desctriptor
+ *
+ * Packets are sent to multicast group of socket family.
+ */
+void mdns_batch_init(mdns_batch_t* b, int sockfd);
+
+/**
+ * @brief queue copy of mDNS packet, full batch is sent
+ * @param [in,out] b batch
+ * @param [in] buf pointer to packet
+ * @param [in] len length of packet
+ * @return length of packet or -1
+ */
+int mdns_batch_add(mdns_batch_t* b, const void* buf, size_t len);
+
+/**
+ * @brief send all queued packets
+ * @param [in,out] b batch
+ * @return number of sent packets or -1
+ */
+int mdns_batch_flush(mdns_batch_t* b);
+
 #endif /* __YAMDNS_NETWORK_H */
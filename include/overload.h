@@ -0,0 +1,136 @@
+/**
+ * @file overload.h
+ *
+ * yamdns -- yet another very simple mdns.
+ * Copyright (C) 2013  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __YAMDNS_OVERLOAD_H
+#define __YAMDNS_OVERLOAD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*------------------------------------------------------------------------*/
+
+/** number of token buckets, power of two */
+#ifndef MDNS_OVERLOAD_SOURCES
+#define MDNS_OVERLOAD_SOURCES 256
+#endif
+
+/** queries per second of one source */
+#define MDNS_OVERLOAD_RATE 20
+
+/** max burst of queries of one source */
+#define MDNS_OVERLOAD_BURST 40
+
+/** number of receiving sockets, each has own drop counter */
+#define MDNS_OVERLOAD_SOCKETS 2
+
+/*------------------------------------------------------------------------*/
+
+/** token bucket of source address */
+typedef struct mdns_overload_bucket {
+	/** hash of address, zero if bucket is free */
+	uint32_t hash;
+
+	/** tokens in thousandths of query */
+	uint32_t tokens;
+
+	/** time of last refill in milliseconds */
+	uint64_t last;
+} mdns_overload_bucket_t;
+
+/*------------------------------------------------------------------------*/
+
+/** shedding decisions */
+typedef struct mdns_overload_stats {
+	/** datagrams dropped by kernel, SO_RXQ_OVFL */
+	unsigned long drops;
+
+	/** queries over rate of their source */
+	unsigned long limited;
+
+	/** unanswered browsing and enumeration questions */
+	unsigned long shed_browse;
+
+	/** unanswered repeated queries */
+	unsigned long shed_repeats;
+} mdns_overload_stats_t;
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * overload protection
+ *
+ * Daemon is under pressure for a while after kernel drops datagrams.
+ * Queries of source over its rate and all queries under pressure are
+ * answered without low-value work, but host names and reverse names are
+ * answered always.
+ */
+typedef struct mdns_overload {
+	/** sets of buckets indexed by hash of address */
+	mdns_overload_bucket_t buckets[MDNS_OVERLOAD_SOURCES];
+
+	/** last values of kernel drop counters of sockets */
+	uint32_t counters[MDNS_OVERLOAD_SOCKETS];
+
+	/** end of pressure in milliseconds */
+	uint64_t pressure;
+
+	/** counters */
+	mdns_overload_stats_t stats;
+} mdns_overload_t;
+
+/*------------------------------------------------------------------------*/
+
+/** queries are answered completely */
+#define MDNS_SHED_NONE 0
+
+/** browsing and enumeration are not answered */
+#define MDNS_SHED_BROWSE 1
+
+/** repeated queries are not answered too */
+#define MDNS_SHED_REPEATS 2
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief initialize protection without pressure
+ * @param [out] o protection
+ */
+void mdns_overload_init(mdns_overload_t* o);
+
+/**
+ * @brief account kernel drop counter
+ * @param [in,out] o protection
+ * @param [in] socket index of receiving socket, less than MDNS_OVERLOAD_SOCKETS
+ * @param [in] counter value of SO_RXQ_OVFL of received datagram
+ * @param [in] now current time in milliseconds
+ */
+void mdns_overload_drops(mdns_overload_t* o, unsigned socket, uint32_t counter, uint64_t now);
+
+/**
+ * @brief take token of source for query
+ * @param [in,out] o protection
+ * @param [in] addr source address
+ * @param [in] len length of address
+ * @param [in] now current time in milliseconds
+ * @return MDNS_SHED_NONE, MDNS_SHED_BROWSE or MDNS_SHED_REPEATS
+ */
+int mdns_overload_admit(mdns_overload_t* o, const void* addr, size_t len, uint64_t now);
+
+#endif /* __YAMDNS_OVERLOAD_H */
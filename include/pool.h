@@ -0,0 +1,126 @@
+/**
+ * @file pool.h
+ *
+ * yamdns -- yet another very simple mdns.
+ * Copyright (C) 2013  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __YAMDNS_POOL_H
+#define __YAMDNS_POOL_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/*------------------------------------------------------------------------*/
+
+/** kinds of dynamic memory, each has its own pool in static build */
+enum {
+	/** tables of records: arrays, hash buckets, names and rdata */
+	MDNS_POOL_RECORDS,
+
+	/** queue of probes and announcements */
+	MDNS_POOL_PROBES,
+
+	/** answers of service type enumeration */
+	MDNS_POOL_SERVICES,
+
+	/** ranges of reverse names */
+	MDNS_POOL_REVERSE,
+
+	MDNS_POOL_COUNT,
+};
+
+/*------------------------------------------------------------------------*/
+
+#ifdef MDNS_STATIC
+
+/** records of all tables together */
+#ifndef MDNS_STATIC_RECORDS
+#define MDNS_STATIC_RECORDS 512
+#endif
+
+/** bytes of names and rdata of all tables together */
+#ifndef MDNS_STATIC_NAMES
+#define MDNS_STATIC_NAMES (32 << 10)
+#endif
+
+/** probes and announcements waiting in queue */
+#ifndef MDNS_STATIC_PROBES
+#define MDNS_STATIC_PROBES 16
+#endif
+
+/** service types */
+#ifndef MDNS_STATIC_SERVICES
+#define MDNS_STATIC_SERVICES 32
+#endif
+
+/** ranges of reverse names */
+#ifndef MDNS_STATIC_RANGES
+#define MDNS_STATIC_RANGES 16
+#endif
+
+/**
+ * @brief allocate memory from pool in .bss
+ * @param [in] kind MDNS_POOL_*
+ * @param [in] size size of memory
+ * @return pointer or NULL, if pool is exhausted
+ */
+void* mdns_pool_alloc(unsigned kind, size_t size);
+
+/**
+ * @brief allocate zeroed memory from pool
+ * @param [in] kind MDNS_POOL_*
+ * @param [in] n number of elements
+ * @param [in] size size of element
+ * @return pointer or NULL, if pool is exhausted
+ */
+void* mdns_pool_calloc(unsigned kind, size_t n, size_t size);
+
+/**
+ * @brief change size of memory
+ * @param [in] kind MDNS_POOL_*, used if ptr is NULL
+ * @param [in] ptr memory of pool or NULL
+ * @param [in] size new size
+ * @return pointer or NULL, if pool is exhausted and ptr is untouched
+ */
+void* mdns_pool_realloc(unsigned kind, void* ptr, size_t size);
+
+/**
+ * @brief return memory to its pool
+ * @param [in] ptr memory of pool or NULL
+ */
+void mdns_pool_free(void* ptr);
+
+#else
+
+#define mdns_pool_alloc(kind, size) malloc(size)
+#define mdns_pool_calloc(kind, n, size) calloc(n, size)
+#define mdns_pool_realloc(kind, ptr, size) realloc(ptr, size)
+#define mdns_pool_free(ptr) free(ptr)
+
+#endif /* MDNS_STATIC */
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief print capacities and usage of pools and size of static memory
+ * @param [in] f output
+ *
+ * In static build this is worst case of RAM besides stack and libc.
+ */
+void mdns_pool_report(FILE* f);
+
+#endif /* __YAMDNS_POOL_H */
@@ -0,0 +1,128 @@
+/**
+ * @file proxy.h
+ *
+ * yamdns -- yet another very simple mdns.
+ * Copyright (C) 2013  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __YAMDNS_PROXY_H
+#define __YAMDNS_PROXY_H
+
+#include <netinet/in.h>
+
+#include "records.h"
+
+/*------------------------------------------------------------------------*/
+
+/** max number of designated hosts */
+#ifndef MDNS_PROXY_OWNERS
+#define MDNS_PROXY_OWNERS 16
+#endif
+
+/*------------------------------------------------------------------------*/
+
+/** designated host and its snooped records */
+typedef struct mdns_proxy_owner {
+	/** address of host */
+	struct in_addr addr;
+
+	/** unique records announced by host, TTL is kept as time of expiry in seconds */
+	mdns_records_t recs;
+
+	/** time of last packet from host in milliseconds */
+	uint64_t seen;
+
+	/** time of first unanswered query about host records, zero if none */
+	uint64_t asked;
+
+	/** host doesn't answer, its records are answered by proxy */
+	int asleep;
+} mdns_proxy_owner_t;
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * proxy of sleeping hosts
+ *
+ * Host is asleep when it has not sent anything for a second after query
+ * about its records, and it is awake again with its first packet.
+ */
+typedef struct mdns_proxy {
+	/** designated hosts */
+	mdns_proxy_owner_t owners[MDNS_PROXY_OWNERS];
+
+	/** number of hosts */
+	unsigned count;
+} mdns_proxy_t;
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief initialize proxy without hosts
+ * @param [out] p proxy
+ */
+void mdns_proxy_init(mdns_proxy_t* p);
+
+/**
+ * @brief release records of all hosts
+ * @param [in,out] p proxy
+ */
+void mdns_proxy_free(mdns_proxy_t* p);
+
+/**
+ * @brief designate host, whose records are snooped
+ * @param [in,out] p proxy
+ * @param [in] addr address of host
+ * @return zero, if successful
+ */
+int mdns_proxy_owner(mdns_proxy_t* p, struct in_addr addr);
+
+/**
+ * @brief learn records from packet of designated host
+ * @param [in,out] p proxy
+ * @param [in] from source address of packet, NULL if it isn't IPv4, then host is found by its address record
+ * @param [in] buf packet
+ * @param [in] len length of packet
+ * @param [in] now current time in milliseconds
+ * @return non zero, if answers of proxy are changed
+ */
+int mdns_proxy_snoop(mdns_proxy_t* p, const struct in_addr* from, const void* buf, size_t len, uint64_t now);
+
+/**
+ * @brief put to sleep hosts, which left query unanswered, expire records
+ * @param [in,out] p proxy
+ * @param [in] now current time in milliseconds
+ * @return non zero, if answers of proxy are changed
+ */
+int mdns_proxy_update(mdns_proxy_t* p, uint64_t now);
+
+/**
+ * @brief get remaining time to live of snooped record
+ * @param [in] rec record of host
+ * @param [in] now current time in milliseconds
+ * @return time to live in seconds
+ */
+uint32_t mdns_proxy_ttl(const mdns_record_t* rec, uint64_t now);
+
+/**
+ * @brief check if any host has records with name of this hash
+ * @param [in] p proxy
+ * @param [in] hash hash of name
+ * @return non zero, if such records can be present
+ */
+int mdns_proxy_has_hash(const mdns_proxy_t* p, uint32_t hash);
+
+#endif /* __YAMDNS_PROXY_H */
@@ -0,0 +1,271 @@
+/**
+ * @file records.h
+ *
+ * yamdns -- yet another very simple mdns.
+ * Copyright (C) 2013  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __YAMDNS_RECORDS_H
+#define __YAMDNS_RECORDS_H
+
+#include <yamdns/type.h>
+
+/*------------------------------------------------------------------------*/
+
+/** end of hash chain */
+#define MDNS_RECORDS_NONE 0xffffffff
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * owned resource record
+ *
+ * Names and rdata are kept as offsets into pool of table,
+ * so records don't depend on address of table memory.
+ */
+typedef struct mdns_record {
+	/** hash of owner name, see mdns_name_hash() */
+	uint32_t hash;
+
+	/** index of next record in hash chain */
+	uint32_t next;
+
+	/** hash of owner name, type and rdata */
+	uint32_t ident;
+
+	/** index of next record in identity hash chain */
+	uint32_t inext;
+
+	/** offset of dotted owner name in pool */
+	uint32_t name;
+
+	/** offset of encoded rdata in pool */
+	uint32_t rdata;
+
+	/** time to live */
+	uint32_t ttl;
+
+	/** resource type */
+	uint16_t type;
+
+	/** length of rdata */
+	uint16_t rd_len;
+} mdns_record_t;
+
+/*------------------------------------------------------------------------*/
+
+/** table of owned resource records */
+typedef struct mdns_records {
+	/** array of records */
+	mdns_record_t* recs;
+
+	/** number of records */
+	uint32_t count;
+
+	/** allocated size of recs */
+	uint32_t size;
+
+	/** heads of hash chains, followed by heads of identity hash chains */
+	uint32_t* buckets;
+
+	/** number of buckets, power of two */
+	uint32_t nbuckets;
+
+	/** names and rdata */
+	char* pool;
+
+	/** used size of pool */
+	uint32_t pool_len;
+
+	/** allocated size of pool */
+	uint32_t pool_size;
+
+	/** size of pool occupied by removed records */
+	uint32_t pool_garbage;
+
+	/** mapping of database file, table is read only if not NULL */
+	void* map;
+
+	/** length of mapping */
+	size_t map_len;
+} mdns_records_t;
+
+/*------------------------------------------------------------------------*/
+
+/** magic of records database file */
+#define MDNS_DB_MAGIC "YAMDNSDB"
+
+/** version of records database file format */
+#define MDNS_DB_VERSION 1
+
+/**
+ * header of records database file
+ *
+ * Database is a dump of mdns_records_t in host byte order:
+ * header, array of records, hash buckets and pool,
+ * each part is aligned by 8 bytes.
+ */
+typedef struct mdns_db_hdr {
+	/** MDNS_DB_MAGIC without zero byte */
+	char magic[8];
+
+	/** MDNS_DB_VERSION */
+	uint32_t version;
+
+	/** size of mdns_record_t, detects incompatible builds */
+	uint32_t rec_size;
+
+	/** number of records */
+	uint32_t count;
+
+	/** number of hash buckets, buckets part has twice more heads */
+	uint32_t nbuckets;
+
+	/** length of pool */
+	uint32_t pool_len;
+
+	/** offset of records array */
+	uint32_t recs;
+
+	/** offset of hash buckets */
+	uint32_t buckets;
+
+	/** offset of pool */
+	uint32_t pool;
+} mdns_db_hdr_t;
+
+/*------------------------------------------------------------------------*/
+
+/** return dotted owner name of record */
+#define mdns_record_name(t, r) ((const char*)&(t)->pool[(r)->name])
+
+/** return encoded rdata of record */
+#define mdns_record_rdata(t, r) ((const void*)&(t)->pool[(r)->rdata])
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief initialize empty table
+ * @param [out] t table of records
+ */
+void mdns_records_init(mdns_records_t* t);
+
+/**
+ * @brief release memory of table
+ * @param [in,out] t table of records
+ */
+void mdns_records_free(mdns_records_t* t);
+
+/**
+ * @brief add record into table
+ * @param [in,out] t table of records
+ * @param [in] name dotted owner name
+ * @param [in] type resource type
+ * @param [in] ttl time to live
+ * @param [in] rdata encoded rdata
+ * @param [in] rd_len length of rdata
+ * @return zero, if successful
+ *
+ * Adding of already present record is successful and does nothing.
+ */
+int mdns_records_add(mdns_records_t* t, const char* name, uint16_t type, uint32_t ttl, const void* rdata, size_t rd_len);
+
+/**
+ * @brief remove record from table
+ * @param [in,out] t table of records
+ * @param [in] r record of this table
+ * @return zero, if successful
+ *
+ * Last record of table takes place of removed one, so pointers
+ * to records of table are invalidated.
+ */
+int mdns_records_remove(mdns_records_t* t, const mdns_record_t* r);
+
+/**
+ * @brief add DNS-SD service records (PTR, SRV and TXT) into table
+ * @param [in,out] t table of records
+ * @param [in] instance name of service instance, example "My Printer"
+ * @param [in] service service type, example "_ipp._tcp"
+ * @param [in] port port of service
+ * @param [in] host dotted target host name
+ * @param [in] txt encoded TXT rdata
+ * @param [in] txt_len length of txt
+ * @return zero, if successful
+ */
+int mdns_records_add_service(mdns_records_t* t, const char* instance, const char* service, uint16_t port, const char* host, const void* txt, size_t txt_len);
+
+/**
+ * @brief find records by owner name
+ * @param [in] t table of records
+ * @param [in] hash hash of name
+ * @param [in] name dotted owner name
+ * @param [in] prev previous found record or NULL to start search
+ * @return next record with this owner name or NULL
+ */
+const mdns_record_t* mdns_records_find(const mdns_records_t* t, uint32_t hash, const char* name, const mdns_record_t* prev);
+
+/**
+ * @brief check if table has records with owner name of this hash
+ * @param [in] t table of records
+ * @param [in] hash hash of name
+ * @return non zero, if such records can be present
+ *
+ * Names are not compared, so it is a fast negative check.
+ */
+int mdns_records_has_hash(const mdns_records_t* t, uint32_t hash);
+
+/**
+ * @brief find record by owner, type and rdata
+ * @param [in] t table of records
+ * @param [in] name dotted owner name with last dot
+ * @param [in] type resource type
+ * @param [in] rdata encoded rdata
+ * @param [in] rd_len length of rdata
+ * @return found record or NULL
+ */
+const mdns_record_t* mdns_records_get(const mdns_records_t* t, const char* name, uint16_t type, const void* rdata, size_t rd_len);
+
+/**
+ * @brief find the same record (owner, type and rdata) from another table
+ * @param [in] t table of records
+ * @param [in] from table of r
+ * @param [in] r record for search
+ * @return found record or NULL
+ */
+const mdns_record_t* mdns_records_match(const mdns_records_t* t, const mdns_records_t* from, const mdns_record_t* r);
+
+/**
+ * @brief write table into database file
+ * @param [in] t table of records
+ * @param [in] path path to database file
+ * @return zero, if successful
+ *
+ * File is replaced atomically by rename().
+ */
+int mdns_records_save(const mdns_records_t* t, const char* path);
+
+/**
+ * @brief map database file as read only table
+ * @param [out] t table of records
+ * @param [in] path path to database file
+ * @return zero, if successful
+ *
+ * Records are served directly from mapped file, mdns_records_free()
+ * unmaps it.
+ */
+int mdns_records_map(mdns_records_t* t, const char* path);
+
+#endif /* __YAMDNS_RECORDS_H */
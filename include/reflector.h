@@ -0,0 +1,164 @@
+/**
+ * @file reflector.h
+ *
+ * yamdns -- yet another very simple mdns.
+ * Copyright (C) 2013  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __YAMDNS_REFLECTOR_H
+#define __YAMDNS_REFLECTOR_H
+
+#include <yamdns/type.h>
+
+#include "name.h"
+
+/*------------------------------------------------------------------------*/
+
+/** max number of interfaces */
+#ifndef MDNS_REFLECT_IFACES
+#define MDNS_REFLECT_IFACES 8
+#endif
+
+/** max number of service types */
+#define MDNS_REFLECT_TYPES 32
+
+/** number of entries of duplicate cache, power of two */
+#ifndef MDNS_REFLECT_CACHE
+#define MDNS_REFLECT_CACHE 1024
+#endif
+
+/** max number of target hosts of forwarded services */
+#ifndef MDNS_REFLECT_HOSTS
+#define MDNS_REFLECT_HOSTS 64
+#endif
+
+/*------------------------------------------------------------------------*/
+
+/** type of send handler, packet is sent to interface */
+typedef int (*mdns_reflect_handler)(void* ctx, unsigned iface, const void* buf, size_t len);
+
+/*------------------------------------------------------------------------*/
+
+/** recently forwarded question or record */
+typedef struct mdns_reflect_entry {
+	/** 64-bit FNV-1a of name, type and rdata */
+	uint64_t key;
+
+	/** time of expiration in milliseconds */
+	uint64_t expires;
+} mdns_reflect_entry_t;
+
+/*------------------------------------------------------------------------*/
+
+/** counters of reflector */
+typedef struct mdns_reflect_stats {
+	/** received packets */
+	unsigned long in;
+
+	/** sent packets, a copy per interface */
+	unsigned long out;
+
+	/** forwarded questions and records */
+	unsigned long forwarded;
+
+	/** questions and records seen recently */
+	unsigned long duplicates;
+
+	/** questions and records of other types */
+	unsigned long filtered;
+} mdns_reflect_stats_t;
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * reflector of mDNS between interfaces
+ *
+ * Packets are rebuilt from questions and records that pass filter of
+ * service types and were not forwarded recently. Records of queries are
+ * known answers of one link and are not forwarded. The same cache stops
+ * loops through another reflector.
+ */
+typedef struct mdns_reflector {
+	/** number of interfaces */
+	unsigned ifaces;
+
+	/** send handler */
+	mdns_reflect_handler send;
+
+	/** context of send handler */
+	void* send_ctx;
+
+	/** names of forwarded service types, every type if empty */
+	mdns_name_t types[MDNS_REFLECT_TYPES];
+
+	/** number of types */
+	unsigned types_count;
+
+	/** target hosts of forwarded services, their addresses pass too */
+	mdns_reflect_entry_t hosts[MDNS_REFLECT_HOSTS];
+
+	/** recently forwarded questions and records */
+	mdns_reflect_entry_t cache[MDNS_REFLECT_CACHE];
+
+	/** counters */
+	mdns_reflect_stats_t stats;
+
+	/** time of processing in milliseconds */
+	uint64_t now;
+
+	/** interface of processed packet */
+	unsigned iface;
+
+	/** packet is a query */
+	int query;
+
+	/** used size of buf */
+	size_t len;
+
+	/** outgoing packet */
+	uint8_t buf[MDNS_MAX_PACKET];
+} mdns_reflector_t;
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief initialize reflector
+ * @param [out] x reflector
+ * @param [in] ifaces number of interfaces
+ * @param [in] send handler of outgoing packets
+ * @param [in] ctx context of handler
+ */
+void mdns_reflector_init(mdns_reflector_t* x, unsigned ifaces, mdns_reflect_handler send, void* ctx);
+
+/**
+ * @brief forward only this service type and its instances
+ * @param [in,out] x reflector
+ * @param [in] name dotted name of type, example "_ipp._tcp.local."
+ * @return zero, if successful
+ */
+int mdns_reflector_type(mdns_reflector_t* x, const char* name);
+
+/**
+ * @brief forward received packet to other interfaces
+ * @param [in,out] x reflector
+ * @param [in] iface interface of packet
+ * @param [in] buf packet
+ * @param [in] len length of packet
+ * @param [in] now current time in milliseconds
+ */
+void mdns_reflector_process(mdns_reflector_t* x, unsigned iface, const void* buf, size_t len, uint64_t now);
+
+#endif /* __YAMDNS_REFLECTOR_H */
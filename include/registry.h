@@ -0,0 +1,76 @@
+/**
+ * @file registry.h
+ *
+ * yamdns -- yet another very simple mdns.
+ * Copyright (C) 2013  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __YAMDNS_REGISTRY_H
+#define __YAMDNS_REGISTRY_H
+
+#include <yamdns/api.h>
+
+#include "responder.h"
+
+/** max number of connected clients */
+#ifndef MDNS_REGISTRY_CLIENTS
+#define MDNS_REGISTRY_CLIENTS 16
+#endif
+
+/** registered records of connected clients */
+typedef struct mdns_registry {
+	/** copies of records added by each client, see mdns_registry_handle() */
+	mdns_records_t owned[MDNS_REGISTRY_CLIENTS];
+} mdns_registry_t;
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief create listening socket for local registrations
+ * @param [in] path path of unix socket
+ * @return socket descriptor or -1
+ */
+int mdns_registry_listen(const char* path);
+
+/**
+ * @brief receive and apply one batch of operations, send acknowledge
+ * @param [in,out] g registry, zero filled before first use
+ * @param [in,out] r responder
+ * @param [in] client slot of client, less than MDNS_REGISTRY_CLIENTS
+ * @param [in] fd socket of client
+ * @return zero, if successful, -1 if client is disconnected
+ *
+ * Records are kept in MDNS_TABLE_API table of responder,
+ * goodbyes of batch are packed together and new records are probed together.
+ * Client can update and remove only records, which it has added.
+ */
+int mdns_registry_handle(mdns_registry_t* g, mdns_responder_t* r, unsigned client, int fd);
+
+/**
+ * @brief withdraw all records of disconnected client
+ * @param [in,out] g registry
+ * @param [in,out] r responder
+ * @param [in] client slot of client
+ */
+void mdns_registry_drop(mdns_registry_t* g, mdns_responder_t* r, unsigned client);
+
+/**
+ * @brief release memory of registry
+ * @param [in,out] g registry
+ */
+void mdns_registry_free(mdns_registry_t* g);
+
+#endif /* __YAMDNS_REGISTRY_H */
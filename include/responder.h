@@ -0,0 +1,470 @@
+/**
+ * @file responder.h
+ *
+ * yamdns -- yet another very simple mdns.
+ * Copyright (C) 2013  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __YAMDNS_RESPONDER_H
+#define __YAMDNS_RESPONDER_H
+
+#include <netinet/in.h>
+
+#include "records.h"
+#include "services.h"
+#include "reverse.h"
+#include "proxy.h"
+#include "overload.h"
+#include "latency.h"
+
+/*------------------------------------------------------------------------*/
+
+/** sources of owned records */
+typedef enum mdns_table {
+	/** host name and reverse address */
+	MDNS_TABLE_HOST,
+
+	/** services from config file */
+	MDNS_TABLE_CONFIG,
+
+	/** mapped records database */
+	MDNS_TABLE_DB,
+
+	/** records registered by local clients */
+	MDNS_TABLE_API,
+
+	MDNS_TABLE_MAX,
+} mdns_table_t;
+
+/*------------------------------------------------------------------------*/
+
+/** type of packet transmit handler */
+typedef int (*mdns_send_handler)(void* ctx, const void* buf, size_t len);
+
+/*------------------------------------------------------------------------*/
+
+/** probing and announcing of new records */
+typedef struct mdns_probe {
+	/** copies of records */
+	mdns_records_t recs;
+
+	/** mapped table, which records are probed instead of copies, or NULL */
+	const mdns_records_t* ref;
+
+	/** bitmap of records of mapped table, which are not probed */
+	uint8_t* skip;
+
+	/** number of sent probes and announcements */
+	int step;
+
+	/** time of next step in milliseconds */
+	uint64_t deadline;
+
+	/** next job */
+	struct mdns_probe* next;
+} mdns_probe_t;
+
+/*------------------------------------------------------------------------*/
+
+/** max number of names with negative responses in one packet */
+#define MDNS_NSEC_MAX 16
+
+/** number of cached responses, power of two */
+#ifndef MDNS_CACHE_SIZE
+#define MDNS_CACHE_SIZE 64
+#endif
+
+/** max length of question section of cached query */
+#define MDNS_CACHE_MAX_QUESTIONS 256
+
+/** max number of RRsets in one cached response */
+#define MDNS_CACHE_MAX_RRSETS 32
+
+/** number of remembered multicasts of RRsets, power of two */
+#ifndef MDNS_RECENT_SIZE
+#define MDNS_RECENT_SIZE 256
+#endif
+
+/** number of address families, answers of each are multicast apart */
+#define MDNS_FAMILIES 2
+
+/** last multicast of RRset, RFC 6762 6 */
+typedef struct mdns_recent {
+	/** hash of owner name and type, zero if slot is empty */
+	uint32_t key;
+
+	/** time of last multicast to IPv4 and IPv6 group in milliseconds */
+	uint64_t sent[MDNS_FAMILIES];
+} mdns_recent_t;
+
+/** response to query with the same question section */
+typedef struct mdns_cache_entry {
+	/** hash of number of questions and question section */
+	uint32_t hash;
+
+	/** generation of records, entry is stale if it differs */
+	uint32_t gen;
+
+	/** length of question section */
+	uint16_t q_len;
+
+	/** length of response, zero if nothing is answered */
+	uint16_t len;
+
+	/** number of questions in network byte order */
+	uint16_t qd_cnt;
+
+	/** number of RRsets in response */
+	uint16_t rrset_count;
+
+	/** keys of RRsets in response, see mdns_recent_t */
+	uint32_t rrsets[MDNS_CACHE_MAX_RRSETS];
+
+	/** raw question section */
+	uint8_t questions[MDNS_CACHE_MAX_QUESTIONS];
+
+	/** ready response packet */
+	uint8_t packet[MDNS_MAX_PACKET];
+} mdns_cache_entry_t;
+
+/** max number of queries answered together, see mdns_responder_defer() */
+#ifndef MDNS_DEFER_MAX
+#define MDNS_DEFER_MAX 16
+#endif
+
+/** query waiting for answer together with other queries */
+typedef struct mdns_deferred {
+	/** responder, context of query handler */
+	struct mdns_responder* r;
+
+	/** packet, it is owned by caller */
+	const void* buf;
+
+	/** length of packet */
+	size_t len;
+
+	/** shedding of packet, see mdns_overload_admit() */
+	int shed;
+
+	/** kernel receive time of packet, zero if unknown */
+	struct timespec stamp;
+
+	/** cache entry of question section, NULL if there is none */
+	mdns_cache_entry_t* entry;
+
+	/** hash of question section */
+	uint32_t hash;
+
+	/** length of question section */
+	size_t q_len;
+} mdns_deferred_t;
+
+/*------------------------------------------------------------------------*/
+
+/** mDNS responder */
+typedef struct mdns_responder {
+	/** tables of owned records, NULL if source is absent */
+	mdns_records_t* tables[MDNS_TABLE_MAX];
+
+	/** transmit handler */
+	mdns_send_handler send;
+
+	/** context of transmit handler */
+	void* send_ctx;
+
+	/** current monotonic time in milliseconds */
+	uint64_t now;
+
+	/** queue of probing and announcing jobs */
+	mdns_probe_t* probes;
+
+	/** names lost by probing or defending, never answered */
+	mdns_records_t conflicts;
+
+	/** records proposed by probe of another host, RFC 6762 8.2 */
+	mdns_records_t peer;
+
+	/** packet checked for conflicts, rdata names are unpacked from it */
+	const void* packet;
+
+	/** length of checked packet */
+	size_t packet_len;
+
+	/** number of records of checked packet passed to handler */
+	unsigned packet_rr;
+
+	/** index of DNS-SD service types of all tables */
+	mdns_services_t services;
+
+	/** ranges of addresses answered by reverse names */
+	mdns_reverse_t reverse;
+
+	/** records of sleeping hosts */
+	mdns_proxy_t proxy;
+
+	/** overload protection */
+	mdns_overload_t overload;
+
+	/** shedding of current packet, see mdns_overload_admit() */
+	int shed;
+
+	/** kernel receive time of current packet, zero if unknown */
+	struct timespec stamp;
+
+	/** time of query handlers of current packet in nanoseconds */
+	uint64_t lookup_ns;
+
+	/** time of building of current packet in nanoseconds */
+	uint64_t build_ns;
+
+	/** stages of answered queries */
+	mdns_latency_t latency;
+
+	/** outgoing packet */
+	uint8_t buf[MDNS_MAX_PACKET];
+
+	/** owners of NSEC records for additional section of response */
+	const char* nsec[MDNS_NSEC_MAX];
+
+	/** number of NSEC owners */
+	unsigned nsec_count;
+
+	/** number of packets sent by flush */
+	unsigned flushed;
+
+	/** generation of records, changed by any update of answers */
+	uint32_t gen;
+
+	/** responses to repeated queries, indexed by hash */
+	mdns_cache_entry_t cache[MDNS_CACHE_SIZE];
+
+	/** current packet is a probe, its answers are never delayed */
+	int probe;
+
+	/** number of RRsets left out of current response by rate limit */
+	unsigned limited;
+
+	/** number of RRsets in current response */
+	unsigned rrset_count;
+
+	/** index of first RRset of current question, others are not repeated */
+	unsigned question;
+
+	/** keys of RRsets in current response */
+	uint32_t rrsets[MDNS_CACHE_MAX_RRSETS];
+
+	/** last multicasts of RRsets, indexed by key */
+	mdns_recent_t recent[MDNS_RECENT_SIZE];
+
+	/** family of processed packet, 1 for IPv6, its answer goes only there */
+	unsigned family;
+
+	/** queries waiting for mdns_responder_process_deferred() */
+	mdns_deferred_t deferred[MDNS_DEFER_MAX];
+
+	/** number of waiting queries */
+	unsigned deferred_count;
+} mdns_responder_t;
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief initialize responder without records
+ * @param [out] r responder
+ * @param [in] send transmit handler
+ * @param [in] ctx context of transmit handler
+ */
+void mdns_responder_init(mdns_responder_t* r, mdns_send_handler send, void* ctx);
+
+/**
+ * @brief release all tables of responder
+ * @param [in,out] r responder
+ */
+void mdns_responder_free(mdns_responder_t* r);
+
+/**
+ * @brief learn records of designated hosts from received packet
+ * @param [in,out] r responder
+ * @param [in] from source address of packet, NULL if it isn't IPv4
+ * @param [in] buf packet
+ * @param [in] len length of packet
+ */
+void mdns_responder_snoop(mdns_responder_t* r, const struct in_addr* from, const void* buf, size_t len);
+
+/**
+ * @brief take token of source before processing of its packet
+ * @param [in,out] r responder
+ * @param [in] addr source address
+ * @param [in] addr_len length of address
+ * @param [in] buf packet
+ * @param [in] len length of packet
+ *
+ * Shedding is applied to the next processed packet only.
+ */
+void mdns_responder_admit(mdns_responder_t* r, const void* addr, size_t addr_len, const void* buf, size_t len);
+
+/**
+ * @brief set kernel receive time of packet before its processing
+ * @param [in,out] r responder
+ * @param [in] stamp SO_TIMESTAMPNS of packet
+ *
+ * Time is applied to the next processed packet only.
+ */
+void mdns_responder_stamp(mdns_responder_t* r, const struct timespec* stamp);
+
+/**
+ * @brief set address family of packet before its processing
+ * @param [in,out] r responder
+ * @param [in] family AF_INET or AF_INET6
+ *
+ * Answer is multicast only to family of query, so RRsets are limited
+ * per family. Announcements are multicast to both families.
+ */
+void mdns_responder_family(mdns_responder_t* r, int family);
+
+/**
+ * @brief create host table with address and reverse address records
+ * @param [out] t table of records
+ * @param [in] host dotted host name
+ * @param [in] in address of host
+ * @return zero, if successful
+ */
+int mdns_responder_host(mdns_records_t* t, const char* host, struct in_addr in);
+
+/**
+ * @brief add IPv6 address and its reverse address records into host table
+ * @param [in,out] t table of records
+ * @param [in] host dotted host name
+ * @param [in] in6 address of host
+ * @return zero, if successful
+ */
+int mdns_responder_host6(mdns_records_t* t, const char* host, const struct in6_addr* in6);
+
+/**
+ * @brief replace table of records
+ * @param [in,out] r responder
+ * @param [in] idx source of records
+ * @param [in] t new table allocated by malloc() or NULL
+ *
+ * Responder takes ownership of t. Records absent in previous table
+ * are probed and announced, removed records are multicasted with zero TTL.
+ */
+void mdns_responder_swap(mdns_responder_t* r, mdns_table_t idx, mdns_records_t* t);
+
+/**
+ * @brief put record into outgoing packet, full packet is sent
+ * @param [in,out] r responder
+ * @param [in] t table of record
+ * @param [in] rec record
+ * @param [in] ttl time to live, zero for goodbye
+ * @return zero, if successful
+ */
+int mdns_responder_put(mdns_responder_t* r, const mdns_records_t* t, const mdns_record_t* rec, uint32_t ttl);
+
+/**
+ * @brief queue new record for probing and announcing
+ * @param [in,out] r responder
+ * @param [in] t table of record
+ * @param [in] rec record
+ * @return zero, if successful
+ *
+ * Records queued before the first probe is sent are probed together.
+ */
+int mdns_responder_announce(mdns_responder_t* r, const mdns_records_t* t, const mdns_record_t* rec);
+
+/**
+ * @brief put goodbye of record into outgoing packet and stop its announcing
+ * @param [in,out] r responder
+ * @param [in] t table of record
+ * @param [in] rec record
+ */
+void mdns_responder_withdraw(mdns_responder_t* r, const mdns_records_t* t, const mdns_record_t* rec);
+
+/**
+ * @brief multicast all announced records with zero TTL
+ * @param [in,out] r responder
+ *
+ * Called on shutdown, so peers flush our records at once. Records, which
+ * are not announced yet, and names lost in conflicts are skipped.
+ */
+void mdns_responder_goodbye(mdns_responder_t* r);
+
+/**
+ * @brief run expired probing and announcing steps
+ * @param [in,out] r responder
+ * @param [in] now current monotonic time in milliseconds
+ */
+void mdns_responder_timer(mdns_responder_t* r, uint64_t now);
+
+/**
+ * @brief calculate time until next step
+ * @param [in] r responder
+ * @return timeout in milliseconds, -1 if nothing is scheduled
+ */
+int mdns_responder_timeout(const mdns_responder_t* r);
+
+/**
+ * @brief send outgoing packet, if it has records
+ * @param [in,out] r responder
+ */
+void mdns_responder_flush(mdns_responder_t* r);
+
+/**
+ * @brief drop all cached responses
+ * @param [in,out] r responder
+ *
+ * Must be called after records of any table are changed directly.
+ */
+void mdns_responder_invalidate(mdns_responder_t* r);
+
+/**
+ * @brief answer queries of incoming mDNS packet
+ * @param [in,out] r responder
+ * @param [in] buf incoming packet
+ * @param [in] len length of packet
+ *
+ * RRset is multicast not more often than once per second, except answers
+ * to probes, RFC 6762 6. Response to a query, which fits into one packet,
+ * is cached by raw question section and is sent again for the same
+ * questions without parsing, if none of its RRsets is limited.
+ */
+void mdns_responder_process(mdns_responder_t* r, const void* buf, size_t len);
+
+/**
+ * @brief process mDNS packet, query is answered later with other queries
+ * @param [in,out] r responder
+ * @param [in] buf incoming packet, it must be kept until its query is answered
+ * @param [in] len length of packet
+ *
+ * Responses, probes and queries answered from cache are processed at once.
+ * Other queries wait for mdns_responder_process_deferred(), it is called
+ * here too, if MDNS_DEFER_MAX queries are waiting. All waiting queries
+ * must come from one address family.
+ */
+void mdns_responder_defer(mdns_responder_t* r, const void* buf, size_t len);
+
+/**
+ * @brief answer waiting queries by one response
+ * @param [in,out] r responder
+ *
+ * Questions of all packets are looked up in order of hash of name by
+ * mdns_packet_process_batch(), so they are answered out of order of packets,
+ * and RRset asked by several packets is put only once. Alone query is
+ * answered and cached as by mdns_responder_process().
+ */
+void mdns_responder_process_deferred(mdns_responder_t* r);
+
+#endif /* __YAMDNS_RESPONDER_H */
@@ -0,0 +1,135 @@
+/**
+ * @file reverse.h
+ *
+ * yamdns -- yet another very simple mdns.
+ * Copyright (C) 2013  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __YAMDNS_REVERSE_H
+#define __YAMDNS_REVERSE_H
+
+#include <yamdns/type.h>
+
+/*------------------------------------------------------------------------*/
+
+/** address key, IPv4 address takes first 4 bytes */
+typedef struct mdns_reverse_key {
+	/** address in network byte order */
+	uint8_t addr[16];
+
+	/** AF_INET or AF_INET6 */
+	uint8_t family;
+
+	/** length of prefix in bits */
+	uint8_t prefix;
+} mdns_reverse_key_t;
+
+/*------------------------------------------------------------------------*/
+
+/** range of addresses resolved into one target */
+typedef struct mdns_reverse_range {
+	/** masked address and prefix */
+	mdns_reverse_key_t key;
+
+	/** hash of key */
+	uint32_t hash;
+
+	/** index of next range in hash chain */
+	uint32_t next;
+
+	/** time to live of PTR answer */
+	uint32_t ttl;
+
+	/** length of target */
+	uint16_t target_len;
+
+	/** encoded target name, rdata of PTR answer */
+	uint8_t target[MDNS_MAX_NAME];
+} mdns_reverse_range_t;
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * index of reverse names
+ *
+ * Ranges are hashed by masked address and prefix length. Lookup masks
+ * address by each prefix length present in index, so it takes at most
+ * 33 probes for IPv4 and 129 for IPv6, whatever the number of addresses.
+ */
+typedef struct mdns_reverse {
+	/** array of ranges */
+	mdns_reverse_range_t* ranges;
+
+	/** number of ranges */
+	uint32_t count;
+
+	/** allocated size of ranges */
+	uint32_t size;
+
+	/** heads of hash chains */
+	uint32_t* buckets;
+
+	/** number of buckets, power of two */
+	uint32_t nbuckets;
+
+	/** present prefix lengths of IPv4 ranges, bit per length */
+	uint64_t prefixes4;
+
+	/** present prefix lengths of IPv6 ranges, bit per length */
+	uint64_t prefixes6[3];
+} mdns_reverse_t;
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief initialize empty index
+ * @param [out] x index
+ */
+void mdns_reverse_init(mdns_reverse_t* x);
+
+/**
+ * @brief release memory of index
+ * @param [in,out] x index
+ */
+void mdns_reverse_free(mdns_reverse_t* x);
+
+/**
+ * @brief add range of addresses
+ * @param [in,out] x index
+ * @param [in] range address with optional prefix length, example "10.0.0.0/22" or "fd00::/64"
+ * @param [in] target dotted target name
+ * @param [in] ttl time to live of answers
+ * @return zero, if successful
+ */
+int mdns_reverse_add(mdns_reverse_t* x, const char* range, const char* target, uint32_t ttl);
+
+/**
+ * @brief parse reverse name into address
+ * @param [in] name dotted name, example "4.3.2.1.in-addr.arpa."
+ * @param [out] key address with full prefix length
+ * @return zero, if name is a full reverse name of address
+ */
+int mdns_reverse_parse(const char* name, mdns_reverse_key_t* key);
+
+/**
+ * @brief find range of reverse name
+ * @param [in] x index
+ * @param [in] name dotted name
+ * @return the most specific range or NULL
+ */
+const mdns_reverse_range_t* mdns_reverse_lookup(const mdns_reverse_t* x, const char* name);
+
+#endif /* __YAMDNS_REVERSE_H */
@@ -0,0 +1,153 @@
+/**
+ * @file services.h
+ *
+ * yamdns -- yet another very simple mdns.
+ * Copyright (C) 2013  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __YAMDNS_SERVICES_H
+#define __YAMDNS_SERVICES_H
+
+#include <yamdns/type.h>
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * DNS-SD service type or subtype with its PTR answers
+ *
+ * Answers are kept encoded as they are put into packet: owner name,
+ * answer header and rdata. Each answer is prefixed by mdns_service_rr_t
+ * and padded to even size.
+ */
+typedef struct mdns_service_type {
+	/** hash of name, see mdns_name_hash() */
+	uint32_t hash;
+
+	/** dotted name of type, example "_ipp._tcp.local." */
+	char name[MDNS_MAX_NAME];
+
+	/** encoded answers */
+	uint8_t* answers;
+
+	/** used size of answers */
+	size_t len;
+
+	/** allocated size of answers */
+	size_t size;
+
+	/** number of answers */
+	unsigned count;
+
+	/** next type in hash chain */
+	struct mdns_service_type* next;
+} mdns_service_type_t;
+
+/*------------------------------------------------------------------------*/
+
+/** prefix of encoded answer */
+typedef struct mdns_service_rr {
+	/** length of encoded answer */
+	uint16_t len;
+
+	/** number of tables with this record */
+	uint16_t refs;
+
+	/** offset of rdata in encoded answer */
+	uint16_t rdata;
+} mdns_service_rr_t;
+
+/*------------------------------------------------------------------------*/
+
+/** index of service types */
+typedef struct mdns_services {
+	/** heads of hash chains */
+	mdns_service_type_t** buckets;
+
+	/** number of buckets, power of two */
+	unsigned nbuckets;
+
+	/** number of types */
+	unsigned count;
+} mdns_services_t;
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief check if PTR record belongs to DNS-SD browsing
+ * @param [in] name dotted owner name
+ * @return non zero, if name is service type or subtype
+ */
+int mdns_services_is_type(const char* name);
+
+/**
+ * @brief initialize empty index
+ * @param [out] s index
+ */
+void mdns_services_init(mdns_services_t* s);
+
+/**
+ * @brief release memory of index
+ * @param [in,out] s index
+ */
+void mdns_services_free(mdns_services_t* s);
+
+/**
+ * @brief add PTR record of service type into index
+ * @param [in,out] s index
+ * @param [in] name dotted name of type with last dot
+ * @param [in] ttl time to live
+ * @param [in] rdata encoded name of instance
+ * @param [in] rd_len length of rdata
+ * @return zero, if successful
+ *
+ * New service type is added into answers of MDNS_QUERY_SERVICE_DISCOVERY,
+ * record added again only updates TTL and counts references.
+ */
+int mdns_services_add(mdns_services_t* s, const char* name, uint32_t ttl, const void* rdata, size_t rd_len);
+
+/**
+ * @brief remove PTR record of service type from index
+ * @param [in,out] s index
+ * @param [in] name dotted name of type with last dot
+ * @param [in] rdata encoded name of instance
+ * @param [in] rd_len length of rdata
+ */
+void mdns_services_remove(mdns_services_t* s, const char* name, const void* rdata, size_t rd_len);
+
+/**
+ * @brief find service type
+ * @param [in] s index
+ * @param [in] hash hash of name
+ * @param [in] name dotted name
+ * @return service type or NULL
+ */
+const mdns_service_type_t* mdns_services_find(const mdns_services_t* s, uint32_t hash, const char* name);
+
+/**
+ * @brief check if index has service type with name of this hash
+ * @param [in] s index
+ * @param [in] hash hash of name
+ * @return non zero, if such type can be present
+ */
+int mdns_services_has_hash(const mdns_services_t* s, uint32_t hash);
+
+/** return pointer to encoded answer after prefix */
+#define mdns_service_rr_data(rr) ((const void*)((rr) + 1))
+
+/** return next answer of service type */
+#define mdns_service_rr_next(rr) ((const mdns_service_rr_t*)((const uint8_t*)((rr) + 1) + (((rr)->len + 1) & ~1)))
+
+#endif /* __YAMDNS_SERVICES_H */
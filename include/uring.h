@@ -0,0 +1,187 @@
+/**
+ * @file uring.h
+ *
+ * yamdns -- yet another very simple mdns.
+ * Copyright (C) 2013  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __YAMDNS_URING_H
+#define __YAMDNS_URING_H
+
+#include "network.h"
+
+/*------------------------------------------------------------------------*/
+
+/** number of provided receive buffers, power of two */
+#ifndef MDNS_URING_BUFS
+#define MDNS_URING_BUFS 64
+#endif
+
+/** size of provided receive buffer, it has header and address before packet */
+#define MDNS_URING_BUF_SIZE 2048
+
+/*------------------------------------------------------------------------*/
+
+/** mapped submission and completion queues of io_uring instance */
+typedef struct mdns_ring {
+	/** io_uring descriptor */
+	int fd;
+
+	/** mapping of submission queue ring */
+	void* sq;
+
+	/** length of sq */
+	size_t sq_len;
+
+	/** mapping of completion queue ring */
+	void* cq;
+
+	/** length of cq */
+	size_t cq_len;
+
+	/** mapping of submission queue entries */
+	struct io_uring_sqe* sqes;
+
+	/** length of sqes */
+	size_t sqes_len;
+
+	/** pointers into sq mapping */
+	unsigned *sq_head, *sq_tail, *sq_array;
+
+	/** mask of submission queue index */
+	unsigned sq_mask;
+
+	/** tail of prepared, but not submitted entries */
+	unsigned tail;
+
+	/** pointers into cq mapping */
+	unsigned *cq_head, *cq_tail;
+
+	/** mask of completion queue index */
+	unsigned cq_mask;
+
+	/** completion queue entries */
+	struct io_uring_cqe* cqes;
+} mdns_ring_t;
+
+/*------------------------------------------------------------------------*/
+
+/** type of received packet handler */
+typedef void (*mdns_uring_handler)(void* ctx, const void* buf, size_t len, const struct sockaddr_in* from);
+
+/** type of handler called after all received packets, before their buffers are reused */
+typedef void (*mdns_uring_done_handler)(void* ctx);
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * io_uring backend of mdns socket
+ *
+ * Receiving ring keeps multishot recvmsg armed against ring of provided
+ * buffers, so packets are received without syscall per packet.
+ * Transmitting ring submits the whole batch of sendmsg by one syscall.
+ * Socket is registered in both rings.
+ */
+typedef struct mdns_uring {
+	/** receiving ring, its descriptor is pollable */
+	mdns_ring_t rx;
+
+	/** transmitting ring */
+	mdns_ring_t tx;
+
+	/** ring of provided buffers followed by buffers */
+	struct io_uring_buf_ring* br;
+
+	/** length of br mapping */
+	size_t br_len;
+
+	/** receive buffers */
+	uint8_t* bufs;
+
+	/** tail of provided buffers ring */
+	uint16_t br_tail;
+
+	/** header for multishot recvmsg, only lengths are used */
+	struct msghdr rmsg;
+
+	/** kernel drop counter of last packet, SO_RXQ_OVFL */
+	uint32_t drops;
+
+	/** kernel receive time of last packet, SO_TIMESTAMPNS */
+	struct timespec stamp;
+
+	/** destination of outgoing packets */
+	struct sockaddr_in to;
+
+	/** number of queued packets */
+	unsigned count;
+
+	/** headers for sendmsg */
+	struct msghdr msgs[MDNS_BATCH_MAX];
+
+	/** data of packets */
+	struct iovec iov[MDNS_BATCH_MAX];
+
+	/** copies of packets */
+	uint8_t out[MDNS_BATCH_MAX][MDNS_MAX_PACKET];
+} mdns_uring_t;
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief create io_uring backend for mdns socket
+ * @param [out] u backend
+ * @param [in] sockfd socket desctriptor
+ * @return zero, if successful, -1 if kernel doesn't support required features
+ */
+int mdns_uring_init(mdns_uring_t* u, int sockfd);
+
+/**
+ * @brief release io_uring backend, socket is not closed
+ * @param [in,out] u backend
+ */
+void mdns_uring_free(mdns_uring_t* u);
+
+/**
+ * @brief handle all received packets
+ * @param [in,out] u backend
+ * @param [in] handler handler of packet
+ * @param [in] done handler called after the last packet or NULL
+ * @param [in] ctx context of handlers
+ * @return number of handled packets or -1, then backend must be freed
+ *
+ * Call it when descriptor of receiving ring is readable. Packets stay
+ * valid until done handler returns, so they can be processed together.
+ */
+int mdns_uring_recv(mdns_uring_t* u, mdns_uring_handler handler, mdns_uring_done_handler done, void* ctx);
+
+/**
+ * @brief queue copy of mDNS packet, full batch is sent
+ * @param [in,out] u backend
+ * @param [in] buf pointer to packet
+ * @param [in] len length of packet
+ * @return length of packet or -1
+ */
+int mdns_uring_add(mdns_uring_t* u, const void* buf, size_t len);
+
+/**
+ * @brief send all queued packets and wait for their completion
+ * @param [in,out] u backend
+ * @return number of sent packets or -1
+ */
+int mdns_uring_flush(mdns_uring_t* u);
+
+#endif /* __YAMDNS_URING_H */
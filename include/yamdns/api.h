@@ -0,0 +1,118 @@
+/**
+ * @file api.h
+ *
+ * yamdns -- yet another very simple mdns.
+ * Copyright (C) 2013  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __YAMDNS_API_H
+#define __YAMDNS_API_H
+
+#include <stdint.h>
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * Local registration protocol.
+ *
+ * Client connects to SOCK_SEQPACKET unix socket of daemon and sends
+ * messages, one message is a batch of operations:
+ * mdns_api_hdr_t followed by mdns_api_op_t items. Daemon replies
+ * by one mdns_api_ack_t for every message. All numbers are
+ * in host byte order.
+ */
+
+/** version of protocol */
+#define MDNS_API_VERSION 1
+
+/** default path of unix socket */
+#define MDNS_API_SOCKET "/run/yamdns.sock"
+
+/** max size of one message */
+#define MDNS_API_MAX_MSG 0x10000
+
+/*------------------------------------------------------------------------*/
+
+/** operations */
+typedef enum mdns_api_op_type {
+	/** add record and announce it */
+	MDNS_API_ADD    = 1,
+
+	/**
+	 * remove record and send goodbye for it,
+	 * type MDNS_RECORD_ANY removes all records of name,
+	 * empty rdata removes all records of name with this type,
+	 * only records added by the same connection are removed,
+	 * all of them are removed when connection is closed
+	 */
+	MDNS_API_REMOVE = 2,
+} mdns_api_op_type_t;
+
+/*------------------------------------------------------------------------*/
+
+/** header of message */
+typedef struct mdns_api_hdr {
+	/** MDNS_API_VERSION */
+	uint16_t version;
+
+	/** number of operations */
+	uint16_t count;
+
+	/** sequence number, returned in acknowledge */
+	uint32_t seq;
+} __attribute__((__packed__)) mdns_api_hdr_t;
+
+/*------------------------------------------------------------------------*/
+
+/** operation with record */
+typedef struct mdns_api_op {
+	/** mdns_api_op_type_t */
+	uint8_t op;
+
+	/** length of dotted owner name including zero byte */
+	uint8_t name_len;
+
+	/** resource type */
+	uint16_t type;
+
+	/** time to live */
+	uint32_t ttl;
+
+	/** length of encoded rdata, names must be uncompressed */
+	uint16_t rd_len;
+
+	/** owner name followed by rdata */
+	uint8_t data[];
+} __attribute__((__packed__)) mdns_api_op_t;
+
+/*------------------------------------------------------------------------*/
+
+/** acknowledge of message */
+typedef struct mdns_api_ack {
+	/** sequence number of message */
+	uint32_t seq;
+
+	/** number of processed operations */
+	uint16_t count;
+
+	/** number of failed operations */
+	uint16_t failed;
+
+	/** status of every operation, zero if successful */
+	uint8_t status[];
+} __attribute__((__packed__)) mdns_api_ack_t;
+
+#endif /* __YAMDNS_API_H */
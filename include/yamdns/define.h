@@ -28,12 +28,18 @@
 /** 224.0.0.251 */
 #define __MDNS_MC_GROUP (struct in_addr){.s_addr = 0xfb0000e0}
 
+/** ff02::fb */
+#define __MDNS_MC_GROUP6 (struct in6_addr){.s6_addr = {0xff, 0x02, [15] = 0xfb}}
+
 /** default mdns port */
 #define __MDNS_PORT 5353
 
 /** default TTL for mDNS */
 #define __MDNS_TTL 255
 
+/** max size of mDNS packet, fits into ethernet frame */
+#define MDNS_MAX_PACKET 1500
+
 /** max size of dns name including zero byte */
 #define MDNS_MAX_NAME 0x100
 
@@ -43,12 +49,18 @@
 /** max size of address name, example "192.168.100.200.in-addr.arpa." */
 #define MDNS_MAX_ADDRESS_NAME 30
 
+/** max size of IPv6 address name, 32 nibbles and "ip6.arpa." */
+#define MDNS_MAX_ADDRESS6_NAME 74
+
 /** service discovery query */
 #define MDNS_QUERY_SERVICE_DISCOVERY "_services._dns-sd._udp.local."
 
 /** address resolve query */
 #define MDNS_QUERY_RESOLVE_ADDRESS "in-addr.arpa."
 
+/** IPv6 address resolve query */
+#define MDNS_QUERY_RESOLVE_ADDRESS6 "ip6.arpa."
+
 /** default mdns domain */
 #define MDNS_DOMAIN "local."
 
@@ -61,6 +73,8 @@ typedef enum mdns_record_type {
 	MDNS_RECORD_TEXT  = 0x0010,
 	MDNS_RECORD_AAAA  = 0x001c,
 	MDNS_RECORD_SRV   = 0x0021,
+	MDNS_RECORD_NSEC  = 0x002f,
+	MDNS_RECORD_ANY   = 0x00ff,
 } mdns_record_type_t;
 
 /*------------------------------------------------------------------------*/
@@ -69,10 +83,22 @@ typedef enum mdns_record_type {
 typedef enum mdns_class_type {
 	/** internet class */
 	MDNS_CLASS_IN     = 0x0001,
+
+	/** cache-flush bit of unique record, RFC 6762 10.2 */
+	MDNS_CLASS_FLUSH  = 0x8000,
 } mdns_class_type_t;
 
 /*------------------------------------------------------------------------*/
 
+/** sections of resource records in packet */
+typedef enum mdns_section {
+	MDNS_SECTION_ANSWER,
+	MDNS_SECTION_AUTHORITY,
+	MDNS_SECTION_ADDITIONAL,
+} mdns_section_t;
+
+/*------------------------------------------------------------------------*/
+
 enum {
 	MDNS_FLAG_QUERY  = 0,
 	MDNS_FLAG_ANSWER = 0x8000,
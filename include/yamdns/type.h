@@ -95,17 +95,119 @@ typedef struct mdns_record_srv {
 
 /*------------------------------------------------------------------------*/
 
+/** view of TXT rdata, strings are not copied */
+typedef struct mdns_text {
+	/** sequence of length prefixed strings */
+	const uint8_t* data;
+
+	/** length of data */
+	size_t len;
+} mdns_text_t;
+
+/** iterator over strings of TXT rdata */
+typedef struct mdns_text_iter {
+	/** length byte of next string */
+	const uint8_t* pos;
+
+	/** end of rdata */
+	const uint8_t* end;
+} mdns_text_iter_t;
+
+/** key/value pair of TXT record, RFC 6763 6.3 */
+typedef struct mdns_text_pair {
+	/** key */
+	const char* key;
+
+	/** value or NULL for boolean attribute without '=' */
+	const char* value;
+} mdns_text_pair_t;
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * bump allocator for decoded packets
+ *
+ * Memory is supplied by caller and is never freed piece by piece,
+ * everything allocated is released at once by mdns_arena_reset().
+ */
+typedef struct mdns_arena {
+	/** memory of arena */
+	uint8_t* buf;
+
+	/** size of memory */
+	size_t size;
+
+	/** used part of memory */
+	size_t used;
+} mdns_arena_t;
+
+/** decoded question or record, 32 bytes */
+typedef struct mdns_rr_desc {
+	/** dotted owner name in arena */
+	const char* name;
+
+	/** dotted name of PTR or SRV rdata in arena, otherwise NULL */
+	const char* target;
+
+	/** mdns_name_hash() of name */
+	uint32_t hash;
+
+	/** time to live, zero for questions */
+	uint32_t ttl;
+
+	/** type of record or question */
+	uint16_t type;
+
+	/** class with cache flush or unicast response bit */
+	uint16_t class;
+
+	/** offset of rdata in packet */
+	uint16_t rd_off;
+
+	/** length of rdata */
+	uint16_t rd_len;
+} mdns_rr_desc_t;
+
+/** packet decoded into arena */
+typedef struct mdns_decoded {
+	/** packet, rdata is not copied */
+	const uint8_t* buf;
+
+	/** length of packet */
+	size_t len;
+
+	/** questions, then records of all sections in order of packet */
+	mdns_rr_desc_t* rrs;
+
+	/** number of questions */
+	unsigned qd_cnt;
+
+	/** number of answers */
+	unsigned an_cnt;
+
+	/** number of authority records */
+	unsigned ns_cnt;
+
+	/** number of additional records */
+	unsigned ar_cnt;
+} mdns_decoded_t;
+
+/*------------------------------------------------------------------------*/
+
 /** type of query handler */
 typedef void (*mdns_query_handler)(void* ctx, const mdns_query_hdr_t*, const char*);
 
 /** type of answer handler for type A */
 typedef void (*mdns_answer_handler_a)(void* ctx, const mdns_answer_hdr_t*, const char*, struct in_addr*);
 
+/** type of answer handler for type AAAA */
+typedef void (*mdns_answer_handler_aaaa)(void* ctx, const mdns_answer_hdr_t*, const char*, struct in6_addr*);
+
 /** type of answer handler for type PTR */
 typedef void (*mdns_answer_handler_ptr)(void* ctx, const mdns_answer_hdr_t*, const char*, const char*);
 
 /** type of answer handler for type TEXT */
-typedef void (*mdns_answer_handler_text)(void* ctx, const mdns_answer_hdr_t*, const char*, const char*);
+typedef void (*mdns_answer_handler_text)(void* ctx, const mdns_answer_hdr_t*, const char*, const mdns_text_t*);
 
 /** type of answer handler for type SRV */
 typedef void (*mdns_answer_handler_srv)(void* ctx, const mdns_answer_hdr_t*, const char*, mdns_record_srv_t*, const char*);
@@ -113,6 +215,12 @@ typedef void (*mdns_answer_handler_srv)(void* ctx, const mdns_answer_hdr_t*, con
 /** type of answer handler for unknown types */
 typedef void (*mdns_answer_handler_raw)(void* ctx, const mdns_answer_hdr_t*, const char*, const void*, size_t);
 
+/**
+ * type of name filter, returns non zero if name with this hash is interesting,
+ * name is position of encoded name in packet, see mdns_packet_name()
+ */
+typedef int (*mdns_name_filter)(void* ctx, uint32_t hash, const void* buf, size_t len, const void* name);
+
 /*------------------------------------------------------------------------*/
 
 /** callbacks handlers for mDNS packet */
@@ -123,6 +231,9 @@ typedef struct mdns_handlers {
 	/** answer handler for type A */
 	mdns_answer_handler_a a;
 
+	/** answer handler for type AAAA */
+	mdns_answer_handler_aaaa aaaa;
+
 	/** answer handler for type PTR */
 	mdns_answer_handler_ptr ptr;
 
@@ -134,6 +245,9 @@ typedef struct mdns_handlers {
 
 	/** answer handler for unknown types */
 	mdns_answer_handler_raw raw;
+
+	/** handler of every record with raw rdata, called before type handler */
+	mdns_answer_handler_raw rr;
 } mdns_handlers_t;
 
 #endif /* __YAMDNS_TYPE_H */
@@ -50,6 +50,97 @@ int mdns_packet_is_valid(void* buf, size_t len);
  */
 size_t mdns_packet_process(const void* buf, size_t len, const mdns_handlers_t* handlers, void* ctx);
 
+/**
+ * @brief process array of mDNS packets and call handlers
+ * @param [in] bufs buffers with packets
+ * @param [in] lens sizes of packets
+ * @param [in] count number of packets
+ * @param [in] handlers callback handlers
+ * @param [in] ctxs context for callbacks of each packet
+ * @param [out] results size of successfully parsed data of each packet
+ * @return number of questions passed to query handler
+ *
+ * Handlers of records are called while packets are parsed, in order of
+ * packets. Questions are collected and passed later in groups of up to 256
+ * (64 in static build), sorted by hash of name (see mdns_name_hash()), so
+ * equal names of different packets are looked up together. Unlike
+ * mdns_packet_process(), query handler of packet runs after its record
+ * handlers and after those of the following packets of the group, and
+ * questions of different packets are interleaved.
+ */
+size_t mdns_packet_process_batch(const void* const* bufs, const size_t* lens, size_t count, const mdns_handlers_t* handlers, void* const* ctxs, size_t* results);
+
+/**
+ * @brief initialize arena
+ * @param [out] a arena
+ * @param [in] buf memory of arena, aligned to pointer
+ * @param [in] size size of memory
+ */
+void mdns_arena_init(mdns_arena_t* a, void* buf, size_t size);
+
+/**
+ * @brief allocate memory from arena
+ * @param [in,out] a arena
+ * @param [in] size size of memory
+ * @return pointer aligned to pointer or NULL, if arena is full
+ */
+void* mdns_arena_alloc(mdns_arena_t* a, size_t size);
+
+/**
+ * @brief release everything allocated from arena
+ * @param [in,out] a arena
+ */
+void mdns_arena_reset(mdns_arena_t* a);
+
+/**
+ * @brief decode mDNS packet into arena in a single pass
+ * @param [in] buf buffer with packet, must outlive decoded packet
+ * @param [in] len size of packet, up to 65535
+ * @param [in,out] a arena for descriptors and names
+ * @param [out] d decoded packet
+ * @return zero, if successful
+ *
+ * Descriptors and names stay valid until arena is reset, so they can be
+ * kept after parsing, unlike arguments of handlers of mdns_packet_process().
+ * If packet is malformed or arena is full, arena is left as before.
+ */
+int mdns_packet_decode(const void* buf, size_t len, mdns_arena_t* a, mdns_decoded_t* d);
+
+/**
+ * @brief fast check of query for interesting questions
+ * @param [in] buf buffer with packet
+ * @param [in] len size of buffer or packet
+ * @param [in] filter filter of question names
+ * @param [in] ctx context for filter
+ * @return non zero, if packet is a query with at least one interesting question
+ *
+ * Only header and question section are touched, names are not unpacked,
+ * hash of each name (see mdns_name_hash()) is calculated while labels are parsed.
+ */
+int mdns_packet_prefilter(const void* buf, size_t len, mdns_name_filter filter, void* ctx);
+
+/**
+ * @brief unpack encoded name from packet
+ * @param [in] buf buffer with packet
+ * @param [in] len size of buffer or packet
+ * @param [in] pos position of encoded name in packet
+ * @param [out] name buffer for dotted name
+ * @param [in] size size of name buffer
+ * @return position after encoded name or NULL
+ */
+const void* mdns_packet_name(const void* buf, size_t len, const void* pos, char* name, size_t size);
+
+/**
+ * @brief find end of question section of query
+ * @param [in] buf buffer with packet
+ * @param [in] len size of buffer or packet
+ * @return size of header and question section, 0 if packet is not a valid query
+ *
+ * Compressed names must point backward, so the question section
+ * together with header describes all questions of packet.
+ */
+size_t mdns_packet_questions(const void* buf, size_t len);
+
 /**
  * @brief print dump of mDNS packet
  * @param [in] buf buffer with packet
@@ -57,6 +148,26 @@ size_t mdns_packet_process(const void* buf, size_t len, const mdns_handlers_t* h
  */
 void mdns_packet_dump(const void* buf, size_t len);
 
+struct mdns_dump;
+struct mdns_dump_filter;
+struct sockaddr;
+
+/**
+ * @brief dump mDNS packet into buffer and write it at once
+ * @param [in,out] d output, see dump.h
+ * @param [in] f filter or NULL
+ * @param [in] dir direction of packet, MDNS_DUMP_IN or MDNS_DUMP_OUT
+ * @param [in] label prefix of the first line or NULL
+ * @param [in] from source address or NULL
+ * @param [in] buf buffer with packet
+ * @param [in] len size of buffer or packet
+ * @return non zero, if packet passed filter and was dumped
+ *
+ * Filter is checked during parsing, so nothing is formatted for skipped
+ * packets, and only records and questions, which pass filter, are dumped.
+ */
+int mdns_packet_dump_to(struct mdns_dump* d, const struct mdns_dump_filter* f, int dir, const char* label, const struct sockaddr* from, const void* buf, size_t len);
+
 /**
  * @brief return text description of mdns record type
  * @param rec mdns record type
@@ -90,9 +201,24 @@ int mdns_packet_add_query_in(void* buf, size_t len, uint16_t q_type, const char*
  * @param [in] root query of answer
  * @param [in] in IPv4 address
  * @return zero, if successful
+ *
+ * Record is unique, so cache-flush bit is set.
  */
 int mdns_packet_add_answer_in(void* buf, size_t len, uint32_t ttl, const char* root, struct in_addr in);
 
+/**
+ * @brief add answer for in6 address into mDNS packet
+ * @param [in,out] buf buffer with packet
+ * @param [in] len size of buffer or packet
+ * @param [in] ttl time to live of this answer
+ * @param [in] root query of answer
+ * @param [in] in6 IPv6 address
+ * @return zero, if successful
+ *
+ * Record is unique, so cache-flush bit is set.
+ */
+int mdns_packet_add_answer_in6(void* buf, size_t len, uint32_t ttl, const char* root, struct in6_addr in6);
+
 /**
  * @brief add answer about pointer into mDNS packet
  * @param [in,out] buf buffer with packet
@@ -104,16 +230,47 @@ int mdns_packet_add_answer_in(void* buf, size_t len, uint32_t ttl, const char* r
  */
 int mdns_packet_add_answer_in_ptr(void* buf, size_t len, uint32_t ttl, const char* root, const char* name);
 
+/**
+ * @brief start iteration over strings of TXT rdata
+ * @param [out] it iterator
+ * @param [in] txt TXT rdata
+ */
+void mdns_text_iter_init(mdns_text_iter_t* it, const mdns_text_t* txt);
+
+/**
+ * @brief get next string of TXT rdata
+ * @param [in,out] it iterator
+ * @param [out] str pointer to string inside rdata, it is not terminated
+ * @param [out] len length of string
+ * @return 1 if string is returned, 0 at the end, -1 if rdata is malformed
+ */
+int mdns_text_next(mdns_text_iter_t* it, const char** str, size_t* len);
+
+/**
+ * @brief find value of key in TXT rdata
+ * @param [in] txt TXT rdata
+ * @param [in] key key, compared case insensitively
+ * @param [out] value pointer to value inside rdata or NULL for boolean attribute
+ * @param [out] len length of value
+ * @return non zero, if key is present
+ *
+ * Only the first occurrence of key is used, RFC 6763 6.4.
+ */
+int mdns_text_find(const mdns_text_t* txt, const char* key, const char** value, size_t* len);
+
 /**
  * @brief add answer text record into mDNS packet
  * @param [in,out] buf buffer with packet
  * @param [in] len size of buffer or packet
  * @param [in] ttl time to live of this answer
  * @param [in] root query of answer
- * @param [in] text text
+ * @param [in] pairs key/value pairs
+ * @param [in] count number of pairs, zero for empty TXT record
  * @return zero, if successful
+ *
+ * Record is unique, so cache-flush bit is set.
  */
-int mdns_packet_add_answer_in_text(void* buf, size_t len, uint32_t ttl, const char* root, const char* text);
+int mdns_packet_add_answer_in_text(void* buf, size_t len, uint32_t ttl, const char* root, const mdns_text_pair_t* pairs, size_t count);
 
 /**
  * @brief add answer about service into mDNS packet
@@ -126,9 +283,97 @@ int mdns_packet_add_answer_in_text(void* buf, size_t len, uint32_t ttl, const ch
  * @param [in] port service port (0-65535)
  * @param [in] name name of service host
  * @return zero, if successful
+ *
+ * Record is unique, so cache-flush bit is set.
  */
 int mdns_packet_add_answer_in_srv(void* buf, size_t len, uint32_t ttl, const char* root, uint16_t prio, uint16_t weight, uint16_t port, const char* name);
 
+/**
+ * @brief add record with already encoded rdata into section of mDNS packet
+ * @param [in,out] buf buffer with packet
+ * @param [in] len size of buffer or packet
+ * @param [in] section section of record, records of later sections must be absent
+ * @param [in] a_class class of record, MDNS_CLASS_IN with MDNS_CLASS_FLUSH for unique record
+ * @param [in] ttl time to live of this record
+ * @param [in] root owner of record
+ * @param [in] type resource type
+ * @param [in] rdata encoded rdata, names must be uncompressed
+ * @param [in] rd_len length of rdata
+ * @return zero, if successful
+ *
+ * Packet is marked as response, unless record is in authority section.
+ */
+int mdns_packet_add_record(void* buf, size_t len, mdns_section_t section, uint16_t a_class, uint32_t ttl, const char* root, uint16_t type, const void* rdata, size_t rd_len);
+
+/**
+ * @brief add answer with already encoded rdata into mDNS packet
+ * @param [in,out] buf buffer with packet
+ * @param [in] len size of buffer or packet
+ * @param [in] ttl time to live of this answer
+ * @param [in] root query of answer
+ * @param [in] type resource type
+ * @param [in] rdata encoded rdata, names must be uncompressed
+ * @param [in] rd_len length of rdata
+ * @return zero, if successful
+ */
+int mdns_packet_add_answer_rdata(void* buf, size_t len, uint32_t ttl, const char* root, uint16_t type, const void* rdata, size_t rd_len);
+
+/**
+ * @brief add authority record with already encoded rdata into mDNS packet
+ * @param [in,out] buf buffer with packet
+ * @param [in] len size of buffer or packet
+ * @param [in] ttl time to live of this record
+ * @param [in] root owner of record
+ * @param [in] type resource type
+ * @param [in] rdata encoded rdata, names must be uncompressed
+ * @param [in] rd_len length of rdata
+ * @return zero, if successful
+ *
+ * Used by probes to carry proposed records.
+ */
+int mdns_packet_add_authority_rdata(void* buf, size_t len, uint32_t ttl, const char* root, uint16_t type, const void* rdata, size_t rd_len);
+
+/**
+ * @brief add additional record with already encoded rdata into mDNS packet
+ * @param [in,out] buf buffer with packet
+ * @param [in] len size of buffer or packet
+ * @param [in] ttl time to live of this record
+ * @param [in] root owner of record
+ * @param [in] type resource type
+ * @param [in] rdata encoded rdata, names must be uncompressed
+ * @param [in] rd_len length of rdata
+ * @return zero, if successful
+ *
+ * Packet is marked as response.
+ */
+int mdns_packet_add_additional_rdata(void* buf, size_t len, uint32_t ttl, const char* root, uint16_t type, const void* rdata, size_t rd_len);
+
+/**
+ * @brief add already encoded answer into mDNS packet
+ * @param [in,out] buf buffer with packet
+ * @param [in] len size of buffer or packet
+ * @param [in] rr owner name, answer header and rdata, names must be uncompressed
+ * @param [in] rr_len length of rr
+ * @return zero, if successful
+ */
+int mdns_packet_add_answer_encoded(void* buf, size_t len, const void* rr, size_t rr_len);
+
+/**
+ * @brief encode dotted name into labels
+ * @param [out] buf buffer for encoded name
+ * @param [in] len length of buf
+ * @param [in] name dotted name
+ * @return size of encoded name, zero if buf is too small
+ */
+size_t mdns_name_encode(void* buf, size_t len, const char* name);
+
+/**
+ * @brief calculate case insensitive hash of dotted name
+ * @param [in] name dotted name, last dot is optional
+ * @return hash of name
+ */
+uint32_t mdns_name_hash(const char* name);
+
 /**
  * @brief format address name for reverse query
  * @param [in,out] s pointer to string buffer
@@ -141,4 +386,16 @@ int mdns_packet_add_answer_in_srv(void* buf, size_t len, uint32_t ttl, const cha
  */
 int mdns_format_address_name(char* s, size_t len, struct in_addr in);
 
+/**
+ * @brief format address name for reverse query of IPv6 address
+ * @param [in,out] s pointer to string buffer
+ * @param [in] len length of s, at least MDNS_MAX_ADDRESS6_NAME
+ * @param [in] in6 address of AF_INET6 family
+ * @return zero, if successful
+ *
+ * Example:
+ * fd00::2 -> "2.0.0.0. ... .0.0.d.f.ip6.arpa."
+ */
+int mdns_format_address6_name(char* s, size_t len, const struct in6_addr* in6);
+
 #endif /* __YAMDNS_H */
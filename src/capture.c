@@ -0,0 +1,371 @@
+/**
+ * @file capture.c
+ *
+ * yamdns -- yet another very simple mdns.
+ * Copyright (C) 2013  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <arpa/inet.h>
+
+#include <yamdns/define.h>
+
+#include "capture.h"
+
+/*------------------------------------------------------------------------*/
+
+/** pcapng block types */
+#define __MDNS_PCAPNG_SHB 0x0a0d0d0a
+#define __MDNS_PCAPNG_IDB 0x00000001
+#define __MDNS_PCAPNG_EPB 0x00000006
+
+/** byte-order magic of section header */
+#define __MDNS_PCAPNG_MAGIC 0x1a2b3c4d
+
+/** options */
+#define __MDNS_PCAPNG_OPT_END 0
+#define __MDNS_PCAPNG_IF_NAME 2
+#define __MDNS_PCAPNG_IF_TSRESOL 9
+#define __MDNS_PCAPNG_EPB_FLAGS 2
+
+/** raw IPv4 or IPv6, version is in the first byte */
+#define __MDNS_LINKTYPE_RAW 101
+
+/** max length of IP and UDP headers */
+#define __MDNS_CAPTURE_HEADERS (40 + 8)
+
+/** align length of block data */
+#define __MDNS_PCAPNG_PAD(len) (((len) + 3) & ~3U)
+
+/*------------------------------------------------------------------------*/
+
+/** header of block */
+typedef struct mdns_pcapng_block {
+	uint32_t type;
+	uint32_t len;
+} mdns_pcapng_block_t;
+
+/** section header block without options */
+typedef struct mdns_pcapng_shb {
+	mdns_pcapng_block_t hdr;
+	uint32_t magic;
+	uint16_t major;
+	uint16_t minor;
+	uint64_t section_len;
+} __attribute__((packed)) mdns_pcapng_shb_t;
+
+/** interface description block without options */
+typedef struct mdns_pcapng_idb {
+	mdns_pcapng_block_t hdr;
+	uint16_t linktype;
+	uint16_t reserved;
+	uint32_t snaplen;
+} mdns_pcapng_idb_t;
+
+/** enhanced packet block without data */
+typedef struct mdns_pcapng_epb {
+	mdns_pcapng_block_t hdr;
+	uint32_t iface;
+	uint32_t ts_high;
+	uint32_t ts_low;
+	uint32_t cap_len;
+	uint32_t len;
+} mdns_pcapng_epb_t;
+
+/** header of option */
+typedef struct mdns_pcapng_opt {
+	uint16_t code;
+	uint16_t len;
+} mdns_pcapng_opt_t;
+
+/*------------------------------------------------------------------------*/
+
+static uint8_t* mdns_capture_option(uint8_t* pos, uint16_t code, const void* data, uint16_t len)
+{
+	mdns_pcapng_opt_t opt = {code, len};
+
+	memcpy(pos, &opt, sizeof(opt));
+	memcpy(pos + sizeof(opt), data, len);
+	memset(pos + sizeof(opt) + len, 0, __MDNS_PCAPNG_PAD(len) - len);
+
+	return(pos + sizeof(opt) + __MDNS_PCAPNG_PAD(len));
+}
+
+/*------------------------------------------------------------------------*/
+
+static uint8_t* mdns_capture_end(uint8_t* block, uint8_t* pos)
+{
+	mdns_pcapng_opt_t opt = {__MDNS_PCAPNG_OPT_END, 0};
+	uint32_t len;
+
+	memcpy(pos, &opt, sizeof(opt));
+	pos += sizeof(opt);
+
+	/* total length is repeated at the end */
+	len = pos - block + sizeof(len);
+	memcpy(pos, &len, sizeof(len));
+	memcpy(block + offsetof(mdns_pcapng_block_t, len), &len, sizeof(len));
+
+	return(pos + sizeof(len));
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_capture_write_iface(mdns_capture_t* c, unsigned iface)
+{
+	uint8_t* block = c->map + c->pos;
+	mdns_pcapng_idb_t idb;
+	uint8_t* pos;
+
+	memset(&idb, 0, sizeof(idb));
+	idb.hdr.type = __MDNS_PCAPNG_IDB;
+	idb.linktype = __MDNS_LINKTYPE_RAW;
+
+	memcpy(block, &idb, sizeof(idb));
+	pos = block + sizeof(idb);
+
+	pos = mdns_capture_option(pos, __MDNS_PCAPNG_IF_NAME, c->names[iface], strlen(c->names[iface]));
+
+	/* timestamps are in nanoseconds */
+	pos = mdns_capture_option(pos, __MDNS_PCAPNG_IF_TSRESOL, &(uint8_t){9}, 1);
+
+	c->pos += mdns_capture_end(block, pos) - block;
+}
+
+/*------------------------------------------------------------------------*/
+
+static int mdns_capture_start(mdns_capture_t* c)
+{
+	mdns_pcapng_shb_t shb;
+	char name[4096];
+	unsigned i;
+
+	snprintf(name, sizeof(name), "%s.%u", c->path, c->file);
+
+	if((c->fd = open(name, O_RDWR | O_CREAT | O_TRUNC, 0644)) == -1) {
+		return(-1);
+	}
+
+	/* pages are allocated by writes into mapping */
+	if(ftruncate(c->fd, MDNS_CAPTURE_SIZE) == -1) {
+		goto error;
+	}
+
+	if((c->map = mmap(NULL, MDNS_CAPTURE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, c->fd, 0)) == MAP_FAILED) {
+		goto error;
+	}
+
+	memset(&shb, 0, sizeof(shb));
+	shb.hdr.type = __MDNS_PCAPNG_SHB;
+	shb.magic = __MDNS_PCAPNG_MAGIC;
+	shb.major = 1;
+	shb.section_len = UINT64_MAX;
+
+	memcpy(c->map, &shb, sizeof(shb));
+	c->pos = mdns_capture_end(c->map, c->map + sizeof(shb)) - c->map;
+
+	/* numbers of interfaces are numbers of their blocks in section */
+	for(i = 0; i < c->ifaces; ++ i) {
+		mdns_capture_write_iface(c, i);
+	}
+
+	++ c->files;
+
+	return(0);
+
+error:
+	close(c->fd);
+	c->fd = -1;
+	c->map = NULL;
+
+	return(-1);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_capture_finish(mdns_capture_t* c)
+{
+	char name[4096];
+
+	munmap(c->map, MDNS_CAPTURE_SIZE);
+	c->map = NULL;
+
+	/* unused tail of mapping is cut off, otherwise file ends with zeros */
+	if(ftruncate(c->fd, c->pos) == -1) {
+		snprintf(name, sizeof(name), "%s.%u", c->path, c->file);
+		perror(name);
+	}
+
+	close(c->fd);
+	c->fd = -1;
+}
+
+/*------------------------------------------------------------------------*/
+
+int mdns_capture_open(mdns_capture_t* c, const char* path)
+{
+	memset(c, 0, sizeof(*c));
+
+	c->path = path;
+
+	return(mdns_capture_start(c));
+}
+
+/*------------------------------------------------------------------------*/
+
+void mdns_capture_close(mdns_capture_t* c)
+{
+	if(c->fd != -1) {
+		mdns_capture_finish(c);
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+int mdns_capture_iface(mdns_capture_t* c, const char* name)
+{
+	if(c->fd == -1 || c->ifaces == MDNS_CAPTURE_IFACES) {
+		return(-1);
+	}
+
+	snprintf(c->names[c->ifaces], sizeof(c->names[c->ifaces]), "%s", name);
+
+	/* description must precede packets of interface */
+	mdns_capture_write_iface(c, c->ifaces);
+
+	return(c->ifaces ++);
+}
+
+/*------------------------------------------------------------------------*/
+
+static size_t mdns_capture_headers(uint8_t* pos, const struct sockaddr* src, size_t len)
+{
+	const struct sockaddr_in6* sin6 = (const struct sockaddr_in6*)src;
+	const struct sockaddr_in* sin = (const struct sockaddr_in*)src;
+	uint16_t* word = (uint16_t*)pos;
+	uint32_t sum = 0;
+	size_t ip_len;
+	int i;
+
+	if(src->sa_family == AF_INET6) {
+		ip_len = 40;
+
+		memset(pos, 0, ip_len);
+		pos[0] = 0x60;
+		*(uint16_t*)(pos + 4) = htons(8 + len);
+		pos[6] = IPPROTO_UDP;
+		pos[7] = 255;
+		memcpy(pos + 8, &sin6->sin6_addr, 16);
+		memcpy(pos + 24, &__MDNS_MC_GROUP6, 16);
+
+		*(uint16_t*)(pos + ip_len) = sin6->sin6_port;
+	} else {
+		ip_len = 20;
+
+		memset(pos, 0, ip_len);
+		pos[0] = 0x45;
+		*(uint16_t*)(pos + 2) = htons(ip_len + 8 + len);
+		pos[8] = 255;
+		pos[9] = IPPROTO_UDP;
+		memcpy(pos + 12, &sin->sin_addr, 4);
+		memcpy(pos + 16, &__MDNS_MC_GROUP, 4);
+
+		/* checksum of IPv4 header */
+		for(i = 0; i < 10; ++ i) {
+			sum += word[i];
+		}
+
+		sum = (sum & 0xffff) + (sum >> 16);
+		sum += sum >> 16;
+		word[5] = ~sum;
+
+		*(uint16_t*)(pos + ip_len) = sin->sin_port;
+	}
+
+	/* checksum of UDP is not calculated */
+	*(uint16_t*)(pos + ip_len + 2) = htons(__MDNS_PORT);
+	*(uint16_t*)(pos + ip_len + 4) = htons(8 + len);
+	*(uint16_t*)(pos + ip_len + 6) = 0;
+
+	return(ip_len + 8);
+}
+
+/*------------------------------------------------------------------------*/
+
+int mdns_capture_packet(mdns_capture_t* c, unsigned iface, int dir, const struct sockaddr* src, const struct timespec* ts, const void* buf, size_t len)
+{
+	uint8_t* block;
+	mdns_pcapng_epb_t epb;
+	struct timespec now;
+	uint64_t stamp;
+	uint8_t* pos;
+	size_t size;
+
+	if(c->fd == -1 || iface >= c->ifaces) {
+		return(-1);
+	}
+
+	size = sizeof(epb) + __MDNS_PCAPNG_PAD(__MDNS_CAPTURE_HEADERS + len) +
+		sizeof(mdns_pcapng_opt_t) * 2 + sizeof(uint32_t) * 2;
+
+	/* the next file of ring */
+	if(c->pos + size > MDNS_CAPTURE_SIZE) {
+		mdns_capture_finish(c);
+		c->file = (c->file + 1) % MDNS_CAPTURE_FILES;
+
+		if(mdns_capture_start(c)) {
+			return(-1);
+		}
+	}
+
+	if(!ts) {
+		clock_gettime(CLOCK_REALTIME, &now);
+		ts = &now;
+	}
+
+	stamp = ts->tv_sec * 1000000000ULL + ts->tv_nsec;
+
+	block = c->map + c->pos;
+	pos = block + sizeof(epb);
+
+	pos += mdns_capture_headers(pos, src, len);
+	memcpy(pos, buf, len);
+	pos += len;
+
+	epb.hdr.type = __MDNS_PCAPNG_EPB;
+	epb.iface = iface;
+	epb.ts_high = stamp >> 32;
+	epb.ts_low = stamp;
+	epb.cap_len = epb.len = pos - block - sizeof(epb);
+
+	memcpy(block, &epb, sizeof(epb));
+
+	/* data is padded before options */
+	memset(pos, 0, __MDNS_PCAPNG_PAD(epb.cap_len) - epb.cap_len);
+	pos += __MDNS_PCAPNG_PAD(epb.cap_len) - epb.cap_len;
+
+	/* direction is in the lowest bits of flags */
+	pos = mdns_capture_option(pos, __MDNS_PCAPNG_EPB_FLAGS, &(uint32_t){dir}, sizeof(uint32_t));
+
+	c->pos += mdns_capture_end(block, pos) - block;
+	++ c->packets;
+
+	return(0);
+}
@@ -0,0 +1,94 @@
+/* yamdns -- yet another very simple mdns.
+ * Copyright (C) 2013  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <yamdns/yamdns.h>
+
+#include "config.h"
+
+/*------------------------------------------------------------------------*/
+
+static void usage(const char* prog)
+{
+	printf("Usage: %s [-n hostname] config... database\n", prog);
+}
+
+/*------------------------------------------------------------------------*/
+
+int main(int narg, char** argv)
+{
+	char host_name[MDNS_MAX_NAME];
+	const char* hostname;
+	mdns_records_t t;
+	int exit_code = 1;
+	int opt;
+
+	hostname = getenv("HOSTNAME");
+
+	while((opt = getopt(narg, argv, "n:")) != -1) {
+		switch(opt) {
+			case 'n':
+				hostname = optarg;
+				break;
+
+			default:
+				usage(argv[0]);
+				return(exit_code);
+		}
+	}
+
+	if(optind + 2 > narg) {
+		usage(argv[0]);
+		return(exit_code);
+	}
+
+	if(!hostname) {
+		puts("HOSTNAME not defined");
+		return(exit_code);
+	}
+
+	/* services are pointed to this host */
+	snprintf(host_name, sizeof(host_name), "%s.%s", hostname, MDNS_DOMAIN);
+
+	mdns_records_init(&t);
+
+	for(; optind < narg - 1; ++ optind) {
+		if(mdns_config_load(&t, argv[optind], host_name)) {
+			perror(argv[optind]);
+			goto error;
+		}
+	}
+
+	if(mdns_records_save(&t, argv[narg - 1])) {
+		perror(argv[narg - 1]);
+		goto error;
+	}
+
+	printf("%u records, %u buckets, %u bytes of names and rdata\n",
+		t.count, t.nbuckets, t.pool_len
+	);
+
+	exit_code = 0;
+
+error:
+	mdns_records_free(&t);
+
+	return(exit_code);
+}
@@ -0,0 +1,312 @@
+/**
+ * @file config.c
+ *
+ * yamdns -- yet another very simple mdns.
+ * Copyright (C) 2013  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <libgen.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/inotify.h>
+
+#include <yamdns/yamdns.h>
+
+#include "config.h"
+
+/*------------------------------------------------------------------------*/
+
+/** max size of TXT rdata from config */
+#define __MDNS_CONFIG_MAX_TXT 1300
+
+/** max length of line of config */
+#define __MDNS_CONFIG_MAX_LINE (MDNS_MAX_NAME * 8)
+
+/** service is invalid */
+#define __MDNS_CONFIG_INVALID -1
+
+/** quoted token isn't closed */
+#define __MDNS_CONFIG_QUOTE -2
+
+/** line doesn't fit into buffer */
+#define __MDNS_CONFIG_LONG -3
+
+#ifdef MDNS_STATIC
+/** max size of config, it is read at once without stdio */
+#define __MDNS_CONFIG_MAX_FILE (16 << 10)
+#endif
+
+/*------------------------------------------------------------------------*/
+
+static char* mdns_config_token(char** line)
+{
+	char *pos, *token;
+
+	pos = *line;
+
+	while(isspace(*pos)) {
+		++ pos;
+	}
+
+	/* end of line is kept, so unclosed quote is seen by caller */
+	*line = pos;
+
+	if(!*pos || *pos == '#') {
+		return(NULL);
+	}
+
+	if(*pos == '"') {
+		token = ++ pos;
+
+		if(!(pos = strchr(pos, '"'))) {
+			return(NULL);
+		}
+	} else {
+		token = pos;
+
+		while(*pos && !isspace(*pos)) {
+			++ pos;
+		}
+	}
+
+	if(*pos) {
+		*pos ++ = 0;
+	}
+
+	*line = pos;
+
+	return(token);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int mdns_config_line(mdns_records_t* t, char* line, const char* host)
+{
+	uint8_t txt[__MDNS_CONFIG_MAX_TXT];
+	char *instance, *service, *port, *str, *end;
+	size_t txt_len, len;
+	unsigned long num;
+
+	/* skip empty lines and comments */
+	if(!(instance = mdns_config_token(&line))) {
+		return(*line == '"' ? __MDNS_CONFIG_QUOTE : 0);
+	}
+
+	if(!(service = mdns_config_token(&line)) || !(port = mdns_config_token(&line))) {
+		return(*line == '"' ? __MDNS_CONFIG_QUOTE : __MDNS_CONFIG_INVALID);
+	}
+
+	num = strtoul(port, &end, 10);
+	if(*end || num > 0xffff) {
+		return(__MDNS_CONFIG_INVALID);
+	}
+
+	/* each token is a length prefixed string of TXT rdata */
+	txt_len = 0;
+
+	while((str = mdns_config_token(&line))) {
+		len = strlen(str);
+
+		if(len > 0xff || txt_len + len + 1 > sizeof(txt)) {
+			return(__MDNS_CONFIG_INVALID);
+		}
+
+		txt[txt_len ++] = len;
+		memcpy(&txt[txt_len], str, len);
+		txt_len += len;
+	}
+
+	/* rest of line isn't dropped silently */
+	if(*line == '"') {
+		return(__MDNS_CONFIG_QUOTE);
+	}
+
+	return(mdns_records_add_service(t, instance, service, num, host, txt, txt_len) ? __MDNS_CONFIG_INVALID : 0);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_config_report(const char* path, unsigned lineno, int res)
+{
+	switch(res) {
+		case 0:
+			break;
+
+		case __MDNS_CONFIG_QUOTE:
+			fprintf(stderr, "%s:%u: unterminated quote, skipped\n", path, lineno);
+			break;
+
+		case __MDNS_CONFIG_LONG:
+			fprintf(stderr, "%s:%u: line is too long, skipped\n", path, lineno);
+			break;
+
+		default:
+			fprintf(stderr, "%s:%u: invalid service, skipped\n", path, lineno);
+			break;
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+#ifdef MDNS_STATIC
+int mdns_config_load(mdns_records_t* t, const char* path, const char* host)
+{
+	static char buf[__MDNS_CONFIG_MAX_FILE + 1];
+	unsigned lineno = 0;
+	char *line, *end;
+	size_t len = 0;
+	ssize_t res;
+	int fd;
+
+	/* fopen() would allocate buffer of stream */
+	if((fd = open(path, O_RDONLY | O_CLOEXEC)) == -1) {
+		return(-1);
+	}
+
+	while(len < sizeof(buf) && (res = read(fd, buf + len, sizeof(buf) - len))) {
+		if(res == -1 && errno != EINTR) {
+			close(fd);
+
+			return(-1);
+		}
+
+		len += res == -1 ? 0 : res;
+	}
+
+	close(fd);
+
+	if(len == sizeof(buf)) {
+		errno = EFBIG;
+
+		return(-1);
+	}
+
+	buf[len] = 0;
+
+	for(line = buf; *line; line = end) {
+		if((end = strchr(line, '\n'))) {
+			*end ++ = 0;
+		} else {
+			end = line + strlen(line);
+		}
+
+		++ lineno;
+
+		/* the same limit as of stdio build */
+		if(strlen(line) > __MDNS_CONFIG_MAX_LINE - 1) {
+			mdns_config_report(path, lineno, __MDNS_CONFIG_LONG);
+			continue;
+		}
+
+		mdns_config_report(path, lineno, mdns_config_line(t, line, host));
+	}
+
+	return(0);
+}
+#else
+int mdns_config_load(mdns_records_t* t, const char* path, const char* host)
+{
+	char line[__MDNS_CONFIG_MAX_LINE];
+	unsigned lineno = 0;
+	size_t len;
+	int c;
+	FILE* f;
+
+	if(!(f = fopen(path, "r"))) {
+		return(-1);
+	}
+
+	while(fgets(line, sizeof(line), f)) {
+		++ lineno;
+		len = strlen(line);
+
+		/* rest of long line is skipped, it isn't the next service */
+		if(len == sizeof(line) - 1 && line[len - 1] != '\n' && (c = fgetc(f)) != EOF && c != '\n') {
+			while((c = fgetc(f)) != EOF && c != '\n');
+
+			mdns_config_report(path, lineno, __MDNS_CONFIG_LONG);
+			continue;
+		}
+
+		mdns_config_report(path, lineno, mdns_config_line(t, line, host));
+	}
+
+	fclose(f);
+
+	return(0);
+}
+#endif
+
+/*------------------------------------------------------------------------*/
+
+int mdns_config_watch(const char* path)
+{
+	char dir[MDNS_MAX_NAME * 4];
+	int fd;
+
+	if(snprintf(dir, sizeof(dir), "%s", path) >= sizeof(dir)) {
+		return(-1);
+	}
+
+	if((fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) == -1) {
+		return(-1);
+	}
+
+	if(inotify_add_watch(fd, dirname(dir), IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE) == -1) {
+		close(fd);
+
+		return(-1);
+	}
+
+	return(fd);
+}
+
+/*------------------------------------------------------------------------*/
+
+int mdns_config_changed(int fd, const char* path)
+{
+	char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	char file[MDNS_MAX_NAME * 4];
+	const struct inotify_event* ev;
+	const char* name;
+	int changed = 0;
+	ssize_t len;
+	char* pos;
+
+	if(snprintf(file, sizeof(file), "%s", path) >= sizeof(file)) {
+		return(0);
+	}
+
+	name = basename(file);
+
+	/* drain all pending events */
+	while((len = read(fd, buf, sizeof(buf))) > 0) {
+		for(pos = buf; pos < buf + len; pos += sizeof(*ev) + ev->len) {
+			ev = (const struct inotify_event*)pos;
+
+			if(ev->len && !strcmp(ev->name, name)) {
+				changed = 1;
+			}
+		}
+	}
+
+	return(changed);
+}
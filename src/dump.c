@@ -19,8 +19,14 @@
  */
 
 #include <stdio.h>
-#include <ctype.h>
-#include <stdint.h>
+#include <stdarg.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <arpa/inet.h>
+
+#include <yamdns/yamdns.h>
 
 #include "dump.h"
 
@@ -35,80 +41,354 @@
 /** length of group for hexdump8() */
 #define __HEXDUMP8_GROUP 4
 
+/** size of buffer of legacy functions */
+#define __DUMP_STDOUT 4096
+
+/** question of any type */
+#define __DUMP_TYPE_ANY 255
+
 /*------------------------------------------------------------------------*/
 
-void strdump(const void* buf, size_t len)
+/** digits of hex encoder */
+static const char __hex[16] = "0123456789abcdef";
+
+/*------------------------------------------------------------------------*/
+
+void mdns_dump_init(mdns_dump_t* d, char* buf, size_t size, int fd)
 {
-	const uint8_t* str = buf;
+	d->buf = buf;
+	d->size = size;
+	d->len = 0;
+	d->fd = fd;
+}
 
-	if(!len) {
+/*------------------------------------------------------------------------*/
+
+int mdns_dump_flush(mdns_dump_t* d)
+{
+	ssize_t res = 0;
+	size_t pos = 0;
+
+	if(d->fd == -1) {
+		return(0);
+	}
+
+	while(pos < d->len && (res = write(d->fd, d->buf + pos, d->len - pos)) > 0) {
+		pos += res;
+	}
+
+	d->len = 0;
+
+	return(res < 0 ? -1 : 0);
+}
+
+/*------------------------------------------------------------------------*/
+
+static size_t mdns_dump_room(mdns_dump_t* d, size_t len)
+{
+	/* text of one packet is split only if it doesn't fit into buffer */
+	if(d->len + len > d->size) {
+		mdns_dump_flush(d);
+	}
+
+	return(d->size - d->len);
+}
+
+/*------------------------------------------------------------------------*/
+
+void mdns_dump_write(mdns_dump_t* d, const char* str, size_t len)
+{
+	size_t room;
+
+	room = mdns_dump_room(d, len);
+
+	if(len > room) {
+		len = room;
+	}
+
+	memcpy(d->buf + d->len, str, len);
+	d->len += len;
+}
+
+/*------------------------------------------------------------------------*/
+
+void mdns_dump_printf(mdns_dump_t* d, const char* fmt, ...)
+{
+	size_t room;
+	va_list ap;
+	int res;
+
+	room = d->size - d->len;
+
+	va_start(ap, fmt);
+	res = vsnprintf(d->buf + d->len, room, fmt, ap);
+	va_end(ap);
+
+	if(res < 0) {
 		return;
 	}
 
+	/* format again after flush */
+	if((size_t)res >= room && d->fd != -1 && d->len) {
+		room = mdns_dump_room(d, res + 1);
+
+		va_start(ap, fmt);
+		res = vsnprintf(d->buf + d->len, room, fmt, ap);
+		va_end(ap);
+	}
+
+	/* terminating zero is not a part of text */
+	d->len += (size_t)res < room ? (size_t)res : room ? room - 1 : 0;
+}
+
+/*------------------------------------------------------------------------*/
+
+static char* mdns_dump_printable(char* pos, const uint8_t* str, size_t len)
+{
 	while(len --) {
-		putchar(isprint(*str) ? *str : '.');
+		*pos ++ = *str >= 0x20 && *str < 0x7f ? *str : '.';
 
 		++ str;
 	}
+
+	return(pos);
 }
 
 /*------------------------------------------------------------------------*/
 
-void hexdump8(const void* buf, size_t len)
+void mdns_dump_str(mdns_dump_t* d, const void* buf, size_t len)
 {
-	const uint8_t* data = buf;
-	size_t i, spaces, tail;
+	const uint8_t* str = buf;
+	char chunk[256];
+	size_t n;
 
-	if(!len) {
-		return;
+	while(len) {
+		n = len < sizeof(chunk) ? len : sizeof(chunk);
+
+		mdns_dump_printable(chunk, str, n);
+		mdns_dump_write(d, chunk, n);
+
+		str += n;
+		len -= n;
 	}
+}
 
-	for(i = 0; i < len; ++ i) {
-		/* print data like a string */
-		if(i % __HEXDUMP8_ALIGN == 0) {
-			if(i) {
-				printf(" | ");
-				strdump(data - __HEXDUMP8_ALIGN, __HEXDUMP8_ALIGN);
-				putchar('\n');
+/*------------------------------------------------------------------------*/
+
+void mdns_dump_hex(mdns_dump_t* d, const void* buf, size_t len)
+{
+	const uint8_t* data = buf;
+	char line[128];
+	size_t i, n;
+	char* pos;
+	int res;
+
+	for(; len; data += n, len -= n) {
+		n = len < __HEXDUMP8_ALIGN ? len : __HEXDUMP8_ALIGN;
+
+		if((res = snprintf(line, sizeof(line), "%p |", (const void*)data)) < 0) {
+			return;
+		}
+
+		pos = line + res;
+
+		for(i = 0; i < __HEXDUMP8_ALIGN; ++ i) {
+			/* group by __HEXDUMP8_GROUP bytes */
+			if(i % __HEXDUMP8_GROUP == 0) {
+				*pos ++ = ' ';
 			}
 
-			printf("%p |", (void*)data);
+			/* spaces align tail */
+			if(i < n) {
+				*pos ++ = __hex[data[i] >> 4];
+				*pos ++ = __hex[data[i] & 0x0f];
+			} else {
+				*pos ++ = ' ';
+				*pos ++ = ' ';
+			}
 		}
 
-		/* group by __HEXDUMP8_GROUP bytes */
-		if(i % __HEXDUMP8_GROUP == 0) {
-			putchar(' ');
+		/* data like a string */
+		memcpy(pos, " | ", 3);
+		pos = mdns_dump_printable(pos + 3, data, n);
+		*pos ++ = '\n';
+
+		mdns_dump_write(d, line, pos - line);
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+int mdns_dump_filter_packet(const mdns_dump_filter_t* f, int dir, const struct sockaddr* from)
+{
+	const struct sockaddr_in6* src6;
+	const struct sockaddr_in* src;
+
+	if(!f) {
+		return(1);
+	}
+
+	if(f->dir && !(f->dir & dir)) {
+		return(0);
+	}
+
+	if(f->source.ss_family == AF_UNSPEC) {
+		return(1);
+	}
+
+	/* sent packets have no source */
+	if(dir == MDNS_DUMP_OUT || !from || from->sa_family != f->source.ss_family) {
+		return(0);
+	}
+
+	src6 = (const struct sockaddr_in6*)&f->source;
+	src = (const struct sockaddr_in*)&f->source;
+
+	if(from->sa_family == AF_INET6) {
+		return(!memcmp(&((const struct sockaddr_in6*)from)->sin6_addr, &src6->sin6_addr, sizeof(src6->sin6_addr)));
+	}
+
+	return(((const struct sockaddr_in*)from)->sin_addr.s_addr == src->sin_addr.s_addr);
+}
+
+/*------------------------------------------------------------------------*/
+
+int mdns_dump_filter_record(const mdns_dump_filter_t* f, const char* name, uint16_t type)
+{
+	size_t len, suffix;
+	unsigned i;
+
+	if(!f) {
+		return(1);
+	}
+
+	if(f->types_count && type != __DUMP_TYPE_ANY) {
+		for(i = 0; i < f->types_count && f->types[i] != type; ++ i);
+
+		if(i == f->types_count) {
+			return(0);
 		}
+	}
 
-		printf("%02x", *data ++);
+	if(!f->names_count) {
+		return(1);
 	}
 
-	/* calculate size of align */
-	spaces = len;
-	tail = len % __HEXDUMP8_ALIGN;
+	len = strlen(name);
 
-	if(tail) {
-		spaces += __HEXDUMP8_ALIGN - tail;
-	} else {
-		tail = __HEXDUMP8_ALIGN;
+	/* root label is optional on both sides */
+	if(len && name[len - 1] == '.') {
+		-- len;
 	}
 
-	/* print spaces to align tail */
-	while(i < spaces) {
-		/* group by __HEXDUMP8_GROUP byte */
-		if(i % __HEXDUMP8_GROUP == 0) {
-			putchar(' ');
+	/* name itself or its subdomain */
+	for(i = 0; i < f->names_count; ++ i) {
+		suffix = strlen(f->names[i]);
+
+		if(suffix && f->names[i][suffix - 1] == '.') {
+			-- suffix;
+		}
+
+		if(suffix <= len && !strncasecmp(name + len - suffix, f->names[i], suffix) &&
+		   (suffix == len || !suffix || name[len - suffix - 1] == '.')) {
+			return(1);
 		}
+	}
 
-		++ i;
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+int mdns_dump_filter_add(mdns_dump_filter_t* f, const char* arg)
+{
+	struct sockaddr_in6* sin6 = (struct sockaddr_in6*)&f->source;
+	struct sockaddr_in* sin = (struct sockaddr_in*)&f->source;
+	unsigned long type;
+	char* end;
+
+	if(!strcmp(arg, "in")) {
+		f->dir |= MDNS_DUMP_IN;
+		return(0);
+	}
 
-		printf("  ");
+	if(!strcmp(arg, "out")) {
+		f->dir |= MDNS_DUMP_OUT;
+		return(0);
 	}
 
-	/* print data tail */
-	printf(" | ");
-	strdump(data - tail, tail);
-	putchar('\n');
+	if(!strncmp(arg, "from=", 5)) {
+		if(inet_pton(AF_INET, arg + 5, &sin->sin_addr) == 1) {
+			sin->sin_family = AF_INET;
+		} else if(inet_pton(AF_INET6, arg + 5, &sin6->sin6_addr) == 1) {
+			sin6->sin6_family = AF_INET6;
+		} else {
+			return(-1);
+		}
+
+		return(0);
+	}
+
+	if(!strncmp(arg, "type=", 5)) {
+		if(f->types_count == MDNS_DUMP_FILTER_MAX) {
+			return(-1);
+		}
+
+		/* number or name of type */
+		type = strtoul(arg + 5, &end, 0);
+
+		/* mnemonic of RFC 1035 is taken as well as name of dump */
+		if(!strcasecmp(arg + 5, "TXT")) {
+			type = MDNS_RECORD_TEXT;
+		} else if(end == arg + 5 || *end) {
+			for(type = 1; type < MDNS_RECORD_ANY && strcasecmp(mdns_str_type(type), arg + 5); ++ type);
+		}
+
+		if(!type || type >= MDNS_RECORD_ANY) {
+			return(-1);
+		}
+
+		f->types[f->types_count ++] = type;
+
+		return(0);
+	}
+
+	if(f->names_count == MDNS_DUMP_FILTER_MAX) {
+		return(-1);
+	}
+
+	f->names[f->names_count ++] = arg;
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+void strdump(const void* buf, size_t len)
+{
+	char text[__DUMP_STDOUT];
+	mdns_dump_t d;
+
+	/* previous output of stdio goes first */
+	fflush(stdout);
+
+	mdns_dump_init(&d, text, sizeof(text), STDOUT_FILENO);
+	mdns_dump_str(&d, buf, len);
+	mdns_dump_flush(&d);
+}
+
+/*------------------------------------------------------------------------*/
+
+void hexdump8(const void* buf, size_t len)
+{
+	char text[__DUMP_STDOUT];
+	mdns_dump_t d;
+
+	fflush(stdout);
+
+	mdns_dump_init(&d, text, sizeof(text), STDOUT_FILENO);
+	mdns_dump_hex(&d, buf, len);
+	mdns_dump_flush(&d);
 }
 
 /*------------------------------------------------------------------------*/
@@ -116,19 +396,35 @@ void hexdump8(const void* buf, size_t len)
 void cdump8(const char* name, const void* buf, size_t len)
 {
 	const uint8_t* data = buf;
+	char text[__DUMP_STDOUT];
+	char byte[8] = ", 0x";
+	mdns_dump_t d;
 	size_t i;
 
 	if(!len) {
 		return;
 	}
 
-	printf("uint8_t %s[%zd] = {\n\t0x%02x", name, len, *data ++);
+	fflush(stdout);
+
+	mdns_dump_init(&d, text, sizeof(text), STDOUT_FILENO);
+	mdns_dump_printf(&d, "uint8_t %s[%zd] = {\n\t0x", name, len);
 
-	for(i = 1; i < len; ++ i) {
-		printf(i % __CDUMP8_ALIGN ? ", " : ",\n\t");
+	for(i = 0; i < len; ++ i) {
+		byte[4] = __hex[data[i] >> 4];
+		byte[5] = __hex[data[i] & 0x0f];
 
-		printf("0x%02x", *data ++);
+		/* the first byte follows its prefix */
+		if(!i) {
+			mdns_dump_write(&d, byte + 4, 2);
+		} else if(i % __CDUMP8_ALIGN) {
+			mdns_dump_write(&d, byte, 6);
+		} else {
+			mdns_dump_write(&d, ",\n\t0x", 5);
+			mdns_dump_write(&d, byte + 4, 2);
+		}
 	}
 
-	printf("\n};\n");
+	mdns_dump_write(&d, "\n};\n", 4);
+	mdns_dump_flush(&d);
 }
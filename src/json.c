@@ -0,0 +1,403 @@
+/**
+ * @file json.c
+ *
+ * yamdns -- yet another very simple mdns.
+ * Copyright (C) 2013  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <arpa/inet.h>
+
+#include <yamdns/yamdns.h>
+
+#include "json.h"
+
+/*------------------------------------------------------------------------*/
+
+/** top bit of class, cache flush of record or unicast response of question */
+#define __MDNS_JSON_CLASS_BIT 0x8000
+
+/** max length of fields of packet */
+#define __MDNS_JSON_PREFIX 192
+
+/*------------------------------------------------------------------------*/
+
+/** digits of hex encoder */
+static const char __hex[16] = "0123456789abcdef";
+
+/*------------------------------------------------------------------------*/
+
+/** context of handlers */
+typedef struct mdns_json_ctx {
+	/** output */
+	mdns_dump_t* d;
+
+	/** filter or NULL */
+	const mdns_dump_filter_t* f;
+
+	/** header of packet */
+	const mdns_hdr_t* hdr;
+
+	/** number of current record */
+	unsigned index;
+
+	/** number of written objects */
+	unsigned count;
+
+	/** length of prefix */
+	size_t prefix_len;
+
+	/** fields of packet, written at start of each object */
+	char prefix[__MDNS_JSON_PREFIX];
+} mdns_json_ctx_t;
+
+/*------------------------------------------------------------------------*/
+
+static size_t mdns_json_utf8(const uint8_t* pos, size_t len)
+{
+	uint32_t cp;
+	size_t n, i;
+
+	if(*pos < 0xc2 || *pos > 0xf4) {
+		/* continuation, overlong lead or beyond U+10FFFF */
+		return(0);
+	} else if(*pos < 0xe0) {
+		n = 2;
+		cp = *pos & 0x1f;
+	} else if(*pos < 0xf0) {
+		n = 3;
+		cp = *pos & 0x0f;
+	} else {
+		n = 4;
+		cp = *pos & 0x07;
+	}
+
+	if(n > len) {
+		return(0);
+	}
+
+	for(i = 1; i < n; ++ i) {
+		if((pos[i] & 0xc0) != 0x80) {
+			return(0);
+		}
+
+		cp = (cp << 6) | (pos[i] & 0x3f);
+	}
+
+	/* overlong forms, surrogates and code points above U+10FFFF */
+	if((n == 3 && cp < 0x800) || (cp >= 0xd800 && cp <= 0xdfff) || (n == 4 && (cp < 0x10000 || cp > 0x10ffff))) {
+		return(0);
+	}
+
+	return(n);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_json_string(mdns_dump_t* d, const char* str, size_t len)
+{
+	const uint8_t* pos = (const uint8_t*)str;
+	char chunk[256];
+	size_t n = 0, seq;
+
+	chunk[n ++] = '"';
+
+	while(len --) {
+		/* the longest escape is \u00XX */
+		if(n > sizeof(chunk) - 8) {
+			mdns_dump_write(d, chunk, n);
+			n = 0;
+		}
+
+		if(*pos == '"' || *pos == '\\') {
+			chunk[n ++] = '\\';
+			chunk[n ++] = *pos;
+		} else if(*pos >= 0x20 && *pos < 0x7f) {
+			chunk[n ++] = *pos;
+		} else if(*pos >= 0x80 && (seq = mdns_json_utf8(pos, len + 1))) {
+			/* valid UTF-8 is kept as is */
+			memcpy(chunk + n, pos, seq);
+			n += seq;
+			pos += seq - 1;
+			len -= seq - 1;
+		} else {
+			/* controls and invalid UTF-8 bytes are escaped by their value */
+			memcpy(chunk + n, "\\u00", 4);
+			chunk[n + 4] = __hex[*pos >> 4];
+			chunk[n + 5] = __hex[*pos & 0x0f];
+			n += 6;
+		}
+
+		++ pos;
+	}
+
+	chunk[n ++] = '"';
+
+	mdns_dump_write(d, chunk, n);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_json_type(mdns_json_ctx_t* c, const char* section, const char* name, uint16_t type, uint16_t class)
+{
+	const char* type_name = mdns_str_type(type);
+
+	mdns_dump_write(c->d, c->prefix, c->prefix_len);
+	mdns_dump_printf(c->d, "\"section\":\"%s\",\"name\":", section);
+	mdns_json_string(c->d, name, strlen(name));
+	mdns_dump_printf(c->d, ",\"type\":%u,\"type_name\":\"%s\",\"class\":%u,",
+		type, type_name, class & ~__MDNS_JSON_CLASS_BIT);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_json_query_handler(void* ctx, const mdns_query_hdr_t* h, const char* root)
+{
+	mdns_json_ctx_t* c = ctx;
+
+	if(!mdns_dump_filter_record(c->f, root, ntohs(h->q_type))) {
+		return;
+	}
+
+	mdns_json_type(c, "question", root, ntohs(h->q_type), ntohs(h->q_class));
+	mdns_dump_printf(c->d, "\"unicast\":%s}\n", ntohs(h->q_class) & __MDNS_JSON_CLASS_BIT ? "true" : "false");
+
+	++ c->count;
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_json_record_handler(void* ctx, const mdns_answer_hdr_t* h, const char* root, const void* rdata, size_t len)
+{
+	mdns_json_ctx_t* c = ctx;
+
+	/* called before handler of type, so section is known */
+	++ c->index;
+}
+
+/*------------------------------------------------------------------------*/
+
+static int mdns_json_record(mdns_json_ctx_t* c, const mdns_answer_hdr_t* h, const char* root)
+{
+	const char* section = "additional";
+
+	if(!mdns_dump_filter_record(c->f, root, ntohs(h->a_type))) {
+		return(0);
+	}
+
+	if(c->index <= ntohs(c->hdr->an_cnt)) {
+		section = "answer";
+	} else if(c->index <= ntohs(c->hdr->an_cnt) + ntohs(c->hdr->ns_cnt)) {
+		section = "authority";
+	}
+
+	mdns_json_type(c, section, root, ntohs(h->a_type), ntohs(h->a_class));
+	mdns_dump_printf(c->d, "\"flush\":%s,\"ttl\":%u,\"rdata\":{",
+		ntohs(h->a_class) & __MDNS_JSON_CLASS_BIT ? "true" : "false", ntohl(h->a_ttl));
+
+	++ c->count;
+
+	return(1);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_json_answer_handler_a(void* ctx, const mdns_answer_hdr_t* h, const char* root, struct in_addr* in)
+{
+	char addr[INET_ADDRSTRLEN];
+
+	if(mdns_json_record(ctx, h, root)) {
+		mdns_dump_printf(((mdns_json_ctx_t*)ctx)->d, "\"address\":\"%s\"}}\n", inet_ntop(AF_INET, in, addr, sizeof(addr)));
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_json_answer_handler_aaaa(void* ctx, const mdns_answer_hdr_t* h, const char* root, struct in6_addr* in6)
+{
+	char addr[INET6_ADDRSTRLEN];
+
+	if(mdns_json_record(ctx, h, root)) {
+		mdns_dump_printf(((mdns_json_ctx_t*)ctx)->d, "\"address\":\"%s\"}}\n", inet_ntop(AF_INET6, in6, addr, sizeof(addr)));
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_json_answer_handler_ptr(void* ctx, const mdns_answer_hdr_t* h, const char* root, const char* ptr)
+{
+	mdns_json_ctx_t* c = ctx;
+
+	if(mdns_json_record(c, h, root)) {
+		mdns_dump_write(c->d, "\"target\":", 9);
+		mdns_json_string(c->d, ptr, strlen(ptr));
+		mdns_dump_write(c->d, "}}\n", 3);
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_json_answer_handler_text(void* ctx, const mdns_answer_hdr_t* h, const char* root, const mdns_text_t* text)
+{
+	mdns_json_ctx_t* c = ctx;
+	mdns_text_iter_t it;
+	const char* str;
+	size_t len;
+	int first = 1;
+
+	if(!mdns_json_record(c, h, root)) {
+		return;
+	}
+
+	mdns_dump_write(c->d, "\"strings\":[", 11);
+	mdns_text_iter_init(&it, text);
+
+	while(mdns_text_next(&it, &str, &len) > 0) {
+		if(!first) {
+			mdns_dump_write(c->d, ",", 1);
+		}
+
+		mdns_json_string(c->d, str, len);
+		first = 0;
+	}
+
+	mdns_dump_write(c->d, "]}}\n", 4);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_json_answer_handler_srv(void* ctx, const mdns_answer_hdr_t* h, const char* root, mdns_record_srv_t* srv, const char* target)
+{
+	mdns_json_ctx_t* c = ctx;
+
+	if(mdns_json_record(c, h, root)) {
+		mdns_dump_printf(c->d, "\"priority\":%u,\"weight\":%u,\"port\":%u,\"target\":",
+			ntohs(srv->priority), ntohs(srv->weight), ntohs(srv->port));
+		mdns_json_string(c->d, target, strlen(target));
+		mdns_dump_write(c->d, "}}\n", 3);
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_json_answer_handler_raw(void* ctx, const mdns_answer_hdr_t* h, const char* root, const void* buf, size_t len)
+{
+	const uint8_t* pos = buf;
+	mdns_json_ctx_t* c = ctx;
+	char chunk[256];
+	size_t n = 0;
+
+	if(!mdns_json_record(c, h, root)) {
+		return;
+	}
+
+	mdns_dump_write(c->d, "\"hex\":\"", 7);
+
+	while(len --) {
+		if(n == sizeof(chunk)) {
+			mdns_dump_write(c->d, chunk, n);
+			n = 0;
+		}
+
+		chunk[n ++] = __hex[*pos >> 4];
+		chunk[n ++] = __hex[*pos & 0x0f];
+		++ pos;
+	}
+
+	mdns_dump_write(c->d, chunk, n);
+	mdns_dump_write(c->d, "\"}}\n", 4);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_json_prefix(mdns_json_ctx_t* c, const mdns_json_source_t* src)
+{
+	const struct sockaddr_in6* sin6 = (const struct sockaddr_in6*)src->from;
+	const struct sockaddr_in* sin = (const struct sockaddr_in*)src->from;
+	char addr[INET6_ADDRSTRLEN];
+	size_t size = sizeof(c->prefix);
+	char* pos = c->prefix;
+	int res;
+
+	res = snprintf(pos, size, "{\"time\":%lld.%09ld,\"iface\":%u,",
+		(long long)src->ts.tv_sec, src->ts.tv_nsec, src->iface);
+	pos += res; size -= res;
+
+	if(src->dir) {
+		res = snprintf(pos, size, "\"dir\":\"%s\",", src->dir == MDNS_DUMP_IN ? "in" : "out");
+		pos += res; size -= res;
+	}
+
+	if(src->from && src->from->sa_family == AF_INET6) {
+		res = snprintf(pos, size, "\"from\":\"%s\",\"port\":%u,",
+			inet_ntop(AF_INET6, &sin6->sin6_addr, addr, sizeof(addr)), ntohs(sin6->sin6_port));
+		pos += res; size -= res;
+	} else if(src->from) {
+		res = snprintf(pos, size, "\"from\":\"%s\",\"port\":%u,",
+			inet_ntop(AF_INET, &sin->sin_addr, addr, sizeof(addr)), ntohs(sin->sin_port));
+		pos += res; size -= res;
+	}
+
+	res = snprintf(pos, size, "\"id\":%u,\"flags\":%u,", ntohs(c->hdr->id), ntohs(c->hdr->flags));
+	pos += res;
+
+	c->prefix_len = pos - c->prefix;
+}
+
+/*------------------------------------------------------------------------*/
+
+unsigned mdns_json_packet(mdns_dump_t* d, const mdns_dump_filter_t* f, const mdns_json_source_t* src, const void* buf, size_t len)
+{
+	mdns_handlers_t handlers = {
+		.q = mdns_json_query_handler,
+		.rr = mdns_json_record_handler,
+		.a = mdns_json_answer_handler_a,
+		.aaaa = mdns_json_answer_handler_aaaa,
+		.ptr = mdns_json_answer_handler_ptr,
+		.text = mdns_json_answer_handler_text,
+		.srv = mdns_json_answer_handler_srv,
+		.raw = mdns_json_answer_handler_raw,
+	};
+	mdns_json_ctx_t c;
+	size_t ret;
+
+	if(len < sizeof(mdns_hdr_t) || !mdns_dump_filter_packet(f, src->dir, src->from)) {
+		return(0);
+	}
+
+	c.d = d;
+	c.f = f;
+	c.hdr = buf;
+	c.index = 0;
+	c.count = 0;
+
+	mdns_json_prefix(&c, src);
+
+	/* records are written while packet is parsed */
+	if((ret = mdns_packet_process(buf, len, &handlers, &c)) != len) {
+		mdns_dump_write(d, c.prefix, c.prefix_len);
+		mdns_dump_printf(d, "\"error\":\"malformed\",\"length\":%zu}\n", len);
+		++ c.count;
+	}
+
+	/* one write per packet */
+	if(c.count) {
+		mdns_dump_flush(d);
+	}
+
+	return(c.count);
+}
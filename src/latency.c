@@ -0,0 +1,126 @@
+/**
+ * @file latency.c
+ *
+ * yamdns -- yet another very simple mdns.
+ * Copyright (C) 2013  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "latency.h"
+
+/*------------------------------------------------------------------------*/
+
+/** number of sub-buckets of one magnitude */
+#define __MDNS_HIST_SUB (1U << MDNS_HIST_SUB_BITS)
+
+/*------------------------------------------------------------------------*/
+
+static unsigned mdns_hist_index(uint64_t ns)
+{
+	unsigned shift;
+
+	/* exact values */
+	if(ns < __MDNS_HIST_SUB) {
+		return(ns);
+	}
+
+	/* keep the highest bit and sub-bucket bits below it */
+	shift = 63 - __builtin_clzll(ns) - MDNS_HIST_SUB_BITS;
+
+	if(shift >= MDNS_HIST_MAGNITUDES - MDNS_HIST_SUB_BITS) {
+		return(MDNS_HIST_BUCKETS - 1);
+	}
+
+	return((shift << MDNS_HIST_SUB_BITS) + (ns >> shift));
+}
+
+/*------------------------------------------------------------------------*/
+
+static uint64_t mdns_hist_value(unsigned idx)
+{
+	unsigned shift;
+
+	if(idx < __MDNS_HIST_SUB) {
+		return(idx);
+	}
+
+	shift = (idx >> MDNS_HIST_SUB_BITS) - 1;
+
+	/* the highest value of bucket */
+	return((((uint64_t)(idx & (__MDNS_HIST_SUB - 1)) + __MDNS_HIST_SUB + 1) << shift) - 1);
+}
+
+/*------------------------------------------------------------------------*/
+
+void mdns_hist_record(mdns_hist_t* h, uint64_t ns)
+{
+	++ h->buckets[mdns_hist_index(ns)];
+	++ h->count;
+
+	if(ns > h->max) {
+		h->max = ns;
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+uint64_t mdns_hist_percentile(const mdns_hist_t* h, double p)
+{
+	uint64_t rank, seen = 0;
+	unsigned i;
+
+	if(!h->count) {
+		return(0);
+	}
+
+	rank = (uint64_t)(h->count * p / 100 + 0.5);
+
+	if(!rank) {
+		rank = 1;
+	}
+
+	for(i = 0; i < MDNS_HIST_BUCKETS; ++ i) {
+		if((seen += h->buckets[i]) >= rank) {
+			break;
+		}
+	}
+
+	/* bucket may be wider than recorded values */
+	return(mdns_hist_value(i) < h->max ? mdns_hist_value(i) : h->max);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_hist_print(const char* name, const mdns_hist_t* h, FILE* f)
+{
+	fprintf(f, "latency %s: count %llu, p50 %llu, p90 %llu, p99 %llu, p99.9 %llu, max %llu ns\n",
+		name, (unsigned long long)h->count,
+		(unsigned long long)mdns_hist_percentile(h, 50),
+		(unsigned long long)mdns_hist_percentile(h, 90),
+		(unsigned long long)mdns_hist_percentile(h, 99),
+		(unsigned long long)mdns_hist_percentile(h, 99.9),
+		(unsigned long long)h->max);
+}
+
+/*------------------------------------------------------------------------*/
+
+void mdns_latency_print(const mdns_latency_t* l, FILE* f)
+{
+	mdns_hist_print("queue", &l->queue, f);
+	mdns_hist_print("parse", &l->parse, f);
+	mdns_hist_print("lookup", &l->lookup, f);
+	mdns_hist_print("build", &l->build, f);
+	mdns_hist_print("total", &l->total, f);
+}
@@ -26,10 +26,25 @@
 #include <stdlib.h>
 #include <signal.h>
 #include <syslog.h>
+#include <poll.h>
+#include <time.h>
+#include <ifaddrs.h>
+#include <fcntl.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
 
 #include <yamdns/yamdns.h>
 
 #include "network.h"
+#include "config.h"
+#include "responder.h"
+#include "registry.h"
+#include "uring.h"
+#include "reflector.h"
+#include "capture.h"
+#include "dump.h"
+#include "json.h"
+#include "pool.h"
 
 /*------------------------------------------------------------------------*/
 
@@ -37,63 +52,676 @@ static int exit_code = 1;
 static int terminate = 0;
 
 static char host_name[MDNS_MAX_NAME];
-static char addr_name[MDNS_MAX_NAME];
 static const char* hostname;
+static const char* config;
+static const char* database;
+static const char* api_socket;
 static struct in_addr ifaddr;
+static unsigned ifindex;
+
+static mdns_responder_t responder;
+static mdns_registry_t registry;
+static mdns_batch_t batch;
+static mdns_batch_t batch6;
+static int sockfd6 = -1;
+static int reply_family = AF_UNSPEC;
+static mdns_uring_t uring;
+static int use_uring;
+static uint32_t drops;
+static uint32_t drops6;
+static struct timespec stamp;
+
+/** max number of reverse ranges from command line */
+#define MDNS_MAX_RANGES 64
+
+static const char* ranges[MDNS_MAX_RANGES];
+static int ranges_count;
+
+/** interface of address is the first one of reflector */
+static mdns_reflector_t reflector;
+static struct in_addr reflect_addrs[MDNS_REFLECT_IFACES];
+static int reflect_fds[MDNS_REFLECT_IFACES];
+static mdns_batch_t reflect_batches[MDNS_REFLECT_IFACES];
+static unsigned reflect_count = 1;
+static const char* reflect_types[MDNS_REFLECT_TYPES];
+static int reflect_types_count;
+
+/** capture replaces printing of packets */
+static mdns_capture_t capture;
+static const char* capture_path;
+
+/** readable dump of packets, one write per packet */
+static char dump_text[MDNS_MAX_PACKET * 8];
+static mdns_dump_t dump;
+static mdns_dump_filter_t dump_filter;
+
+/** NDJSON events instead of readable dump */
+static int use_json;
+
+#ifdef MDNS_STATIC
+/** buffer of stdout, stdio would allocate it */
+static char stdout_buf[BUFSIZ];
+#endif
+
+/** numbers of capture interfaces, reflector interfaces follow */
+enum {
+	MDNS_CAPTURE_SOCKET,
+	MDNS_CAPTURE_SOCKET6,
+	MDNS_CAPTURE_REFLECT,
+};
+
+/** sleeping hosts answered by proxy */
+static struct in_addr owners[MDNS_PROXY_OWNERS];
+static int owners_count;
+
+/** slots of descriptors for poll() */
+enum {
+	MDNS_POLL_SOCKET,
+	MDNS_POLL_SOCKET6,
+	MDNS_POLL_REFLECT,
+	MDNS_POLL_CONFIG = MDNS_POLL_REFLECT + MDNS_REFLECT_IFACES - 1,
+	MDNS_POLL_DB,
+	MDNS_POLL_API,
+	MDNS_POLL_CLIENT,
+	MDNS_POLL_MAX = MDNS_POLL_CLIENT + MDNS_REGISTRY_CLIENTS,
+};
 
-typedef struct mdns_ctx {
-	void* buf;
-	size_t len;
-} mdns_ctx_t;
+static struct pollfd fds[MDNS_POLL_MAX];
 
 /*------------------------------------------------------------------------*/
 
-static void mdns_dump_query_handler(void* ctx, const mdns_query_hdr_t* h, const char* root);
+void on_sigterm(int prm)
+{
+	terminate = 1;
+}
+
+/*------------------------------------------------------------------------*/
 
-mdns_handlers_t handlers = {
-	.q = mdns_dump_query_handler,
-};
+static uint64_t mdns_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return(ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000);
+}
 
 /*------------------------------------------------------------------------*/
 
-void on_sigterm(int prm)
+static void mdns_trace(unsigned iface, int dir, const char* label, const struct sockaddr* from, const struct timespec* ts, const void* buf, size_t len)
 {
-	terminate = 1;
+	mdns_json_source_t src;
+
+	if(capture_path) {
+		mdns_capture_packet(&capture, iface, dir == MDNS_DUMP_IN ? MDNS_CAPTURE_IN : MDNS_CAPTURE_OUT, from, ts, buf, len);
+		return;
+	}
+
+	if(use_json) {
+		if(ts) {
+			src.ts = *ts;
+		} else {
+			clock_gettime(CLOCK_REALTIME, &src.ts);
+		}
+
+		src.iface = iface;
+		src.dir = dir;
+		src.from = from;
+
+		mdns_json_packet(&dump, &dump_filter, &src, buf, len);
+		return;
+	}
+
+	/* source of sent packet is our own address */
+	mdns_packet_dump_to(&dump, &dump_filter, dir, label, dir == MDNS_DUMP_IN ? from : NULL, buf, len);
 }
 
 /*------------------------------------------------------------------------*/
 
-static void mdns_dump_query_handler(void* ctx, const mdns_query_hdr_t* h, const char* root)
+static int mdns_send_handler_dump(void* ctx, const void* buf, size_t len)
 {
-	mdns_ctx_t* priv = ctx;
+	int res = 0;
+
+	/* answer goes to family of query, probes and announcements go to both */
+	if(reply_family != AF_INET6) {
+		/* packets are sent together at the end of loop iteration */
+		if(use_uring) {
+			res = mdns_uring_add(&uring, buf, len);
+		} else {
+			res = mdns_batch_add(ctx, buf, len);
+		}
 
-	if(!strcmp(root, host_name)) {
-		mdns_packet_add_answer_in(priv->buf, priv->len, 60, root, ifaddr);
-	} else if(!strcmp(root, addr_name)) {
-		mdns_packet_add_answer_in_ptr(priv->buf, priv->len, 60, root, host_name);
+		/* print sended packet */
+		mdns_trace(MDNS_CAPTURE_SOCKET, MDNS_DUMP_OUT, "(out)", (const struct sockaddr*)&(struct sockaddr_in) {
+			.sin_family = AF_INET, .sin_port = htons(__MDNS_PORT), .sin_addr = ifaddr}, NULL, buf, len);
 	}
+
+	if(sockfd6 == -1 || reply_family == AF_INET) {
+		return(res);
+	}
+
+	if(reply_family == AF_INET6) {
+		res = mdns_batch_add(&batch6, buf, len);
+	} else {
+		mdns_batch_add(&batch6, buf, len);
+	}
+
+	/* readable dump shows the copy of other family once */
+	if(reply_family == AF_INET6 || capture_path || use_json) {
+		mdns_trace(MDNS_CAPTURE_SOCKET6, MDNS_DUMP_OUT, "(out)", (const struct sockaddr*)&(struct sockaddr_in6) {
+			.sin6_family = AF_INET6, .sin6_port = htons(__MDNS_PORT)}, NULL, buf, len);
+	}
+
+	return(res);
 }
 
 /*------------------------------------------------------------------------*/
 
-int main(int narg, char** argv)
+static void mdns_flush(void)
+{
+	unsigned i;
+
+	if(use_uring) {
+		mdns_uring_flush(&uring);
+	} else {
+		mdns_batch_flush(&batch);
+	}
+
+	mdns_batch_flush(&batch6);
+
+	for(i = 1; i < reflect_count; ++ i) {
+		mdns_batch_flush(&reflect_batches[i]);
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_receive_handler_dump(void* ctx, const void* buf, size_t len, const struct sockaddr_in* sa)
+{
+	/* print received packet */
+	mdns_trace(MDNS_CAPTURE_SOCKET, MDNS_DUMP_IN, "(in)", (const struct sockaddr*)sa,
+		use_uring ? &uring.stamp : &stamp, buf, len);
+
+	/* kernel drops put daemon under pressure */
+	mdns_overload_drops(&responder.overload, 0, use_uring ? uring.drops : drops, mdns_now());
+
+	mdns_responder_snoop(&responder, &sa->sin_addr, buf, len);
+	mdns_responder_admit(&responder, &sa->sin_addr, sizeof(sa->sin_addr), buf, len);
+	mdns_responder_stamp(&responder, use_uring ? &uring.stamp : &stamp);
+
+	reply_family = AF_INET;
+	mdns_responder_family(&responder, reply_family);
+
+	/* queries of one receive pass of io_uring are answered together */
+	if(use_uring) {
+		mdns_responder_defer(&responder, buf, len);
+	} else {
+		mdns_responder_process(&responder, buf, len);
+	}
+
+	reply_family = AF_UNSPEC;
+
+	mdns_reflector_process(&reflector, 0, buf, len, mdns_now());
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_receive_done(void* ctx)
 {
+	/* questions are answered after all records of packets are checked */
+	reply_family = AF_INET;
+	mdns_responder_family(&responder, reply_family);
+	mdns_responder_process_deferred(&responder);
+	reply_family = AF_UNSPEC;
+}
+
+/*------------------------------------------------------------------------*/
+
+static int mdns_reflect_handler_dump(void* ctx, unsigned iface, const void* buf, size_t len)
+{
+	char label[32];
+	int res;
+
+	/* interface of address shares the queue of responder */
+	if(iface) {
+		res = mdns_batch_add(&reflect_batches[iface], buf, len);
+	} else if(use_uring) {
+		res = mdns_uring_add(&uring, buf, len);
+	} else {
+		res = mdns_batch_add(&batch, buf, len);
+	}
+
+	/* print forwarded packet */
+	snprintf(label, sizeof(label), "(reflect %u)", iface);
+	mdns_trace(iface ? MDNS_CAPTURE_REFLECT + iface - 1 : MDNS_CAPTURE_SOCKET, MDNS_DUMP_OUT, label, (const struct sockaddr*)&(struct sockaddr_in) {
+		.sin_family = AF_INET, .sin_port = htons(__MDNS_PORT), .sin_addr = iface ? reflect_addrs[iface] : ifaddr}, NULL, buf, len);
+
+	return(res);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int mdns_reflect_receive(unsigned iface)
+{
+	uint8_t bufin[MDNS_MAX_PACKET];
 	struct sockaddr_in sa;
 	socklen_t sa_len;
-	uint8_t bufin[1500];
-	uint8_t bufout[1500];
-	mdns_ctx_t ctx = {.buf = bufout, .len = sizeof(bufout),};
+	char label[32];
+	int res;
+
+	sa_len = sizeof(sa);
+
+	/* receive packet */
+	if((res = recvfrom(reflect_fds[iface], bufin, sizeof(bufin), 0, (struct sockaddr*)&sa, &sa_len)) == -1) {
+		return(errno == EAGAIN ? 0 : -1);
+	}
+
+	/* print received packet */
+	snprintf(label, sizeof(label), "(in %u)", iface);
+	mdns_trace(MDNS_CAPTURE_REFLECT + iface - 1, MDNS_DUMP_IN, label, (const struct sockaddr*)&sa, NULL, bufin, res);
+
+	/* other links are only reflected */
+	mdns_reflector_process(&reflector, iface, bufin, res, mdns_now());
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int mdns_receive6(void)
+{
+	uint8_t bufin[MDNS_MAX_PACKET];
+	struct sockaddr_in6 sa;
+	struct timespec stamp6 = {0};
+	int res;
+
+	/* receive packet */
+	if((res = mdns_recv(sockfd6, bufin, sizeof(bufin), &sa, sizeof(sa), &drops6, &stamp6)) == -1) {
+		return(errno == EAGAIN ? 0 : -1);
+	}
+
+	/* print received packet */
+	mdns_trace(MDNS_CAPTURE_SOCKET6, MDNS_DUMP_IN, "(in)", (const struct sockaddr*)&sa, stamp6.tv_sec ? &stamp6 : NULL, bufin, res);
+
+	/* counter is sent only after the first drop, so it is kept between packets */
+	mdns_overload_drops(&responder.overload, 1, drops6, mdns_now());
+
+	/* both families are answered by the same records */
+	mdns_responder_snoop(&responder, NULL, bufin, res);
+	mdns_responder_admit(&responder, &sa.sin6_addr, sizeof(sa.sin6_addr), bufin, res);
+	mdns_responder_stamp(&responder, &stamp6);
+
+	reply_family = AF_INET6;
+	mdns_responder_family(&responder, reply_family);
+	mdns_responder_process(&responder, bufin, res);
+	reply_family = AF_UNSPEC;
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+#ifdef MDNS_STATIC
+/** max number of IPv4 addresses of all interfaces */
+#define __MDNS_IFACE_ADDRS 32
+
+static int mdns_interface6(mdns_records_t* host)
+{
+	static char buf[8192];
+	char *line, *end, hex[33];
+	struct in6_addr in6;
+	unsigned index, i, byte;
+	size_t len = 0;
+	ssize_t res;
+	int fd;
+
+	/* one address per line: hex address, index, prefix, scope, flags, name */
+	if((fd = open("/proc/net/if_inet6", O_RDONLY | O_CLOEXEC)) == -1) {
+		return(-1);
+	}
+
+	while(len < sizeof(buf) - 1 && (res = read(fd, buf + len, sizeof(buf) - 1 - len)) > 0) {
+		len += res;
+	}
+
+	close(fd);
+	buf[len] = 0;
+
+	for(line = buf; *line; line = end) {
+		if((end = strchr(line, '\n'))) {
+			*end ++ = 0;
+		} else {
+			end = line + strlen(line);
+		}
+
+		if(sscanf(line, "%32s %x", hex, &index) != 2 || index != ifindex || strlen(hex) != 32) {
+			continue;
+		}
+
+		for(i = 0; i < sizeof(in6.s6_addr) && sscanf(hex + i * 2, "%2x", &byte) == 1; ++ i) {
+			in6.s6_addr[i] = byte;
+		}
+
+		if(i == sizeof(in6.s6_addr) && mdns_responder_host6(host, host_name, &in6)) {
+			return(-1);
+		}
+	}
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int mdns_interface(mdns_records_t* host)
+{
+	struct ifreq reqs[__MDNS_IFACE_ADDRS];
+	struct ifconf ifc;
+	char* alias;
+	int fd, i;
+
+	if((fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0)) == -1) {
+		return(-1);
+	}
+
+	/* getifaddrs() allocates, ioctls fill arrays of caller */
+	ifc.ifc_len = sizeof(reqs);
+	ifc.ifc_req = reqs;
+
+	if(ioctl(fd, SIOCGIFCONF, &ifc) == -1) {
+		close(fd);
+
+		return(-1);
+	}
+
+	/* interface of IPv4 address */
+	for(i = 0; i < ifc.ifc_len / (int)sizeof(reqs[0]); ++ i) {
+		if(ioctl(fd, SIOCGIFADDR, &reqs[i]) == -1 || reqs[i].ifr_addr.sa_family != AF_INET) {
+			continue;
+		}
+
+		if(((struct sockaddr_in*)&reqs[i].ifr_addr)->sin_addr.s_addr == ifaddr.s_addr) {
+			break;
+		}
+	}
+
+	close(fd);
+
+	if(i == ifc.ifc_len / (int)sizeof(reqs[0])) {
+		return(-1);
+	}
+
+	/* label of secondary address is name of interface with suffix */
+	if((alias = strchr(reqs[i].ifr_name, ':'))) {
+		*alias = 0;
+	}
+
+	if(!(ifindex = if_nametoindex(reqs[i].ifr_name))) {
+		return(-1);
+	}
+
+	/* host name resolves to IPv6 addresses of the same interface */
+	return(mdns_interface6(host));
+}
+#else
+static int mdns_interface(mdns_records_t* host)
+{
+	struct ifaddrs *ifa, *cur;
+	const char* name = NULL;
+
+	if(getifaddrs(&ifa) == -1) {
+		return(-1);
+	}
+
+	/* interface of IPv4 address */
+	for(cur = ifa; cur; cur = cur->ifa_next) {
+		if(cur->ifa_addr && cur->ifa_addr->sa_family == AF_INET &&
+		   ((struct sockaddr_in*)cur->ifa_addr)->sin_addr.s_addr == ifaddr.s_addr) {
+			name = cur->ifa_name;
+			break;
+		}
+	}
+
+	if(!name || !(ifindex = if_nametoindex(name))) {
+		freeifaddrs(ifa);
+
+		return(-1);
+	}
+
+	/* host name resolves to IPv6 addresses of the same interface */
+	for(cur = ifa; cur; cur = cur->ifa_next) {
+		if(cur->ifa_addr && cur->ifa_addr->sa_family == AF_INET6 && !strcmp(cur->ifa_name, name)) {
+			if(mdns_responder_host6(host, host_name, &((struct sockaddr_in6*)cur->ifa_addr)->sin6_addr)) {
+				freeifaddrs(ifa);
+
+				return(-1);
+			}
+		}
+	}
+
+	freeifaddrs(ifa);
+
+	return(0);
+}
+#endif
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_config_reload(void)
+{
+	mdns_records_t* t;
+
+	if(!(t = mdns_pool_alloc(MDNS_POOL_RECORDS, sizeof(*t)))) {
+		return;
+	}
+
+	/* build new table aside, responder keeps old table until swap */
+	mdns_records_init(t);
+
+	if(mdns_config_load(t, config, host_name)) {
+		perror(config);
+
+		mdns_records_free(t);
+		mdns_pool_free(t);
+
+		return;
+	}
+
+	mdns_responder_swap(&responder, MDNS_TABLE_CONFIG, t);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_db_reload(void)
+{
+	mdns_records_t* t;
+
+	if(!(t = mdns_pool_alloc(MDNS_POOL_RECORDS, sizeof(*t)))) {
+		return;
+	}
+
+	/* records are served directly from mapping */
+	if(mdns_records_map(t, database)) {
+		perror(database);
+
+		mdns_pool_free(t);
+
+		return;
+	}
+
+	mdns_responder_swap(&responder, MDNS_TABLE_DB, t);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_api_accept(void)
+{
+	int fd, i;
+
+	if((fd = accept4(fds[MDNS_POLL_API].fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) == -1) {
+		return;
+	}
+
+	for(i = MDNS_POLL_CLIENT; i < MDNS_POLL_MAX; ++ i) {
+		if(fds[i].fd == -1) {
+			fds[i].fd = fd;
+
+			return;
+		}
+	}
+
+	/* too many clients */
+	close(fd);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int mdns_range_add(const char* arg)
+{
+	char range[MDNS_MAX_NAME];
+	const char* target;
+	char* pos;
+
+	if(snprintf(range, sizeof(range), "%s", arg) >= sizeof(range)) {
+		return(-1);
+	}
+
+	if((pos = strchr(range, '='))) {
+		*pos = 0;
+		target = pos + 1;
+	} else {
+		target = host_name;
+	}
+
+	return(mdns_reverse_add(&responder.reverse, range, target, 60));
+}
+
+/*------------------------------------------------------------------------*/
+
+static void usage(const char* prog)
+{
+	printf("Usage: %s [-u] [-c config] [-d database] [-s socket] [-r range[=target]]... "
+		"[-R address]... [-t type]... [-p address]... [-w file] [-j] [-f filter]... [-S] address\n", prog);
+}
+
+/*------------------------------------------------------------------------*/
+
+int main(int narg, char** argv)
+{
+	struct sockaddr_in sa;
+	uint8_t bufin[MDNS_MAX_PACKET];
+	mdns_records_t* host;
 	int sockfd;
 	int res;
+	int opt;
+	int i;
+
+	for(i = 0; i < MDNS_POLL_MAX; ++ i) {
+		fds[i].fd = -1;
+		fds[i].events = POLLIN;
+	}
+
+#ifdef MDNS_STATIC
+	setvbuf(stdout, stdout_buf, _IOLBF, sizeof(stdout_buf));
+#endif
+
+	mdns_dump_init(&dump, dump_text, sizeof(dump_text), STDOUT_FILENO);
+
+	while((opt = getopt(narg, argv, "c:d:s:ur:R:t:p:w:jf:S")) != -1) {
+		switch(opt) {
+			case 'c':
+				config = optarg;
+				break;
+
+			case 'd':
+				database = optarg;
+				break;
+
+			case 's':
+				api_socket = optarg;
+				break;
+
+			case 'u':
+				use_uring = 1;
+				break;
+
+			case 'r':
+				if(ranges_count == MDNS_MAX_RANGES) {
+					puts("Too many ranges");
+					return(exit_code);
+				}
+
+				ranges[ranges_count ++] = optarg;
+				break;
+
+			case 'R':
+				if(reflect_count == MDNS_REFLECT_IFACES) {
+					puts("Too many interfaces");
+					return(exit_code);
+				}
+
+				if(!inet_aton(optarg, &reflect_addrs[reflect_count])) {
+					printf("%s: unknown interface %s\n", argv[0], optarg);
+					return(exit_code);
+				}
+
+				reflect_fds[reflect_count ++] = -1;
+				break;
+
+			case 't':
+				if(reflect_types_count == MDNS_REFLECT_TYPES) {
+					puts("Too many types");
+					return(exit_code);
+				}
+
+				reflect_types[reflect_types_count ++] = optarg;
+				break;
+
+			case 'p':
+				if(owners_count == MDNS_PROXY_OWNERS) {
+					puts("Too many hosts");
+					return(exit_code);
+				}
+
+				if(!inet_aton(optarg, &owners[owners_count ++])) {
+					printf("%s: invalid address %s\n", argv[0], optarg);
+					return(exit_code);
+				}
+				break;
+
+			case 'w':
+				capture_path = optarg;
+				break;
+
+			case 'S':
+				mdns_pool_report(stdout);
+				return(0);
+
+			case 'j':
+				use_json = 1;
+				break;
+
+			case 'f':
+				/* in, out, from=address, type=type or name */
+				if(mdns_dump_filter_add(&dump_filter, optarg)) {
+					printf("%s: invalid filter\n", optarg);
+					return(exit_code);
+				}
+				break;
+
+			default:
+				usage(argv[0]);
+				return(exit_code);
+		}
+	}
 
-	if(narg != 2) {
+	if(optind + 1 != narg) {
 		puts("Interface not specificaited");
 		return(1);
 	}
 
 	/* interface address validation */
-	if(!inet_aton(argv[1], &ifaddr)) {
-		printf("%s: unknown interface %s\n", argv[0], argv[1]);
+	if(!inet_aton(argv[optind], &ifaddr)) {
+		printf("%s: unknown interface %s\n", argv[0], argv[optind]);
 
 		return(exit_code);
 	}
@@ -103,13 +731,8 @@ int main(int narg, char** argv)
 		return(1);
 	}
 
-	/* prepare ip address resolution name */
+	/* prepare host name */
 	snprintf(host_name, sizeof(host_name), "%s.%s", hostname, MDNS_DOMAIN);
-	snprintf(addr_name, sizeof(addr_name),
-		"%s.%s",
-		inet_ntoa((struct in_addr){__builtin_bswap32(ifaddr.s_addr)}),
-		MDNS_QUERY_RESOLVE_ADDRESS
-	);
 
 	/* register signal handlers */
 	signal(SIGTERM, on_sigterm);
@@ -117,17 +740,211 @@ int main(int narg, char** argv)
 
 	openlog(argv[0], LOG_PID, LOG_DAEMON);
 
+	/* capture files, interfaces are described before any packet */
+	if(capture_path) {
+		if(mdns_capture_open(&capture, capture_path)) {
+			perror(capture_path);
+			return(exit_code);
+		}
+
+		mdns_capture_iface(&capture, inet_ntoa(ifaddr));
+		mdns_capture_iface(&capture, "IPv6");
+
+		for(i = 1; i < reflect_count; ++ i) {
+			mdns_capture_iface(&capture, inet_ntoa(reflect_addrs[i]));
+		}
+	}
+
 	/* create UDP socket for multicasting */
 	if((sockfd = mdns_socket(ifaddr, 10)) == -1) {
 		perror("socket()");
 		return(exit_code);
 	}
 
+	mdns_batch_init(&batch, sockfd);
+
+	/* old kernels are served by plain socket calls */
+	if(use_uring && mdns_uring_init(&uring, sockfd)) {
+		perror("io_uring");
+		use_uring = 0;
+	}
+
+	mdns_responder_init(&responder, mdns_send_handler_dump, &batch);
+	mdns_responder_timer(&responder, mdns_now());
+	srand(mdns_now() ^ getpid());
+
+	/* records of host name and address */
+	if(!(host = mdns_pool_alloc(MDNS_POOL_RECORDS, sizeof(*host)))) {
+		puts("Out of memory");
+		goto error;
+	}
+
+	mdns_records_init(host);
+
+	if(mdns_responder_host(host, host_name, ifaddr)) {
+		puts("Invalid HOSTNAME");
+		mdns_records_free(host);
+		mdns_pool_free(host);
+		goto error;
+	}
+
+	/* IPv6 is optional, IPv4 socket works alone */
+	if(mdns_interface(host) || (sockfd6 = mdns_socket6(ifindex, 10)) == -1) {
+		perror("IPv6");
+	} else {
+		mdns_batch_init(&batch6, sockfd6);
+		fds[MDNS_POLL_SOCKET6].fd = sockfd6;
+	}
+
+	mdns_responder_swap(&responder, MDNS_TABLE_HOST, host);
+
+	/* designated hosts of sleep proxy */
+	for(i = 0; i < owners_count; ++ i) {
+		mdns_proxy_owner(&responder.proxy, owners[i]);
+	}
+
+	/* reverse names of ranges, host name is default target */
+	for(i = 0; i < ranges_count; ++ i) {
+		if(mdns_range_add(ranges[i])) {
+			printf("%s: invalid range\n", ranges[i]);
+			goto error;
+		}
+	}
+
+	/* reflector of other links */
+	mdns_reflector_init(&reflector, reflect_count, mdns_reflect_handler_dump, NULL);
+
+	for(i = 0; i < reflect_types_count; ++ i) {
+		if(mdns_reflector_type(&reflector, reflect_types[i])) {
+			printf("%s: invalid type\n", reflect_types[i]);
+			goto error;
+		}
+	}
+
+	for(i = 1; i < reflect_count; ++ i) {
+		if((reflect_fds[i] = mdns_socket(reflect_addrs[i], 10)) == -1) {
+			perror(inet_ntoa(reflect_addrs[i]));
+			goto error;
+		}
+
+		mdns_batch_init(&reflect_batches[i], reflect_fds[i]);
+		fds[MDNS_POLL_REFLECT + i - 1].fd = reflect_fds[i];
+	}
+
+	/* services */
+	if(config) {
+		if((fds[MDNS_POLL_CONFIG].fd = mdns_config_watch(config)) == -1) {
+			perror(config);
+		}
+
+		mdns_config_reload();
+	}
+
+	/* precompiled records */
+	if(database) {
+		if((fds[MDNS_POLL_DB].fd = mdns_config_watch(database)) == -1) {
+			perror(database);
+		}
+
+		mdns_db_reload();
+	}
+
+	/* local registrations */
+	if(api_socket) {
+		if((fds[MDNS_POLL_API].fd = mdns_registry_listen(api_socket)) == -1) {
+			perror(api_socket);
+		}
+	}
+
+	/* completions of receiving ring are polled instead of socket */
+	fds[MDNS_POLL_SOCKET].fd = use_uring ? uring.rx.fd : sockfd;
+
 	do {
-		sa_len = sizeof(sa);
+		mdns_flush();
+
+		if((res = mdns_responder_timeout(&responder)) == -1) {
+			res = 10000;
+		}
+
+		if(poll(fds, MDNS_POLL_MAX, res) == -1) {
+			if(errno == EINTR)
+				continue;
+
+			perror("poll()");
+			goto error;
+		}
+
+		/* probing and announcing */
+		mdns_responder_timer(&responder, mdns_now());
+
+		/* config file was changed */
+		if(fds[MDNS_POLL_CONFIG].revents & POLLIN) {
+			if(mdns_config_changed(fds[MDNS_POLL_CONFIG].fd, config)) {
+				mdns_config_reload();
+			}
+		}
+
+		/* database was recompiled */
+		if(fds[MDNS_POLL_DB].revents & POLLIN) {
+			if(mdns_config_changed(fds[MDNS_POLL_DB].fd, database)) {
+				mdns_db_reload();
+			}
+		}
+
+		/* new client */
+		if(fds[MDNS_POLL_API].revents & POLLIN) {
+			mdns_api_accept();
+		}
+
+		/* batches of registrations */
+		for(i = MDNS_POLL_CLIENT; i < MDNS_POLL_MAX; ++ i) {
+			if(fds[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+				/* registrations of disconnected client are withdrawn */
+				if(mdns_registry_handle(&registry, &responder, i - MDNS_POLL_CLIENT, fds[i].fd)) {
+					mdns_registry_drop(&registry, &responder, i - MDNS_POLL_CLIENT);
+					close(fds[i].fd);
+					fds[i].fd = -1;
+				}
+			}
+		}
+
+		if(fds[MDNS_POLL_SOCKET6].revents & POLLIN) {
+			if(mdns_receive6()) {
+				perror("recvfrom()");
+				goto error;
+			}
+		}
+
+		for(i = 1; i < reflect_count; ++ i) {
+			if(fds[MDNS_POLL_REFLECT + i - 1].revents & POLLIN) {
+				if(mdns_reflect_receive(i)) {
+					perror("recvfrom()");
+					goto error;
+				}
+			}
+		}
+
+		if(!(fds[MDNS_POLL_SOCKET].revents & POLLIN)) {
+			continue;
+		}
+
+		if(use_uring) {
+			/* receive can still fail after init, plain socket calls take over */
+			if(mdns_uring_recv(&uring, mdns_receive_handler_dump, mdns_receive_done, NULL) == -1) {
+				perror("io_uring");
+
+				mdns_uring_flush(&uring);
+				mdns_uring_free(&uring);
+				use_uring = 0;
+
+				fds[MDNS_POLL_SOCKET].fd = sockfd;
+			}
+
+			continue;
+		}
 
 		/* receive packet */
-		if((res = recvfrom(sockfd, bufin, sizeof(bufin), 0, (struct sockaddr*)&sa, &sa_len)) == -1) {
+		if((res = mdns_recv(sockfd, bufin, sizeof(bufin), &sa, sizeof(sa), &drops, &stamp)) == -1) {
 			if(errno == EAGAIN)
 				continue;
 
@@ -136,29 +953,64 @@ int main(int narg, char** argv)
 		}
 
 		/* process incoming packet */
-		printf("(in) from %s:%d, length: %d\n",
-			inet_ntoa(sa.sin_addr), ntohs(sa.sin_port), res);
-		mdns_packet_dump(bufin, res); fflush(stdout);
+		mdns_receive_handler_dump(NULL, bufin, res, &sa);
+	} while(!terminate);
+
+	exit_code = 0;
+
+error:
+	/* goodbye burst */
+	mdns_responder_goodbye(&responder);
+	mdns_flush();
 
-		mdns_packet_init(&bufout, sizeof(bufout));
-		mdns_packet_process(bufin, res, &handlers, &ctx);
+	if(use_uring) {
+		mdns_uring_free(&uring);
+	}
 
-		/* if we have answers, send it */
-		if(mdns_packet_is_valid(bufout, sizeof(bufout))) {
-			res = mdns_send(sockfd, bufout, mdns_packet_size(bufout, sizeof(bufout)));
+	mdns_responder_free(&responder);
+	mdns_registry_free(&registry);
 
-			/* print sended packet */
-			printf("(out) to %s:%d, length: %d\n",
-				inet_ntoa(sa.sin_addr), ntohs(sa.sin_port), res);
-			mdns_packet_dump(bufout, res); fflush(stdout);
+	for(i = MDNS_POLL_CONFIG; i < MDNS_POLL_MAX; ++ i) {
+		if(fds[i].fd != -1) {
+			close(fds[i].fd);
 		}
-	} while(!terminate);
+	}
 
-	exit_code = 0;
+	if(api_socket) {
+		unlink(api_socket);
+	}
 
-error:
 	mdns_close(ifaddr, sockfd);
 
+	for(i = 1; i < reflect_count; ++ i) {
+		if(reflect_fds[i] != -1) {
+			mdns_close(reflect_addrs[i], reflect_fds[i]);
+		}
+	}
+
+	printf("overload: drops %lu, limited %lu, shed browse %lu, shed repeats %lu\n",
+		responder.overload.stats.drops, responder.overload.stats.limited,
+		responder.overload.stats.shed_browse, responder.overload.stats.shed_repeats);
+
+	mdns_latency_print(&responder.latency, stdout);
+	mdns_pool_report(stdout);
+
+	if(capture_path) {
+		mdns_capture_close(&capture);
+
+		printf("capture: packets %lu, files %lu\n", capture.packets, capture.files);
+	}
+
+	if(reflect_count > 1) {
+		printf("reflector: in %lu, out %lu, forwarded %lu, duplicates %lu, filtered %lu\n",
+			reflector.stats.in, reflector.stats.out, reflector.stats.forwarded,
+			reflector.stats.duplicates, reflector.stats.filtered);
+	}
+
+	if(sockfd6 != -1) {
+		mdns_close6(ifindex, sockfd6);
+	}
+
 	closelog();
 
 	return(exit_code);
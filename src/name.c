@@ -0,0 +1,295 @@
+/**
+ * @file name.c
+ *
+ * yamdns -- yet another very simple mdns.
+ * Copyright (C) 2013  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include <yamdns/yamdns.h>
+
+#include "name.h"
+
+/*------------------------------------------------------------------------*/
+
+/*
+ * Kernels are chosen at compile time: AVX2 with -mavx2 or -march,
+ * SSE2 on every x86-64, NEON on AArch64, and plain C elsewhere.
+ * Masks of kernels have one bit per byte, NEON has the top bit of nibble.
+ */
+#if defined(__AVX2__)
+#include <immintrin.h>
+
+/** bytes of one step */
+#define __MDNS_SIMD 32
+
+/** shift of index of byte in mask */
+#define __MDNS_SIMD_SHIFT 0
+
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+
+#define __MDNS_SIMD 16
+#define __MDNS_SIMD_SHIFT 0
+
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+
+#define __MDNS_SIMD 16
+#define __MDNS_SIMD_SHIFT 2
+#endif
+
+/** lower case of ASCII letter */
+#define __MDNS_FOLD(c) ((c) >= 'A' && (c) <= 'Z' ? (c) | 0x20 : (c))
+
+/*------------------------------------------------------------------------*/
+
+#if defined(__AVX2__)
+
+static inline __m256i mdns_simd_fold(__m256i v)
+{
+	__m256i upper = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('A' - 1)),
+		_mm256_cmpgt_epi8(_mm256_set1_epi8('Z' + 1), v));
+
+	return(_mm256_or_si256(v, _mm256_and_si256(upper, _mm256_set1_epi8(0x20))));
+}
+
+static inline int mdns_simd_caseeq(const uint8_t* a, const uint8_t* b)
+{
+	__m256i eq = _mm256_cmpeq_epi8(mdns_simd_fold(_mm256_loadu_si256((const __m256i*)a)),
+		mdns_simd_fold(_mm256_loadu_si256((const __m256i*)b)));
+
+	return((uint32_t)_mm256_movemask_epi8(eq) == 0xffffffff);
+}
+
+static inline uint64_t mdns_simd_dots(const char* p)
+{
+	return((uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)p), _mm256_set1_epi8('.'))));
+}
+
+#elif defined(__SSE2__)
+
+static inline __m128i mdns_simd_fold(__m128i v)
+{
+	/* bytes above 0x7f are negative, so they are not letters */
+	__m128i upper = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('A' - 1)),
+		_mm_cmplt_epi8(v, _mm_set1_epi8('Z' + 1)));
+
+	return(_mm_or_si128(v, _mm_and_si128(upper, _mm_set1_epi8(0x20))));
+}
+
+static inline int mdns_simd_caseeq(const uint8_t* a, const uint8_t* b)
+{
+	__m128i eq = _mm_cmpeq_epi8(mdns_simd_fold(_mm_loadu_si128((const __m128i*)a)),
+		mdns_simd_fold(_mm_loadu_si128((const __m128i*)b)));
+
+	return(_mm_movemask_epi8(eq) == 0xffff);
+}
+
+static inline uint64_t mdns_simd_dots(const char* p)
+{
+	return(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)p), _mm_set1_epi8('.'))));
+}
+
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+
+static inline uint8x16_t mdns_simd_fold(uint8x16_t v)
+{
+	uint8x16_t upper = vandq_u8(vcgeq_u8(v, vdupq_n_u8('A')), vcleq_u8(v, vdupq_n_u8('Z')));
+
+	return(vorrq_u8(v, vandq_u8(upper, vdupq_n_u8(0x20))));
+}
+
+static inline int mdns_simd_caseeq(const uint8_t* a, const uint8_t* b)
+{
+	return(vminvq_u8(vceqq_u8(mdns_simd_fold(vld1q_u8(a)), mdns_simd_fold(vld1q_u8(b)))) == 0xff);
+}
+
+static inline uint64_t mdns_simd_dots(const char* p)
+{
+	uint8x16_t eq = vceqq_u8(vld1q_u8((const uint8_t*)p), vdupq_n_u8('.'));
+
+	/* NEON has no movemask, narrowing shift gives nibble per byte */
+	return(vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0) & 0x8888888888888888ULL);
+}
+
+#endif
+
+/*------------------------------------------------------------------------*/
+
+int mdns_name_caseeq(const void* a, const void* b, size_t len)
+{
+	const uint8_t* pa = a;
+	const uint8_t* pb = b;
+	size_t i = 0;
+
+#ifdef __MDNS_SIMD
+	if(len >= __MDNS_SIMD) {
+		for(; i + __MDNS_SIMD <= len; i += __MDNS_SIMD) {
+			if(!mdns_simd_caseeq(pa + i, pb + i)) {
+				return(0);
+			}
+		}
+
+		/* tail overlaps the last step */
+		return(i == len || mdns_simd_caseeq(pa + len - __MDNS_SIMD, pb + len - __MDNS_SIMD));
+	}
+#endif
+
+	for(; i < len; ++ i) {
+		if(__MDNS_FOLD(pa[i]) != __MDNS_FOLD(pb[i])) {
+			return(0);
+		}
+	}
+
+	return(1);
+}
+
+/*------------------------------------------------------------------------*/
+
+int mdns_name_casecmp(const char* a, const char* b)
+{
+	size_t len = strlen(a);
+
+	return(len != strlen(b) || !mdns_name_caseeq(a, b, len));
+}
+
+/*------------------------------------------------------------------------*/
+
+static int mdns_name_label(uint8_t* wire, size_t dot, size_t* start, uint8_t* labels, unsigned* count)
+{
+	size_t len = dot - *start;
+
+	/* empty labels are allowed only at the end */
+	if(!len || len > 0x3f) {
+		return(-1);
+	}
+
+	wire[*start] = len;
+
+	if(labels) {
+		labels[*count] = *start;
+	}
+
+	++ *count;
+	*start = dot + 1;
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+static size_t mdns_name_labels(uint8_t* wire, size_t size, const char* dotted, uint8_t* labels, unsigned* count)
+{
+	size_t n, i = 0, start = 0;
+#ifdef __MDNS_SIMD
+	uint64_t mask;
+#endif
+
+	n = strlen(dotted);
+	*count = 0;
+
+	/* last dot is the root label */
+	if(n && dotted[n - 1] == '.') {
+		-- n;
+	}
+
+	if(!n) {
+		if(!size) {
+			return(0);
+		}
+
+		wire[0] = 0;
+
+		return(1);
+	}
+
+	/* labels are copied at once, dots become lengths */
+	if(n + 2 > size || n + 2 > MDNS_MAX_NAME) {
+		return(0);
+	}
+
+	memcpy(wire + 1, dotted, n);
+	wire[n + 1] = 0;
+
+#ifdef __MDNS_SIMD
+	for(; i + __MDNS_SIMD <= n; i += __MDNS_SIMD) {
+		for(mask = mdns_simd_dots(dotted + i); mask; mask &= mask - 1) {
+			if(mdns_name_label(wire, i + (__builtin_ctzll(mask) >> __MDNS_SIMD_SHIFT), &start, labels, count)) {
+				return(0);
+			}
+		}
+	}
+#endif
+
+	for(; i < n; ++ i) {
+		if(dotted[i] == '.' && mdns_name_label(wire, i, &start, labels, count)) {
+			return(0);
+		}
+	}
+
+	if(mdns_name_label(wire, n, &start, labels, count)) {
+		return(0);
+	}
+
+	return(n + 2);
+}
+
+/*------------------------------------------------------------------------*/
+
+size_t mdns_name_wire(void* buf, size_t size, const char* dotted)
+{
+	unsigned count;
+
+	return(mdns_name_labels(buf, size, dotted, NULL, &count));
+}
+
+/*------------------------------------------------------------------------*/
+
+int mdns_name_parse(mdns_name_t* n, const char* dotted)
+{
+	unsigned count;
+
+	if(!(n->len = mdns_name_labels(n->wire, sizeof(n->wire), dotted, n->labels, &count))) {
+		return(-1);
+	}
+
+	n->count = count;
+	n->hash = mdns_name_hash(dotted);
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+int mdns_name_suffix(const mdns_name_t* n, const mdns_name_t* suffix)
+{
+	size_t off;
+
+	if(suffix->len > n->len || suffix->count > n->count) {
+		return(0);
+	}
+
+	off = n->len - suffix->len;
+
+	/* suffix must start at label of name */
+	if(suffix->count && n->labels[n->count - suffix->count] != off) {
+		return(0);
+	}
+
+	return(mdns_name_caseeq(n->wire + off, suffix->wire, suffix->len));
+}
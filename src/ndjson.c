@@ -0,0 +1,476 @@
+/* yamdns -- yet another very simple mdns.
+ * Copyright (C) 2013  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <arpa/inet.h>
+
+#include <yamdns/yamdns.h>
+
+#include "json.h"
+
+/*------------------------------------------------------------------------*/
+
+/** size of output buffer */
+#define __NDJSON_BUF (1 << 20)
+
+/** output is written when free space is less */
+#define __NDJSON_RESERVE (256 << 10)
+
+/** max number of interfaces of pcapng section */
+#define __NDJSON_IFACES 64
+
+/** link types */
+#define __LINKTYPE_NULL 0
+#define __LINKTYPE_ETHERNET 1
+#define __LINKTYPE_RAW 101
+#define __LINKTYPE_LINUX_SLL 113
+#define __LINKTYPE_IPV4 228
+#define __LINKTYPE_IPV6 229
+#define __LINKTYPE_LINUX_SLL2 276
+
+/*------------------------------------------------------------------------*/
+
+/** interface of capture */
+typedef struct ndjson_iface {
+	/** link type */
+	unsigned linktype;
+
+	/** if_tsresol of pcapng */
+	uint8_t tsresol;
+} ndjson_iface_t;
+
+/** state of capture file */
+typedef struct ndjson_file {
+	/** contents */
+	const uint8_t* data;
+
+	/** length of contents */
+	size_t len;
+
+	/** byte order is opposite to host */
+	int swap;
+
+	/** interfaces of current section */
+	ndjson_iface_t ifaces[__NDJSON_IFACES];
+
+	/** number of interfaces */
+	unsigned count;
+} ndjson_file_t;
+
+/*------------------------------------------------------------------------*/
+
+static char text[__NDJSON_BUF];
+static mdns_dump_t out;
+static mdns_dump_filter_t filter;
+
+/*------------------------------------------------------------------------*/
+
+static uint16_t ndjson_u16(const ndjson_file_t* f, const uint8_t* pos)
+{
+	uint16_t v;
+
+	memcpy(&v, pos, sizeof(v));
+
+	return(f->swap ? __builtin_bswap16(v) : v);
+}
+
+/*------------------------------------------------------------------------*/
+
+static uint32_t ndjson_u32(const ndjson_file_t* f, const uint8_t* pos)
+{
+	uint32_t v;
+
+	memcpy(&v, pos, sizeof(v));
+
+	return(f->swap ? __builtin_bswap32(v) : v);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void ndjson_write(void)
+{
+	size_t pos = 0;
+	ssize_t res;
+
+	while(pos < out.len && (res = write(STDOUT_FILENO, out.buf + pos, out.len - pos)) > 0) {
+		pos += res;
+	}
+
+	out.len = 0;
+}
+
+/*------------------------------------------------------------------------*/
+
+static void ndjson_ip(const uint8_t* pos, size_t len, mdns_json_source_t* src)
+{
+	struct sockaddr_storage from;
+	struct sockaddr_in6* sin6 = (struct sockaddr_in6*)&from;
+	struct sockaddr_in* sin = (struct sockaddr_in*)&from;
+	size_t ip_len, udp_len;
+
+	memset(&from, 0, sizeof(from));
+
+	if(len >= 20 && (pos[0] >> 4) == 4) {
+		ip_len = (pos[0] & 0x0f) * 4;
+
+		/* only the first fragment has UDP header, the rest is lost */
+		if(pos[9] != IPPROTO_UDP || ip_len < 20 || (ntohs(*(const uint16_t*)(pos + 6)) & 0x3fff)) {
+			return;
+		}
+
+		sin->sin_family = AF_INET;
+		memcpy(&sin->sin_addr, pos + 12, 4);
+	} else if(len >= 40 && (pos[0] >> 4) == 6) {
+		ip_len = 40;
+
+		/* extension headers are not expected in mDNS */
+		if(pos[6] != IPPROTO_UDP) {
+			return;
+		}
+
+		sin6->sin6_family = AF_INET6;
+		memcpy(&sin6->sin6_addr, pos + 8, 16);
+	} else {
+		return;
+	}
+
+	if(len < ip_len + 8) {
+		return;
+	}
+
+	pos += ip_len;
+	len -= ip_len;
+
+	/* mDNS port on either side */
+	if(ntohs(*(const uint16_t*)pos) != __MDNS_PORT && ntohs(*(const uint16_t*)(pos + 2)) != __MDNS_PORT) {
+		return;
+	}
+
+	udp_len = ntohs(*(const uint16_t*)(pos + 4));
+
+	if(udp_len < 8 || udp_len > len) {
+		return;
+	}
+
+	if(sin->sin_family == AF_INET) {
+		sin->sin_port = *(const uint16_t*)pos;
+	} else {
+		sin6->sin6_port = *(const uint16_t*)pos;
+	}
+
+	src->from = (const struct sockaddr*)&from;
+
+	if(out.size - out.len < __NDJSON_RESERVE) {
+		ndjson_write();
+	}
+
+	mdns_json_packet(&out, &filter, src, pos + 8, udp_len - 8);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void ndjson_frame(const uint8_t* pos, size_t len, unsigned linktype, mdns_json_source_t* src)
+{
+	uint16_t proto;
+	size_t off;
+
+	switch(linktype) {
+		case __LINKTYPE_RAW:
+		case __LINKTYPE_IPV4:
+		case __LINKTYPE_IPV6:
+			ndjson_ip(pos, len, src);
+			return;
+
+		case __LINKTYPE_NULL:
+			off = 4;
+			break;
+
+		case __LINKTYPE_ETHERNET:
+			/* VLAN tags are skipped */
+			for(off = 12; off + 2 <= len && ((proto = ntohs(*(const uint16_t*)(pos + off))) == 0x8100 || proto == 0x88a8); off += 4);
+
+			off += 2;
+			break;
+
+		case __LINKTYPE_LINUX_SLL:
+			off = 16;
+			break;
+
+		case __LINKTYPE_LINUX_SLL2:
+			off = 20;
+			break;
+
+		default:
+			return;
+	}
+
+	/* version of IP is checked instead of protocol of link */
+	if(off < len) {
+		ndjson_ip(pos + off, len - off, src);
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+static void ndjson_time(mdns_json_source_t* src, uint64_t ts, uint8_t tsresol)
+{
+	uint64_t units = 1;
+	unsigned i;
+
+	/* power of two or power of ten */
+	if(tsresol & 0x80) {
+		units = 1ULL << (tsresol & 0x3f);
+	} else {
+		for(i = 0; i < tsresol && i < 19; ++ i) {
+			units *= 10;
+		}
+	}
+
+	src->ts.tv_sec = ts / units;
+	src->ts.tv_nsec = (long double)(ts % units) * 1000000000 / units;
+}
+
+/*------------------------------------------------------------------------*/
+
+static int ndjson_pcap(ndjson_file_t* f)
+{
+	mdns_json_source_t src;
+	const uint8_t* pos;
+	unsigned linktype;
+	uint32_t magic, cap_len;
+	uint8_t tsresol;
+
+	memcpy(&magic, f->data, sizeof(magic));
+
+	f->swap = magic == 0xd4c3b2a1 || magic == 0x4d3cb2a1;
+	tsresol = (magic == 0xa1b23c4d || magic == 0x4d3cb2a1) ? 9 : 6;
+	linktype = ndjson_u32(f, f->data + 20) & 0xffff;
+
+	memset(&src, 0, sizeof(src));
+
+	for(pos = f->data + 24; pos + 16 <= f->data + f->len; pos += 16 + cap_len) {
+		cap_len = ndjson_u32(f, pos + 8);
+
+		if(cap_len > f->data + f->len - pos - 16) {
+			return(-1);
+		}
+
+		src.ts.tv_sec = ndjson_u32(f, pos);
+		src.ts.tv_nsec = ndjson_u32(f, pos + 4) * (tsresol == 6 ? 1000 : 1);
+
+		ndjson_frame(pos + 16, cap_len, linktype, &src);
+	}
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void ndjson_idb(ndjson_file_t* f, const uint8_t* pos, const uint8_t* end)
+{
+	ndjson_iface_t* iface;
+	uint16_t code, len;
+
+	if(f->count == __NDJSON_IFACES) {
+		return;
+	}
+
+	iface = &f->ifaces[f->count ++];
+	iface->linktype = ndjson_u16(f, pos + 8);
+	iface->tsresol = 6;
+
+	/* options follow linktype, reserved and snaplen */
+	for(pos += 16; pos + 4 <= end; pos += 4 + ((len + 3) & ~3U)) {
+		code = ndjson_u16(f, pos);
+		len = ndjson_u16(f, pos + 2);
+
+		if(!code) {
+			break;
+		}
+
+		if(code == 9 && len == 1 && pos + 5 <= end) {
+			iface->tsresol = pos[4];
+		}
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+static int ndjson_pcapng(ndjson_file_t* f)
+{
+	mdns_json_source_t src;
+	const uint8_t *pos, *opt, *end;
+	uint32_t type, len, cap_len, magic;
+	uint16_t code, opt_len;
+
+	for(pos = f->data; pos + 12 <= f->data + f->len; pos += len) {
+		type = ndjson_u32(f, pos);
+
+		/* section header defines byte order of following blocks */
+		if(type == 0x0a0d0d0a) {
+			memcpy(&magic, pos + 8, sizeof(magic));
+			f->swap = magic == 0x4d3c2b1a;
+			f->count = 0;
+		}
+
+		len = ndjson_u32(f, pos + 4);
+
+		if(len < 12 || len % 4 || len > f->data + f->len - pos) {
+			return(-1);
+		}
+
+		end = pos + len - 4;
+
+		if(type == 1 && len >= 20) {
+			ndjson_idb(f, pos, end);
+			continue;
+		}
+
+		/* enhanced packet block */
+		if(type != 6 || len < 32) {
+			continue;
+		}
+
+		memset(&src, 0, sizeof(src));
+		src.iface = ndjson_u32(f, pos + 8);
+		cap_len = ndjson_u32(f, pos + 20);
+
+		if(src.iface >= f->count || cap_len > (size_t)(end - pos - 28)) {
+			continue;
+		}
+
+		ndjson_time(&src, (uint64_t)ndjson_u32(f, pos + 12) << 32 | ndjson_u32(f, pos + 16), f->ifaces[src.iface].tsresol);
+
+		/* direction of epb_flags */
+		for(opt = pos + 28 + ((cap_len + 3) & ~3U); opt + 4 <= end; opt += 4 + ((opt_len + 3) & ~3U)) {
+			code = ndjson_u16(f, opt);
+			opt_len = ndjson_u16(f, opt + 2);
+
+			if(!code) {
+				break;
+			}
+
+			if(code == 2 && opt_len == 4 && opt + 8 <= end) {
+				src.dir = ndjson_u32(f, opt + 4) & 0x03;
+			}
+		}
+
+		ndjson_frame(pos + 28, cap_len, f->ifaces[src.iface].linktype, &src);
+	}
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int ndjson_file(const char* path)
+{
+	ndjson_file_t f;
+	struct stat st;
+	uint32_t magic;
+	void* map;
+	int fd, res = -1;
+
+	if((fd = open(path, O_RDONLY)) == -1) {
+		return(-1);
+	}
+
+	if(fstat(fd, &st) == -1 || st.st_size < 24) {
+		close(fd);
+		return(-1);
+	}
+
+	/* file is read by page cache without copying */
+	if((map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED) {
+		close(fd);
+		return(-1);
+	}
+
+	madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+	memset(&f, 0, sizeof(f));
+	f.data = map;
+	f.len = st.st_size;
+
+	memcpy(&magic, f.data, sizeof(magic));
+
+	if(magic == 0x0a0d0d0a) {
+		res = ndjson_pcapng(&f);
+	} else if(magic == 0xa1b2c3d4 || magic == 0xd4c3b2a1 || magic == 0xa1b23c4d || magic == 0x4d3cb2a1) {
+		res = ndjson_pcap(&f);
+	}
+
+	munmap(map, st.st_size);
+	close(fd);
+
+	return(res);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void usage(const char* prog)
+{
+	printf("Usage: %s [-f filter]... file...\n", prog);
+}
+
+/*------------------------------------------------------------------------*/
+
+int main(int narg, char** argv)
+{
+	int exit_code = 0;
+	int opt;
+
+	while((opt = getopt(narg, argv, "f:")) != -1) {
+		switch(opt) {
+			case 'f':
+				if(mdns_dump_filter_add(&filter, optarg)) {
+					printf("%s: invalid filter\n", optarg);
+					return(1);
+				}
+				break;
+
+			default:
+				usage(argv[0]);
+				return(1);
+		}
+	}
+
+	if(optind == narg) {
+		usage(argv[0]);
+		return(1);
+	}
+
+	/* output is written by large blocks */
+	mdns_dump_init(&out, text, sizeof(text), -1);
+
+	for(; optind < narg; ++ optind) {
+		if(ndjson_file(argv[optind])) {
+			perror(argv[optind]);
+			exit_code = 1;
+		}
+	}
+
+	ndjson_write();
+
+	return(exit_code);
+}
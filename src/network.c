@@ -18,6 +18,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <stdio.h>
 #include <string.h>
 #include <unistd.h>
 #include <arpa/inet.h>
@@ -25,6 +26,8 @@
 
 #include <yamdns/type.h>
 
+#include "network.h"
+
 /*------------------------------------------------------------------------*/
 
 int mdns_socket(struct in_addr ifaddr, int timeout)
@@ -54,6 +57,21 @@ int mdns_socket(struct in_addr ifaddr, int timeout)
 		goto error;
 	}
 
+	/* counter of dropped datagrams comes with each packet */
+	if(setsockopt(sockfd, SOL_SOCKET, SO_RXQ_OVFL, &(int){1}, sizeof(int)) == -1) {
+		goto error;
+	}
+
+	/* kernel receive time comes with each packet */
+	if(setsockopt(sockfd, SOL_SOCKET, SO_TIMESTAMPNS, &(int){1}, sizeof(int)) == -1) {
+		goto error;
+	}
+
+	/* only groups joined by this socket, so interface of packet is known */
+	if(setsockopt(sockfd, IPPROTO_IP, IP_MULTICAST_ALL, &(int){0}, sizeof(int)) == -1) {
+		goto error;
+	}
+
 	/* send multicasting from interface */
 	if(setsockopt(sockfd, IPPROTO_IP, IP_MULTICAST_IF, (char*)&ifaddr, sizeof(ifaddr)) == -1) {
 		goto error;
@@ -84,6 +102,95 @@ error:
 
 /*------------------------------------------------------------------------*/
 
+int mdns_socket6(unsigned ifindex, int timeout)
+{
+	struct sockaddr_in6 saaddr;
+	struct ipv6_mreq mreq;
+	int sockfd;
+
+	/* create UDP socket for multicasting */
+	if((sockfd = socket(AF_INET6, SOCK_DGRAM, 0)) == -1) {
+		return(-1);
+	}
+
+	/* port is shared with IPv4 socket */
+	if(setsockopt(sockfd, IPPROTO_IPV6, IPV6_V6ONLY, &(int){1}, sizeof(int)) == -1) {
+		goto error;
+	}
+
+	if(setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &(int){1}, sizeof(int)) == -1) {
+		goto error;
+	}
+
+	memset(&saaddr, 0, sizeof(saaddr));
+	saaddr.sin6_family = AF_INET6;
+	saaddr.sin6_port = htons(__MDNS_PORT);
+
+	if(bind(sockfd, (struct sockaddr*)&saaddr, sizeof(saaddr)) == -1) {
+		goto error;
+	}
+
+	if(setsockopt(sockfd, IPPROTO_IPV6, IPV6_MULTICAST_LOOP, &(int){0}, sizeof(int)) == -1) {
+		goto error;
+	}
+
+	/* send multicasting from interface */
+	if(setsockopt(sockfd, IPPROTO_IPV6, IPV6_MULTICAST_IF, &ifindex, sizeof(ifindex)) == -1) {
+		goto error;
+	}
+
+	if(setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &(struct timeval) {timeout, 0}, sizeof(struct timeval)) == -1) {
+		goto error;
+	}
+
+	/* counter of dropped datagrams comes with each packet */
+	if(setsockopt(sockfd, SOL_SOCKET, SO_RXQ_OVFL, &(int){1}, sizeof(int)) == -1) {
+		goto error;
+	}
+
+	/* kernel receive time comes with each packet */
+	if(setsockopt(sockfd, SOL_SOCKET, SO_TIMESTAMPNS, &(int){1}, sizeof(int)) == -1) {
+		goto error;
+	}
+
+	if(setsockopt(sockfd, IPPROTO_IPV6, IPV6_MULTICAST_HOPS, &(int){__MDNS_TTL}, sizeof(int)) == -1) {
+		goto error;
+	}
+
+	mreq.ipv6mr_interface = ifindex;
+	mreq.ipv6mr_multiaddr = __MDNS_MC_GROUP6;
+
+	if(setsockopt(sockfd, IPPROTO_IPV6, IPV6_JOIN_GROUP, &mreq, sizeof(mreq)) == -1) {
+		goto error;
+	}
+
+	return(sockfd);
+
+error:
+	close(sockfd);
+
+	return(-1);
+}
+
+/*------------------------------------------------------------------------*/
+
+int mdns_close6(unsigned ifindex, int sockfd)
+{
+	struct ipv6_mreq mreq;
+
+	mreq.ipv6mr_interface = ifindex;
+	mreq.ipv6mr_multiaddr = __MDNS_MC_GROUP6;
+
+	/* socket is closed anyway, group is left with it */
+	if(setsockopt(sockfd, IPPROTO_IPV6, IPV6_LEAVE_GROUP, &mreq, sizeof(mreq)) == -1) {
+		perror("IPV6_LEAVE_GROUP");
+	}
+
+	return(close(sockfd));
+}
+
+/*------------------------------------------------------------------------*/
+
 int mdns_close(struct in_addr ifaddr, int sockfd)
 {
 	struct ip_mreq mreq;
@@ -92,7 +199,7 @@ int mdns_close(struct in_addr ifaddr, int sockfd)
 	mreq.imr_multiaddr = __MDNS_MC_GROUP;
 
 	if(setsockopt(sockfd, IPPROTO_IP, IP_DROP_MEMBERSHIP, (char*)&mreq, sizeof(mreq)) == -1) {
-		/* TODO print warning? */;
+		perror("IP_DROP_MEMBERSHIP");
 	}
 
 	return(close(sockfd));
@@ -100,6 +207,42 @@ int mdns_close(struct in_addr ifaddr, int sockfd)
 
 /*------------------------------------------------------------------------*/
 
+int mdns_recv(int sockfd, void* buf, size_t len, void* from, socklen_t from_len, uint32_t* drops, struct timespec* stamp)
+{
+	uint8_t control[CMSG_SPACE(sizeof(uint32_t)) + CMSG_SPACE(sizeof(struct timespec))];
+	struct cmsghdr* cmsg;
+	struct msghdr msg;
+	struct iovec iov;
+	int res;
+
+	iov.iov_base = buf;
+	iov.iov_len = len;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_name = from;
+	msg.msg_namelen = from_len;
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+
+	if((res = recvmsg(sockfd, &msg, 0)) == -1) {
+		return(-1);
+	}
+
+	for(cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+		if(cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL) {
+			memcpy(drops, CMSG_DATA(cmsg), sizeof(*drops));
+		} else if(cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_TIMESTAMPNS) {
+			memcpy(stamp, CMSG_DATA(cmsg), sizeof(*stamp));
+		}
+	}
+
+	return(res);
+}
+
+/*------------------------------------------------------------------------*/
+
 int mdns_send(int sockfd, void* buf, size_t len)
 {
 	struct sockaddr_in sa;
@@ -111,3 +254,78 @@ int mdns_send(int sockfd, void* buf, size_t len)
 
 	return(sendto(sockfd, buf, len, 0, (struct sockaddr*)&sa, sizeof(sa)));
 }
+
+/*------------------------------------------------------------------------*/
+
+void mdns_batch_init(mdns_batch_t* b, int sockfd)
+{
+	socklen_t len = sizeof(int);
+	int family;
+
+	b->sockfd = sockfd;
+	b->count = 0;
+
+	memset(&b->to, 0, sizeof(b->to));
+
+	if(getsockopt(sockfd, SOL_SOCKET, SO_DOMAIN, &family, &len) == 0 && family == AF_INET6) {
+		b->to.sin6.sin6_family = AF_INET6;
+		b->to.sin6.sin6_port = htons(__MDNS_PORT);
+		b->to.sin6.sin6_addr = __MDNS_MC_GROUP6;
+		b->to_len = sizeof(b->to.sin6);
+	} else {
+		b->to.sin.sin_family = AF_INET;
+		b->to.sin.sin_port = htons(__MDNS_PORT);
+		b->to.sin.sin_addr = __MDNS_MC_GROUP;
+		b->to_len = sizeof(b->to.sin);
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+int mdns_batch_add(mdns_batch_t* b, const void* buf, size_t len)
+{
+	if(len > sizeof(b->bufs[0])) {
+		return(-1);
+	}
+
+	if(b->count == MDNS_BATCH_MAX && mdns_batch_flush(b) == -1) {
+		return(-1);
+	}
+
+	memcpy(b->bufs[b->count], buf, len);
+	b->iov[b->count].iov_base = b->bufs[b->count];
+	b->iov[b->count].iov_len = len;
+	++ b->count;
+
+	return(len);
+}
+
+/*------------------------------------------------------------------------*/
+
+int mdns_batch_flush(mdns_batch_t* b)
+{
+	unsigned i, sent;
+	int res;
+
+	memset(b->msgs, 0, b->count * sizeof(b->msgs[0]));
+
+	for(i = 0; i < b->count; ++ i) {
+		b->msgs[i].msg_hdr.msg_name = &b->to;
+		b->msgs[i].msg_hdr.msg_namelen = b->to_len;
+		b->msgs[i].msg_hdr.msg_iov = &b->iov[i];
+		b->msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	/* kernel may send only part of batch */
+	for(sent = 0; sent < b->count; sent += res) {
+		if((res = sendmmsg(b->sockfd, &b->msgs[sent], b->count - sent, 0)) <= 0) {
+			b->count = 0;
+
+			return(-1);
+		}
+	}
+
+	b->count = 0;
+
+	return(sent);
+}
@@ -0,0 +1,117 @@
+/**
+ * @file overload.c
+ *
+ * yamdns -- yet another very simple mdns.
+ * Copyright (C) 2013  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "overload.h"
+
+/*------------------------------------------------------------------------*/
+
+/** duration of pressure after last drop, ms */
+#define __MDNS_OVERLOAD_HOLD 5000
+
+/** price of query in tokens */
+#define __MDNS_OVERLOAD_TOKEN 1000
+
+/** buckets of one set, the least recently used one is taken over */
+#define __MDNS_OVERLOAD_WAYS 4
+
+/*------------------------------------------------------------------------*/
+
+void mdns_overload_init(mdns_overload_t* o)
+{
+	memset(o, 0, sizeof(*o));
+}
+
+/*------------------------------------------------------------------------*/
+
+void mdns_overload_drops(mdns_overload_t* o, unsigned socket, uint32_t counter, uint64_t now)
+{
+	/* counter of socket only grows, with wrap */
+	if(socket >= MDNS_OVERLOAD_SOCKETS || counter == o->counters[socket]) {
+		return;
+	}
+
+	o->stats.drops += (uint32_t)(counter - o->counters[socket]);
+	o->counters[socket] = counter;
+	o->pressure = now + __MDNS_OVERLOAD_HOLD;
+}
+
+/*------------------------------------------------------------------------*/
+
+static uint32_t mdns_overload_hash(const void* addr, size_t len)
+{
+	const uint8_t* pos = addr;
+	uint32_t hash = 0x811c9dc5;
+
+	/* FNV-1a */
+	while(len --) {
+		hash = (hash ^ *pos ++) * 0x01000193;
+	}
+
+	/* zero marks free bucket */
+	return(hash ? hash : 1);
+}
+
+/*------------------------------------------------------------------------*/
+
+int mdns_overload_admit(mdns_overload_t* o, const void* addr, size_t len, uint64_t now)
+{
+	mdns_overload_bucket_t *set, *b;
+	uint64_t tokens;
+	uint32_t hash;
+	unsigned i;
+
+	hash = mdns_overload_hash(addr, len);
+	set = &o->buckets[(hash * __MDNS_OVERLOAD_WAYS) & (MDNS_OVERLOAD_SOURCES - 1)];
+
+	for(i = 0, b = set; i < __MDNS_OVERLOAD_WAYS && set[i].hash != hash; ++ i) {
+		if(b->hash && (!set[i].hash || set[i].last < b->last)) {
+			b = &set[i];
+		}
+	}
+
+	if(i < __MDNS_OVERLOAD_WAYS) {
+		b = &set[i];
+	} else if(!b->hash) {
+		/* new source takes free bucket with full burst */
+		b->hash = hash;
+		b->tokens = MDNS_OVERLOAD_BURST * __MDNS_OVERLOAD_TOKEN;
+		b->last = now;
+	} else {
+		/* taken over bucket keeps its tokens, so new addresses don't renew burst */
+		b->hash = hash;
+	}
+
+	/* refill, rate is in queries per second */
+	tokens = b->tokens + (now - b->last) * MDNS_OVERLOAD_RATE;
+	b->tokens = tokens < MDNS_OVERLOAD_BURST * __MDNS_OVERLOAD_TOKEN ? tokens : MDNS_OVERLOAD_BURST * __MDNS_OVERLOAD_TOKEN;
+	b->last = now;
+
+	if(b->tokens < __MDNS_OVERLOAD_TOKEN) {
+		++ o->stats.limited;
+
+		return(MDNS_SHED_REPEATS);
+	}
+
+	b->tokens -= __MDNS_OVERLOAD_TOKEN;
+
+	return(now < o->pressure ? MDNS_SHED_BROWSE : MDNS_SHED_NONE);
+}
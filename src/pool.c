@@ -0,0 +1,338 @@
+/**
+ * @file pool.c
+ *
+ * yamdns -- yet another very simple mdns.
+ * Copyright (C) 2013  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <stdint.h>
+
+#include "pool.h"
+
+#ifdef MDNS_STATIC
+#include "records.h"
+#include "responder.h"
+#include "services.h"
+#include "reverse.h"
+#endif
+
+/*------------------------------------------------------------------------*/
+
+/** end of initialized data and end of .bss, see end(3) */
+extern char edata, end;
+
+/*------------------------------------------------------------------------*/
+
+#ifdef MDNS_STATIC
+
+/** alignment of blocks */
+#define __MDNS_POOL_ALIGN 16
+
+/** round size up to alignment */
+#define __MDNS_POOL_ROUND(size) (((size) + __MDNS_POOL_ALIGN - 1) & ~(size_t)(__MDNS_POOL_ALIGN - 1))
+
+/**
+ * sizes of pools
+ *
+ * Arrays grow twice and old array is copied, so for a moment both exist,
+ * tables of config and API are built aside before swap and registered
+ * records are copied for their clients, so the sum of tables is covered
+ * six times.
+ */
+#define __MDNS_POOL_RECORDS __MDNS_POOL_ROUND(6 * (MDNS_STATIC_RECORDS * \
+	(sizeof(mdns_record_t) + 4 * sizeof(uint32_t)) + MDNS_STATIC_NAMES) + \
+	(MDNS_STATIC_PROBES + 8) * (sizeof(mdns_records_t) + __MDNS_POOL_ALIGN))
+
+/* jobs of old and new mapped table have bitmaps for a moment */
+#define __MDNS_POOL_PROBES __MDNS_POOL_ROUND(MDNS_STATIC_PROBES * \
+	__MDNS_POOL_ROUND(sizeof(mdns_probe_t) + __MDNS_POOL_ALIGN) + \
+	2 * __MDNS_POOL_ROUND(MDNS_STATIC_RECORDS / 8 + 1 + __MDNS_POOL_ALIGN))
+
+/* answers of type are about 2 KB and grow twice too */
+#define __MDNS_POOL_SERVICES __MDNS_POOL_ROUND(MDNS_STATIC_SERVICES * \
+	(sizeof(mdns_service_type_t) + 6 * 1024 + 4 * sizeof(void*)))
+
+#define __MDNS_POOL_REVERSE __MDNS_POOL_ROUND(MDNS_STATIC_RANGES * \
+	(3 * sizeof(mdns_reverse_range_t) + 4 * sizeof(uint32_t)))
+
+/*------------------------------------------------------------------------*/
+
+/** header of block, data follows it */
+typedef struct mdns_pool_block {
+	/** size of block with header */
+	uint32_t size;
+
+	/** block is free */
+	uint32_t free;
+
+	/** data is aligned */
+	uint64_t reserved;
+} mdns_pool_block_t;
+
+/** pool of one kind of memory */
+typedef struct mdns_pool {
+	/** name for report */
+	const char* name;
+
+	/** memory in .bss */
+	uint8_t* heap;
+
+	/** size of memory */
+	size_t size;
+
+	/** size of allocated blocks with headers */
+	size_t used;
+
+	/** max of used */
+	size_t peak;
+
+	/** number of failed allocations */
+	unsigned long failed;
+} mdns_pool_t;
+
+/*------------------------------------------------------------------------*/
+
+static uint8_t __heap_records[__MDNS_POOL_RECORDS] __attribute__((aligned(__MDNS_POOL_ALIGN)));
+static uint8_t __heap_probes[__MDNS_POOL_PROBES] __attribute__((aligned(__MDNS_POOL_ALIGN)));
+static uint8_t __heap_services[__MDNS_POOL_SERVICES] __attribute__((aligned(__MDNS_POOL_ALIGN)));
+static uint8_t __heap_reverse[__MDNS_POOL_REVERSE] __attribute__((aligned(__MDNS_POOL_ALIGN)));
+
+static mdns_pool_t pools[MDNS_POOL_COUNT] = {
+	[MDNS_POOL_RECORDS] = {"records", __heap_records, sizeof(__heap_records)},
+	[MDNS_POOL_PROBES] = {"probes", __heap_probes, sizeof(__heap_probes)},
+	[MDNS_POOL_SERVICES] = {"services", __heap_services, sizeof(__heap_services)},
+	[MDNS_POOL_REVERSE] = {"reverse", __heap_reverse, sizeof(__heap_reverse)},
+};
+
+/*------------------------------------------------------------------------*/
+
+static mdns_pool_block_t* mdns_pool_block(const mdns_pool_t* p, size_t pos)
+{
+	return((mdns_pool_block_t*)(p->heap + pos));
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_pool_merge(mdns_pool_t* p, mdns_pool_block_t* b)
+{
+	mdns_pool_block_t* next;
+	size_t pos;
+
+	/* free blocks are joined lazily, when they are passed by */
+	for(pos = (uint8_t*)b - p->heap + b->size; pos < p->size; pos += next->size) {
+		next = mdns_pool_block(p, pos);
+
+		if(!next->free) {
+			break;
+		}
+
+		b->size += next->size;
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_pool_split(mdns_pool_t* p, mdns_pool_block_t* b, size_t need)
+{
+	mdns_pool_block_t* rest;
+
+	if(b->size - need < sizeof(*b) + __MDNS_POOL_ALIGN) {
+		return;
+	}
+
+	rest = (mdns_pool_block_t*)((uint8_t*)b + need);
+	rest->size = b->size - need;
+	rest->free = 1;
+	b->size = need;
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_pool_use(mdns_pool_t* p, size_t before, size_t after)
+{
+	p->used += after - before;
+
+	if(p->used > p->peak) {
+		p->peak = p->used;
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+void* mdns_pool_alloc(unsigned kind, size_t size)
+{
+	mdns_pool_t* p = &pools[kind];
+	mdns_pool_block_t* b;
+	size_t need, pos;
+
+	/* the whole pool is one free block at first */
+	if(!mdns_pool_block(p, 0)->size) {
+		mdns_pool_block(p, 0)->size = p->size;
+		mdns_pool_block(p, 0)->free = 1;
+	}
+
+	need = sizeof(*b) + __MDNS_POOL_ROUND(size ? size : 1);
+
+	/* first fit, pools are small and have few blocks */
+	for(pos = 0; size < p->size && pos < p->size; pos += b->size) {
+		b = mdns_pool_block(p, pos);
+
+		if(!b->free) {
+			continue;
+		}
+
+		mdns_pool_merge(p, b);
+
+		if(b->size >= need) {
+			mdns_pool_split(p, b, need);
+			b->free = 0;
+			mdns_pool_use(p, 0, b->size);
+
+			return(b + 1);
+		}
+	}
+
+	++ p->failed;
+
+	return(NULL);
+}
+
+/*------------------------------------------------------------------------*/
+
+void* mdns_pool_calloc(unsigned kind, size_t n, size_t size)
+{
+	void* ptr;
+
+	if(size && n > SIZE_MAX / size) {
+		return(NULL);
+	}
+
+	if((ptr = mdns_pool_alloc(kind, n * size))) {
+		memset(ptr, 0, n * size);
+	}
+
+	return(ptr);
+}
+
+/*------------------------------------------------------------------------*/
+
+static mdns_pool_t* mdns_pool_of(const void* ptr)
+{
+	unsigned i;
+
+	for(i = 0; i < MDNS_POOL_COUNT; ++ i) {
+		if((const uint8_t*)ptr >= pools[i].heap && (const uint8_t*)ptr < pools[i].heap + pools[i].size) {
+			return(&pools[i]);
+		}
+	}
+
+	return(NULL);
+}
+
+/*------------------------------------------------------------------------*/
+
+void* mdns_pool_realloc(unsigned kind, void* ptr, size_t size)
+{
+	mdns_pool_block_t* b;
+	mdns_pool_t* p;
+	size_t need, old;
+	void* res;
+
+	if(!ptr) {
+		return(mdns_pool_alloc(kind, size));
+	}
+
+	p = mdns_pool_of(ptr);
+	b = (mdns_pool_block_t*)ptr - 1;
+	old = b->size;
+
+	if(size >= p->size) {
+		++ p->failed;
+
+		return(NULL);
+	}
+
+	need = sizeof(*b) + __MDNS_POOL_ROUND(size ? size : 1);
+
+	/* grow in place into following free blocks */
+	mdns_pool_merge(p, b);
+
+	if(b->size >= need) {
+		mdns_pool_split(p, b, need);
+		mdns_pool_use(p, old, b->size);
+
+		return(ptr);
+	}
+
+	/* merged blocks are given back, the rest may stay too small to split */
+	mdns_pool_split(p, b, old);
+	mdns_pool_use(p, old, b->size);
+
+	if(!(res = mdns_pool_alloc(kind, size))) {
+		return(NULL);
+	}
+
+	memcpy(res, ptr, old - sizeof(*b));
+	mdns_pool_free(ptr);
+
+	return(res);
+}
+
+/*------------------------------------------------------------------------*/
+
+void mdns_pool_free(void* ptr)
+{
+	mdns_pool_block_t* b;
+	mdns_pool_t* p;
+
+	if(!ptr) {
+		return;
+	}
+
+	p = mdns_pool_of(ptr);
+	b = (mdns_pool_block_t*)ptr - 1;
+	b->free = 1;
+	p->used -= b->size;
+}
+
+/*------------------------------------------------------------------------*/
+
+void mdns_pool_report(FILE* f)
+{
+	size_t total = 0;
+	unsigned i;
+
+	for(i = 0; i < MDNS_POOL_COUNT; ++ i) {
+		fprintf(f, "pool %s: size %zu, used %zu, peak %zu, failed %lu\n",
+			pools[i].name, pools[i].size, pools[i].used, pools[i].peak, pools[i].failed);
+		total += pools[i].size;
+	}
+
+	fprintf(f, "static memory: .bss %zu bytes, pools %zu bytes included\n", (size_t)(&end - &edata), total);
+}
+
+#else
+
+/*------------------------------------------------------------------------*/
+
+void mdns_pool_report(FILE* f)
+{
+	fprintf(f, "pools: malloc(), not limited\n");
+	fprintf(f, "static memory: .bss %zu bytes\n", (size_t)(&end - &edata));
+}
+
+#endif /* MDNS_STATIC */
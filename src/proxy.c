@@ -0,0 +1,371 @@
+/**
+ * @file proxy.c
+ *
+ * yamdns -- yet another very simple mdns.
+ * Copyright (C) 2013  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <arpa/inet.h>
+
+#include <yamdns/yamdns.h>
+
+#include "proxy.h"
+#include "services.h"
+
+/*------------------------------------------------------------------------*/
+
+/** time to answer query before host is asleep, ms */
+#define __MDNS_PROXY_SILENCE 1000
+
+/** records of silent host are forgotten after lease, ms */
+#define __MDNS_PROXY_LEASE 7200000ULL
+
+/** max number of remembered records of one packet */
+#define __MDNS_PROXY_RRSET 32
+
+/*------------------------------------------------------------------------*/
+
+/** context of snooping */
+typedef struct mdns_proxy_snoop {
+	/** proxy of hosts */
+	mdns_proxy_t* proxy;
+
+	/** host of packet */
+	mdns_proxy_owner_t* owner;
+
+	/** number of added and removed records */
+	int changed;
+
+	/** current time in milliseconds */
+	uint64_t now;
+
+	/** number of records of packet */
+	unsigned count;
+
+	/** identities of records of packet, they don't flush each other */
+	uint32_t idents[__MDNS_PROXY_RRSET];
+} mdns_proxy_snoop_t;
+
+/*------------------------------------------------------------------------*/
+
+void mdns_proxy_init(mdns_proxy_t* p)
+{
+	memset(p, 0, sizeof(*p));
+}
+
+/*------------------------------------------------------------------------*/
+
+void mdns_proxy_free(mdns_proxy_t* p)
+{
+	unsigned i;
+
+	for(i = 0; i < p->count; ++ i) {
+		mdns_records_free(&p->owners[i].recs);
+	}
+
+	mdns_proxy_init(p);
+}
+
+/*------------------------------------------------------------------------*/
+
+int mdns_proxy_owner(mdns_proxy_t* p, struct in_addr addr)
+{
+	mdns_proxy_owner_t* o;
+
+	if(p->count == MDNS_PROXY_OWNERS) {
+		return(-1);
+	}
+
+	o = &p->owners[p->count ++];
+	memset(o, 0, sizeof(*o));
+	o->addr = addr;
+	mdns_records_init(&o->recs);
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int mdns_proxy_fresh(const mdns_proxy_snoop_t* s, const mdns_record_t* rec)
+{
+	unsigned i;
+
+	for(i = 0; i < s->count && i < __MDNS_PROXY_RRSET; ++ i) {
+		if(s->idents[i] == rec->ident) {
+			return(1);
+		}
+	}
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_proxy_flush(mdns_proxy_snoop_t* s, const char* root, uint16_t type, const void* rdata, size_t rd_len)
+{
+	mdns_records_t* t = &s->owner->recs;
+	const mdns_record_t* rec;
+	uint32_t hash;
+
+	hash = mdns_name_hash(root);
+
+	/* other data of RRset from earlier packets is stale, RFC 6762 10.2 */
+	for(rec = mdns_records_find(t, hash, root, NULL); rec;) {
+		if(rec->type != type || mdns_proxy_fresh(s, rec) ||
+		   (rec->rd_len == rd_len && !memcmp(mdns_record_rdata(t, rec), rdata, rd_len))) {
+			rec = mdns_records_find(t, hash, root, rec);
+
+			continue;
+		}
+
+		/* removing moves records, so restart search */
+		mdns_records_remove(t, rec);
+		++ s->changed;
+
+		rec = mdns_records_find(t, hash, root, NULL);
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_proxy_record(mdns_proxy_snoop_t* s, const mdns_answer_hdr_t* h, const char* root, const void* rdata, size_t rd_len)
+{
+	const mdns_record_t* rec;
+	uint16_t type;
+
+	type = ntohs(h->a_type);
+
+	/* shared records are answered by their other owners too */
+	if(type == MDNS_RECORD_PTR && mdns_services_is_type(root)) {
+		return;
+	}
+
+	rec = mdns_records_get(&s->owner->recs, root, type, rdata, rd_len);
+
+	/* goodbye */
+	if(!h->a_ttl) {
+		if(rec && !mdns_records_remove(&s->owner->recs, rec)) {
+			++ s->changed;
+		}
+
+		return;
+	}
+
+	if(ntohs(h->a_class) & MDNS_CLASS_FLUSH) {
+		mdns_proxy_flush(s, root, type, rdata, rd_len);
+	}
+
+	/* known record gets new time of expiry */
+	if(mdns_records_add(&s->owner->recs, root, type, s->now / 1000 + ntohl(h->a_ttl), rdata, rd_len)) {
+		return;
+	}
+
+	if(!rec) {
+		++ s->changed;
+	}
+
+	if(s->count < __MDNS_PROXY_RRSET && (rec = mdns_records_get(&s->owner->recs, root, type, rdata, rd_len))) {
+		s->idents[s->count ++] = rec->ident;
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_proxy_answer_handler_a(void* ctx, const mdns_answer_hdr_t* h, const char* root, struct in_addr* in)
+{
+	mdns_proxy_record(ctx, h, root, in, sizeof(*in));
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_proxy_answer_handler_aaaa(void* ctx, const mdns_answer_hdr_t* h, const char* root, struct in6_addr* in6)
+{
+	mdns_proxy_record(ctx, h, root, in6, sizeof(*in6));
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_proxy_answer_handler_ptr(void* ctx, const mdns_answer_hdr_t* h, const char* root, const char* ptr)
+{
+	uint8_t rdata[MDNS_MAX_NAME];
+	size_t len;
+
+	/* names are kept uncompressed */
+	if((len = mdns_name_encode(rdata, sizeof(rdata), ptr))) {
+		mdns_proxy_record(ctx, h, root, rdata, len);
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_proxy_answer_handler_text(void* ctx, const mdns_answer_hdr_t* h, const char* root, const mdns_text_t* text)
+{
+	mdns_proxy_record(ctx, h, root, text->data, text->len);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_proxy_answer_handler_srv(void* ctx, const mdns_answer_hdr_t* h, const char* root, mdns_record_srv_t* srv, const char* target)
+{
+	uint8_t rdata[sizeof(*srv) + MDNS_MAX_NAME];
+	size_t len;
+
+	memcpy(rdata, srv, sizeof(*srv));
+
+	if((len = mdns_name_encode(rdata + sizeof(*srv), sizeof(rdata) - sizeof(*srv), target))) {
+		mdns_proxy_record(ctx, h, root, rdata, sizeof(*srv) + len);
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+static mdns_proxy_owner_t* mdns_proxy_find(mdns_proxy_t* p, struct in_addr addr)
+{
+	unsigned i;
+
+	for(i = 0; i < p->count; ++ i) {
+		if(p->owners[i].addr.s_addr == addr.s_addr) {
+			return(&p->owners[i]);
+		}
+	}
+
+	return(NULL);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_proxy_owner_handler_a(void* ctx, const mdns_answer_hdr_t* h, const char* root, struct in_addr* in)
+{
+	mdns_proxy_snoop_t* s = ctx;
+	struct in_addr addr;
+
+	/* address record names the host, rdata may be unaligned */
+	if(!s->owner) {
+		memcpy(&addr, in, sizeof(addr));
+		s->owner = mdns_proxy_find(s->proxy, addr);
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+int mdns_proxy_snoop(mdns_proxy_t* p, const struct in_addr* from, const void* buf, size_t len, uint64_t now)
+{
+	mdns_handlers_t owner = {
+		.a = mdns_proxy_owner_handler_a,
+	};
+	const mdns_hdr_t* hdr = buf;
+	mdns_handlers_t handlers = {
+		.a = mdns_proxy_answer_handler_a,
+		.aaaa = mdns_proxy_answer_handler_aaaa,
+		.ptr = mdns_proxy_answer_handler_ptr,
+		.text = mdns_proxy_answer_handler_text,
+		.srv = mdns_proxy_answer_handler_srv,
+	};
+	mdns_proxy_snoop_t s;
+
+	s.proxy = p;
+	s.owner = NULL;
+
+	/* IPv6 source is not an address of owner, but its records are */
+	if(from) {
+		s.owner = mdns_proxy_find(p, *from);
+	} else if(len >= sizeof(*hdr) && (ntohs(hdr->flags) & MDNS_FLAG_ANSWER)) {
+		mdns_packet_process(buf, len, &owner, &s);
+	}
+
+	if(!s.owner) {
+		return(0);
+	}
+
+	s.changed = 0;
+	s.now = now;
+	s.count = 0;
+
+	/* any packet shows that host is awake */
+	s.owner->seen = now;
+	s.owner->asked = 0;
+
+	if(s.owner->asleep) {
+		s.owner->asleep = 0;
+		++ s.changed;
+	}
+
+	/* records of queries are known answers or proposals of probe */
+	if(len >= sizeof(*hdr) && (ntohs(hdr->flags) & MDNS_FLAG_ANSWER)) {
+		mdns_packet_process(buf, len, &handlers, &s);
+	}
+
+	return(s.changed);
+}
+
+/*------------------------------------------------------------------------*/
+
+int mdns_proxy_update(mdns_proxy_t* p, uint64_t now)
+{
+	mdns_proxy_owner_t* o;
+	int changed = 0;
+	unsigned i;
+	uint32_t j;
+
+	for(i = 0; i < p->count; ++ i) {
+		o = &p->owners[i];
+
+		if(!o->asleep && o->asked && now >= o->asked + __MDNS_PROXY_SILENCE) {
+			o->asleep = 1;
+			o->asked = 0;
+			++ changed;
+		}
+
+		/* lease of records is over */
+		if(o->asleep && o->recs.count && now >= o->seen + __MDNS_PROXY_LEASE) {
+			mdns_records_free(&o->recs);
+			++ changed;
+		}
+
+		/* time to live of record is over, last record moves into hole */
+		for(j = o->recs.count; j > 0; -- j) {
+			if(o->recs.recs[j - 1].ttl <= now / 1000) {
+				mdns_records_remove(&o->recs, &o->recs.recs[j - 1]);
+				++ changed;
+			}
+		}
+	}
+
+	return(changed);
+}
+
+/*------------------------------------------------------------------------*/
+
+uint32_t mdns_proxy_ttl(const mdns_record_t* rec, uint64_t now)
+{
+	return(rec->ttl > now / 1000 ? rec->ttl - now / 1000 : 0);
+}
+
+/*------------------------------------------------------------------------*/
+
+int mdns_proxy_has_hash(const mdns_proxy_t* p, uint32_t hash)
+{
+	unsigned i;
+
+	for(i = 0; i < p->count; ++ i) {
+		if(mdns_records_has_hash(&p->owners[i].recs, hash)) {
+			return(1);
+		}
+	}
+
+	return(0);
+}
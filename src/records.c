@@ -0,0 +1,610 @@
+/**
+ * @file records.c
+ *
+ * yamdns -- yet another very simple mdns.
+ * Copyright (C) 2013  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <arpa/inet.h>
+
+#include <yamdns/yamdns.h>
+
+#include "records.h"
+#include "pool.h"
+#include "name.h"
+
+/*------------------------------------------------------------------------*/
+
+/** initial number of hash buckets */
+#define __MDNS_RECORDS_BUCKETS 64
+
+/*------------------------------------------------------------------------*/
+
+void mdns_records_init(mdns_records_t* t)
+{
+	memset(t, 0, sizeof(*t));
+}
+
+/*------------------------------------------------------------------------*/
+
+void mdns_records_free(mdns_records_t* t)
+{
+	if(t->map) {
+		munmap(t->map, t->map_len);
+		mdns_records_init(t);
+
+		return;
+	}
+
+	mdns_pool_free(t->recs);
+	mdns_pool_free(t->buckets);
+	mdns_pool_free(t->pool);
+
+	mdns_records_init(t);
+}
+
+/*------------------------------------------------------------------------*/
+
+static uint32_t mdns_records_ident(uint32_t hash, uint16_t type, const void* rdata, size_t rd_len)
+{
+	const uint8_t* pos = rdata;
+
+	/* FNV-1a over type and rdata, seeded by hash of owner */
+	hash = (hash ^ type) * 0x01000193;
+
+	while(rd_len --) {
+		hash = (hash ^ *pos ++) * 0x01000193;
+	}
+
+	return(hash);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_records_link(mdns_records_t* t, uint32_t i)
+{
+	mdns_record_t* r = &t->recs[i];
+	uint32_t mask = t->nbuckets - 1;
+
+	r->next = t->buckets[r->hash & mask];
+	t->buckets[r->hash & mask] = i;
+
+	r->inext = t->buckets[t->nbuckets + (r->ident & mask)];
+	t->buckets[t->nbuckets + (r->ident & mask)] = i;
+}
+
+/*------------------------------------------------------------------------*/
+
+static int mdns_records_rehash(mdns_records_t* t, uint32_t nbuckets)
+{
+	uint32_t* buckets;
+	uint32_t i;
+
+	if(!(buckets = mdns_pool_alloc(MDNS_POOL_RECORDS, 2 * nbuckets * sizeof(*buckets)))) {
+		return(-1);
+	}
+
+	memset(buckets, 0xff, 2 * nbuckets * sizeof(*buckets));
+
+	mdns_pool_free(t->buckets);
+	t->buckets = buckets;
+	t->nbuckets = nbuckets;
+
+	/* relink all records, keep order of records with the same hash */
+	for(i = t->count; i > 0; -- i) {
+		mdns_records_link(t, i - 1);
+	}
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int mdns_records_pool_put(mdns_records_t* t, const void* data, size_t len, uint32_t* offset)
+{
+	size_t size;
+	char* pool;
+
+	if(t->pool_len + len > t->pool_size) {
+		size = t->pool_size ? t->pool_size : 4096;
+
+		while(t->pool_len + len > size) {
+			size <<= 1;
+		}
+
+		if(size > UINT32_MAX || !(pool = mdns_pool_realloc(MDNS_POOL_RECORDS, t->pool, size))) {
+			return(-1);
+		}
+
+		t->pool = pool;
+		t->pool_size = size;
+	}
+
+	memcpy(&t->pool[t->pool_len], data, len);
+	*offset = t->pool_len;
+	t->pool_len += len;
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+static const mdns_record_t* mdns_records_lookup(const mdns_records_t* t, uint32_t ident, uint32_t hash, const char* name, uint16_t type, const void* rdata, size_t rd_len)
+{
+	const mdns_record_t* r;
+	uint32_t i;
+
+	if(!t->nbuckets) {
+		return(NULL);
+	}
+
+	for(i = t->buckets[t->nbuckets + (ident & (t->nbuckets - 1))]; i < t->count; i = r->inext) {
+		r = &t->recs[i];
+
+		if(r->ident == ident && r->hash == hash && r->type == type && r->rd_len == rd_len &&
+		   !memcmp(mdns_record_rdata(t, r), rdata, rd_len) &&
+		   !mdns_name_casecmp(mdns_record_name(t, r), name)) {
+			return(r);
+		}
+	}
+
+	return(NULL);
+}
+
+/*------------------------------------------------------------------------*/
+
+int mdns_records_add(mdns_records_t* t, const char* name, uint16_t type, uint32_t ttl, const void* rdata, size_t rd_len)
+{
+	char root[MDNS_MAX_NAME];
+	mdns_record_t* r;
+	uint32_t hash, ident;
+	size_t len;
+
+	len = strlen(name);
+
+	/* mapped table is read only */
+	if(t->map) {
+		return(-1);
+	}
+
+	/* owner name is always kept with last dot */
+	if(!len || len + 2 > sizeof(root) || rd_len > UINT16_MAX) {
+		return(-1);
+	}
+
+	memcpy(root, name, len + 1);
+	if(root[len - 1] != '.') {
+		root[len ++] = '.';
+		root[len] = 0;
+	}
+
+	hash = mdns_name_hash(root);
+	ident = mdns_records_ident(hash, type, rdata, rd_len);
+
+	/* already present record, just update time to live */
+	if((r = (mdns_record_t*)mdns_records_lookup(t, ident, hash, root, type, rdata, rd_len))) {
+		r->ttl = ttl;
+
+		return(0);
+	}
+
+	/* grow array of records */
+	if(t->count == t->size) {
+		mdns_record_t* recs;
+		uint32_t size;
+
+		size = t->size ? t->size << 1 : 32;
+
+		if(!(recs = mdns_pool_realloc(MDNS_POOL_RECORDS, t->recs, size * sizeof(*recs)))) {
+			return(-1);
+		}
+
+		t->recs = recs;
+		t->size = size;
+	}
+
+	r = &t->recs[t->count];
+	r->hash = hash;
+	r->ident = ident;
+	r->type = type;
+	r->ttl = ttl;
+	r->rd_len = rd_len;
+
+	if(mdns_records_pool_put(t, root, len + 1, &r->name) ||
+	   mdns_records_pool_put(t, rdata, rd_len, &r->rdata)) {
+		return(-1);
+	}
+
+	++ t->count;
+
+	/* keep load factor not more than one */
+	if(t->count > t->nbuckets) {
+		if(mdns_records_rehash(t, t->nbuckets ? t->nbuckets << 1 : __MDNS_RECORDS_BUCKETS)) {
+			-- t->count;
+
+			return(-1);
+		}
+	} else {
+		mdns_records_link(t, t->count - 1);
+	}
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_records_unlink(mdns_records_t* t, uint32_t i)
+{
+	mdns_record_t* r = &t->recs[i];
+	uint32_t mask = t->nbuckets - 1;
+	uint32_t* pos;
+
+	for(pos = &t->buckets[r->hash & mask]; *pos != i; pos = &t->recs[*pos].next);
+	*pos = r->next;
+
+	for(pos = &t->buckets[t->nbuckets + (r->ident & mask)]; *pos != i; pos = &t->recs[*pos].inext);
+	*pos = r->inext;
+}
+
+/*------------------------------------------------------------------------*/
+
+static int mdns_records_compact(mdns_records_t* t)
+{
+	mdns_record_t* r;
+	char* pool;
+	uint32_t i, len;
+
+	if(!(pool = mdns_pool_alloc(MDNS_POOL_RECORDS, t->pool_size))) {
+		return(-1);
+	}
+
+	len = 0;
+
+	/* copy only live names and rdata */
+	for(i = 0, r = t->recs; i < t->count; ++ i, ++ r) {
+		strcpy(&pool[len], mdns_record_name(t, r));
+		r->name = len;
+		len += strlen(&pool[len]) + 1;
+
+		memcpy(&pool[len], mdns_record_rdata(t, r), r->rd_len);
+		r->rdata = len;
+		len += r->rd_len;
+	}
+
+	mdns_pool_free(t->pool);
+	t->pool = pool;
+	t->pool_len = len;
+	t->pool_garbage = 0;
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+int mdns_records_remove(mdns_records_t* t, const mdns_record_t* r)
+{
+	uint32_t i, last;
+
+	i = r - t->recs;
+
+	if(t->map || i >= t->count) {
+		return(-1);
+	}
+
+	t->pool_garbage += strlen(mdns_record_name(t, r)) + 1 + r->rd_len;
+
+	mdns_records_unlink(t, i);
+
+	/* move last record into the hole */
+	last = t->count - 1;
+
+	if(i != last) {
+		mdns_records_unlink(t, last);
+		t->recs[i] = t->recs[last];
+		mdns_records_link(t, i);
+	}
+
+	-- t->count;
+
+	/* release pool, if the most of it is garbage */
+	if(t->pool_garbage > 4096 && t->pool_garbage > t->pool_len / 2) {
+		mdns_records_compact(t);
+	}
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+int mdns_records_add_service(mdns_records_t* t, const char* instance, const char* service, uint16_t port, const char* host, const void* txt, size_t txt_len)
+{
+	char type[MDNS_MAX_NAME];
+	char name[MDNS_MAX_NAME];
+	uint8_t rdata[sizeof(mdns_record_srv_t) + MDNS_MAX_NAME];
+	mdns_record_srv_t* srv;
+	size_t len;
+
+	/* dots inside instance name are not supported */
+	if(!*instance || strchr(instance, '.') || strlen(instance) >= MDNS_MAX_LABEL_NAME) {
+		return(-1);
+	}
+
+	/* full names of service type and instance */
+	if(snprintf(type, sizeof(type), "%s.%s", service, MDNS_DOMAIN) >= sizeof(type) ||
+	   snprintf(name, sizeof(name), "%s.%s", instance, type) >= sizeof(name)) {
+		return(-1);
+	}
+
+	/* service type points to instance */
+	if(!(len = mdns_name_encode(rdata, sizeof(rdata), name)) ||
+	   mdns_records_add(t, type, MDNS_RECORD_PTR, 4500, rdata, len)) {
+		return(-1);
+	}
+
+	/* instance points to host */
+	srv = (mdns_record_srv_t*)rdata;
+	srv->priority = 0;
+	srv->weight = 0;
+	srv->port = htons(port);
+
+	if(!(len = mdns_name_encode(srv->hostname, sizeof(rdata) - sizeof(*srv), host)) ||
+	   mdns_records_add(t, name, MDNS_RECORD_SRV, 120, rdata, sizeof(*srv) + len)) {
+		return(-1);
+	}
+
+	/* TXT record is mandatory, even empty */
+	if(!txt_len) {
+		txt = "";
+		txt_len = 1;
+	}
+
+	return(mdns_records_add(t, name, MDNS_RECORD_TEXT, 4500, txt, txt_len));
+}
+
+/*------------------------------------------------------------------------*/
+
+const mdns_record_t* mdns_records_find(const mdns_records_t* t, uint32_t hash, const char* name, const mdns_record_t* prev)
+{
+	uint32_t i;
+
+	if(!t->nbuckets) {
+		return(NULL);
+	}
+
+	i = prev ? prev->next : t->buckets[hash & (t->nbuckets - 1)];
+
+	for(; i < t->count; i = t->recs[i].next) {
+		if(t->recs[i].hash == hash && !mdns_name_casecmp(mdns_record_name(t, &t->recs[i]), name)) {
+			return(&t->recs[i]);
+		}
+	}
+
+	return(NULL);
+}
+
+/*------------------------------------------------------------------------*/
+
+int mdns_records_has_hash(const mdns_records_t* t, uint32_t hash)
+{
+	uint32_t i;
+
+	if(!t->nbuckets) {
+		return(0);
+	}
+
+	for(i = t->buckets[hash & (t->nbuckets - 1)]; i < t->count; i = t->recs[i].next) {
+		if(t->recs[i].hash == hash) {
+			return(1);
+		}
+	}
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+const mdns_record_t* mdns_records_get(const mdns_records_t* t, const char* name, uint16_t type, const void* rdata, size_t rd_len)
+{
+	uint32_t hash;
+
+	hash = mdns_name_hash(name);
+
+	return(mdns_records_lookup(t, mdns_records_ident(hash, type, rdata, rd_len), hash, name, type, rdata, rd_len));
+}
+
+/*------------------------------------------------------------------------*/
+
+const mdns_record_t* mdns_records_match(const mdns_records_t* t, const mdns_records_t* from, const mdns_record_t* r)
+{
+	return(mdns_records_lookup(t, r->ident, r->hash, mdns_record_name(from, r), r->type, mdns_record_rdata(from, r), r->rd_len));
+}
+
+/*------------------------------------------------------------------------*/
+
+/** align offset in database file */
+#define __MDNS_DB_ALIGN(x) (((x) + 7) & ~(size_t)7)
+
+int mdns_records_save(const mdns_records_t* t, const char* path)
+{
+	char tmp[MDNS_MAX_NAME * 4];
+	mdns_db_hdr_t hdr;
+	FILE* f;
+
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, MDNS_DB_MAGIC, sizeof(hdr.magic));
+	hdr.version = MDNS_DB_VERSION;
+	hdr.rec_size = sizeof(mdns_record_t);
+	hdr.count = t->count;
+	hdr.nbuckets = t->nbuckets;
+	hdr.pool_len = t->pool_len;
+	hdr.recs = __MDNS_DB_ALIGN(sizeof(hdr));
+	hdr.buckets = __MDNS_DB_ALIGN(hdr.recs + t->count * sizeof(mdns_record_t));
+	hdr.pool = __MDNS_DB_ALIGN(hdr.buckets + 2 * t->nbuckets * sizeof(uint32_t));
+
+	if(snprintf(tmp, sizeof(tmp), "%s.tmp", path) >= sizeof(tmp)) {
+		return(-1);
+	}
+
+	if(!(f = fopen(tmp, "w"))) {
+		return(-1);
+	}
+
+	/* parts of table with zero padding between */
+	if(fwrite(&hdr, sizeof(hdr), 1, f) != 1 ||
+	   fseek(f, hdr.recs, SEEK_SET) ||
+	   fwrite(t->recs, sizeof(mdns_record_t), t->count, f) != t->count ||
+	   fseek(f, hdr.buckets, SEEK_SET) ||
+	   fwrite(t->buckets, sizeof(uint32_t), 2 * t->nbuckets, f) != 2 * t->nbuckets ||
+	   fseek(f, hdr.pool, SEEK_SET) ||
+	   fwrite(t->pool, 1, t->pool_len, f) != t->pool_len) {
+		goto error;
+	}
+
+	if(fclose(f)) {
+		unlink(tmp);
+
+		return(-1);
+	}
+
+	return(rename(tmp, path));
+
+error:
+	fclose(f);
+	unlink(tmp);
+
+	return(-1);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int mdns_records_check_chains(const mdns_records_t* t, const uint32_t* heads, int ident)
+{
+	uint32_t i, j, steps = 0;
+
+	/* each record is in one chain only, so longer walk means loop */
+	for(j = 0; j < t->nbuckets; ++ j) {
+		for(i = heads[j]; i != MDNS_RECORDS_NONE; i = ident ? t->recs[i].inext : t->recs[i].next) {
+			if(++ steps > t->count) {
+				return(-1);
+			}
+		}
+	}
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int mdns_records_check(const mdns_records_t* t)
+{
+	const mdns_record_t* r;
+	uint32_t i;
+
+	/* number of buckets is power of two */
+	if(t->nbuckets & (t->nbuckets - 1)) {
+		return(-1);
+	}
+
+	for(i = 0; i < 2 * t->nbuckets; ++ i) {
+		if(t->buckets[i] != MDNS_RECORDS_NONE && t->buckets[i] >= t->count) {
+			return(-1);
+		}
+	}
+
+	for(i = 0, r = t->recs; i < t->count; ++ i, ++ r) {
+		if(r->name >= t->pool_len || (uint64_t)r->rdata + r->rd_len > t->pool_len ||
+		   !memchr(&t->pool[r->name], 0, t->pool_len - r->name)) {
+			return(-1);
+		}
+
+		if((r->next != MDNS_RECORDS_NONE && r->next >= t->count) || (r->inext != MDNS_RECORDS_NONE && r->inext >= t->count)) {
+			return(-1);
+		}
+	}
+
+	return(mdns_records_check_chains(t, t->buckets, 0) || mdns_records_check_chains(t, t->buckets + t->nbuckets, 1) ? -1 : 0);
+}
+
+/*------------------------------------------------------------------------*/
+
+int mdns_records_map(mdns_records_t* t, const char* path)
+{
+	const mdns_db_hdr_t* hdr;
+	struct stat st;
+	void* map;
+	int fd;
+
+	mdns_records_init(t);
+
+	if((fd = open(path, O_RDONLY | O_CLOEXEC)) == -1) {
+		return(-1);
+	}
+
+	if(fstat(fd, &st) || st.st_size < sizeof(*hdr)) {
+		close(fd);
+
+		return(-1);
+	}
+
+	/* shared mapping, the same pages for all processes */
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if(map == MAP_FAILED) {
+		return(-1);
+	}
+
+	hdr = map;
+
+	if(memcmp(hdr->magic, MDNS_DB_MAGIC, sizeof(hdr->magic)) ||
+	   hdr->version != MDNS_DB_VERSION || hdr->rec_size != sizeof(mdns_record_t) ||
+	   hdr->recs + (uint64_t)hdr->count * sizeof(mdns_record_t) > st.st_size ||
+	   hdr->buckets + 2 * (uint64_t)hdr->nbuckets * sizeof(uint32_t) > st.st_size ||
+	   hdr->pool + (uint64_t)hdr->pool_len > st.st_size ||
+	   (hdr->recs | hdr->buckets) & 7) {
+		goto error;
+	}
+
+	t->map = map;
+	t->map_len = st.st_size;
+	t->recs = (mdns_record_t*)((uint8_t*)map + hdr->recs);
+	t->count = t->size = hdr->count;
+	t->buckets = (uint32_t*)((uint8_t*)map + hdr->buckets);
+	t->nbuckets = hdr->nbuckets;
+	t->pool = (char*)map + hdr->pool;
+	t->pool_len = t->pool_size = hdr->pool_len;
+
+	if(mdns_records_check(t)) {
+		mdns_records_init(t);
+
+		goto error;
+	}
+
+	return(0);
+
+error:
+	munmap(map, st.st_size);
+
+	return(-1);
+}
@@ -0,0 +1,437 @@
+/**
+ * @file reflector.c
+ *
+ * yamdns -- yet another very simple mdns.
+ * Copyright (C) 2013  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <ctype.h>
+#include <string.h>
+#include <arpa/inet.h>
+
+#include <yamdns/yamdns.h>
+
+#include "reflector.h"
+
+/*------------------------------------------------------------------------*/
+
+/** lifetime of forwarded question or record, ms */
+#define __MDNS_REFLECT_INTERVAL 1000
+
+/** max lifetime of target host, ms */
+#define __MDNS_REFLECT_HOST_TTL 4500000ULL
+
+/** number of probed cache entries */
+#define __MDNS_REFLECT_WAYS 4
+
+/** initial value of 64-bit FNV-1a hash */
+#define __MDNS_REFLECT_HASH_INIT 0xcbf29ce484222325ULL
+
+/** one step of 64-bit FNV-1a hash */
+#define __MDNS_REFLECT_HASH_STEP(hash, c) (((hash) ^ (uint8_t)(c)) * 0x100000001b3ULL)
+
+/** flags of response are copied, but not truncation */
+#define __MDNS_REFLECT_TC 0x0200
+
+/*------------------------------------------------------------------------*/
+
+static uint64_t mdns_reflector_hash(uint64_t hash, const void* data, size_t len)
+{
+	const uint8_t* pos;
+
+	for(pos = data; len; -- len, ++ pos) {
+		hash = __MDNS_REFLECT_HASH_STEP(hash, *pos);
+	}
+
+	return(hash);
+}
+
+/*------------------------------------------------------------------------*/
+
+static uint64_t mdns_reflector_hash_name(uint64_t hash, const char* name)
+{
+	/* names are case insensitive */
+	for(; *name; ++ name) {
+		hash = __MDNS_REFLECT_HASH_STEP(hash, tolower(*name));
+	}
+
+	return(hash);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int mdns_reflector_seen(const mdns_reflect_entry_t* set, size_t size, uint64_t key, uint64_t now)
+{
+	const mdns_reflect_entry_t* e;
+	size_t i;
+
+	for(i = 0; i < __MDNS_REFLECT_WAYS; ++ i) {
+		e = &set[(key + i) & (size - 1)];
+
+		if(e->key == key && e->expires > now) {
+			return(1);
+		}
+	}
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_reflector_remember(mdns_reflect_entry_t* set, size_t size, uint64_t key, uint64_t expires)
+{
+	mdns_reflect_entry_t *e, *victim;
+	size_t i;
+
+	victim = &set[key & (size - 1)];
+
+	/* the same key or the oldest entry is replaced */
+	for(i = 0; i < __MDNS_REFLECT_WAYS; ++ i) {
+		e = &set[(key + i) & (size - 1)];
+
+		if(e->key == key) {
+			victim = e;
+			break;
+		}
+
+		if(e->expires < victim->expires) {
+			victim = e;
+		}
+	}
+
+	victim->key = key;
+	victim->expires = expires;
+}
+
+/*------------------------------------------------------------------------*/
+
+void mdns_reflector_init(mdns_reflector_t* x, unsigned ifaces, mdns_reflect_handler send, void* ctx)
+{
+	memset(x, 0, sizeof(*x));
+
+	x->ifaces = ifaces;
+	x->send = send;
+	x->send_ctx = ctx;
+}
+
+/*------------------------------------------------------------------------*/
+
+int mdns_reflector_type(mdns_reflector_t* x, const char* name)
+{
+	mdns_name_t* type;
+
+	if(x->types_count == MDNS_REFLECT_TYPES) {
+		return(-1);
+	}
+
+	type = &x->types[x->types_count];
+
+	/* root would match every name */
+	if(mdns_name_parse(type, name) || !type->count) {
+		return(-1);
+	}
+
+	++ x->types_count;
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int mdns_reflector_match(const mdns_reflector_t* x, const char* name)
+{
+	mdns_name_t n;
+	unsigned i;
+
+	if(mdns_name_parse(&n, name)) {
+		return(0);
+	}
+
+	/* type itself, its instances and subtypes */
+	for(i = 0; i < x->types_count; ++ i) {
+		if(mdns_name_suffix(&n, &x->types[i])) {
+			return(1);
+		}
+	}
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int mdns_reflector_allow(const mdns_reflector_t* x, const char* name)
+{
+	if(!x->types_count || mdns_reflector_match(x, name)) {
+		return(1);
+	}
+
+	/* addresses of hosts, which serve forwarded types */
+	return(mdns_reflector_seen(x->hosts, MDNS_REFLECT_HOSTS,
+		mdns_reflector_hash_name(__MDNS_REFLECT_HASH_INIT, name), x->now));
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_reflector_start(mdns_reflector_t* x, uint16_t flags)
+{
+	mdns_hdr_t* hdr = (mdns_hdr_t*)x->buf;
+
+	mdns_packet_init(x->buf, sizeof(x->buf));
+	hdr->flags = htons(flags & ~__MDNS_REFLECT_TC);
+	x->len = sizeof(*hdr);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_reflector_flush(mdns_reflector_t* x)
+{
+	mdns_hdr_t* hdr = (mdns_hdr_t*)x->buf;
+	unsigned i;
+
+	if(hdr->qd_cnt || hdr->an_cnt) {
+		/* every interface except source one */
+		for(i = 0; i < x->ifaces; ++ i) {
+			if(i != x->iface && x->send(x->send_ctx, i, x->buf, x->len) != -1) {
+				++ x->stats.out;
+			}
+		}
+	}
+
+	mdns_reflector_start(x, ntohs(hdr->flags));
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_reflector_query_handler(void* ctx, const mdns_query_hdr_t* h, const char* root)
+{
+	mdns_reflector_t* x = ctx;
+	uint64_t key;
+
+	/* questions of responses are ignored, RFC 6762 6 */
+	if(!x->query) {
+		return;
+	}
+
+	if(!mdns_reflector_allow(x, root) && strcasecmp(root, MDNS_QUERY_SERVICE_DISCOVERY)) {
+		++ x->stats.filtered;
+		return;
+	}
+
+	key = mdns_reflector_hash(mdns_reflector_hash_name(__MDNS_REFLECT_HASH_INIT, root), &h->q_type, sizeof(h->q_type));
+
+	if(mdns_reflector_seen(x->cache, MDNS_REFLECT_CACHE, key, x->now)) {
+		++ x->stats.duplicates;
+		return;
+	}
+
+	/* unicast response bit is dropped, querier is behind reflector */
+	if(mdns_packet_add_query_in(x->buf, sizeof(x->buf), ntohs(h->q_type), root)) {
+		mdns_reflector_flush(x);
+
+		if(mdns_packet_add_query_in(x->buf, sizeof(x->buf), ntohs(h->q_type), root)) {
+			return;
+		}
+	}
+
+	/* encoded name may differ from dotted one in length */
+	x->len = mdns_packet_size(x->buf, sizeof(x->buf));
+
+	mdns_reflector_remember(x->cache, MDNS_REFLECT_CACHE, key, x->now + __MDNS_REFLECT_INTERVAL);
+	++ x->stats.forwarded;
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_reflector_record(mdns_reflector_t* x, const mdns_answer_hdr_t* h, const char* root, const void* rdata, size_t rd_len)
+{
+	mdns_answer_hdr_t* answer_hdr;
+	uint64_t key;
+	size_t pos;
+
+	/* key of record, goodbye is another record */
+	key = mdns_reflector_hash_name(__MDNS_REFLECT_HASH_INIT, root);
+	key = mdns_reflector_hash(key, &h->a_type, sizeof(h->a_type));
+	key = mdns_reflector_hash(key, rdata, rd_len);
+	key = __MDNS_REFLECT_HASH_STEP(key, !h->a_ttl);
+
+	if(mdns_reflector_seen(x->cache, MDNS_REFLECT_CACHE, key, x->now)) {
+		++ x->stats.duplicates;
+		return;
+	}
+
+	if(mdns_packet_add_answer_rdata(x->buf, sizeof(x->buf), ntohl(h->a_ttl), root, ntohs(h->a_type), rdata, rd_len)) {
+		mdns_reflector_flush(x);
+
+		if(mdns_packet_add_answer_rdata(x->buf, sizeof(x->buf), ntohl(h->a_ttl), root, ntohs(h->a_type), rdata, rd_len)) {
+			return;
+		}
+	}
+
+	/* header precedes rdata at the end of packet, cache flush bit is kept */
+	x->len = mdns_packet_size(x->buf, sizeof(x->buf));
+	pos = x->len - rd_len - sizeof(*answer_hdr);
+	answer_hdr = (mdns_answer_hdr_t*)&x->buf[pos];
+	answer_hdr->a_class = h->a_class;
+
+	mdns_reflector_remember(x->cache, MDNS_REFLECT_CACHE, key, x->now + __MDNS_REFLECT_INTERVAL);
+	++ x->stats.forwarded;
+}
+
+/*------------------------------------------------------------------------*/
+
+static int mdns_reflector_skip(mdns_reflector_t* x, const char* root)
+{
+	/* known answers are valid only on their link */
+	if(x->query) {
+		return(1);
+	}
+
+	if(!mdns_reflector_allow(x, root)) {
+		++ x->stats.filtered;
+
+		return(1);
+	}
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_reflector_answer_handler_a(void* ctx, const mdns_answer_hdr_t* h, const char* root, struct in_addr* in)
+{
+	if(!mdns_reflector_skip(ctx, root)) {
+		mdns_reflector_record(ctx, h, root, in, sizeof(*in));
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_reflector_answer_handler_aaaa(void* ctx, const mdns_answer_hdr_t* h, const char* root, struct in6_addr* in6)
+{
+	if(!mdns_reflector_skip(ctx, root)) {
+		mdns_reflector_record(ctx, h, root, in6, sizeof(*in6));
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_reflector_answer_handler_ptr(void* ctx, const mdns_answer_hdr_t* h, const char* root, const char* ptr)
+{
+	mdns_reflector_t* x = ctx;
+	uint8_t rdata[MDNS_MAX_NAME];
+	size_t len;
+
+	/* enumeration of types lists only forwarded types */
+	if(!strcasecmp(root, MDNS_QUERY_SERVICE_DISCOVERY)) {
+		if(x->query) {
+			return;
+		}
+
+		if(x->types_count && !mdns_reflector_match(x, ptr)) {
+			++ x->stats.filtered;
+			return;
+		}
+	} else if(mdns_reflector_skip(x, root)) {
+		return;
+	}
+
+	if((len = mdns_name_encode(rdata, sizeof(rdata), ptr))) {
+		mdns_reflector_record(x, h, root, rdata, len);
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_reflector_answer_handler_text(void* ctx, const mdns_answer_hdr_t* h, const char* root, const mdns_text_t* text)
+{
+	if(!mdns_reflector_skip(ctx, root)) {
+		mdns_reflector_record(ctx, h, root, text->data, text->len);
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_reflector_answer_handler_srv(void* ctx, const mdns_answer_hdr_t* h, const char* root, mdns_record_srv_t* srv, const char* target)
+{
+	mdns_reflector_t* x = ctx;
+	uint8_t rdata[sizeof(*srv) + MDNS_MAX_NAME];
+	uint64_t ttl;
+	size_t len;
+
+	if(mdns_reflector_skip(x, root)) {
+		return;
+	}
+
+	/* rdata is packed again, target was compressed in source packet */
+	memcpy(rdata, srv, sizeof(*srv));
+
+	if(!(len = mdns_name_encode(rdata + sizeof(*srv), sizeof(rdata) - sizeof(*srv), target))) {
+		return;
+	}
+
+	mdns_reflector_record(x, h, root, rdata, sizeof(*srv) + len);
+
+	/* addresses of target are forwarded while service lives */
+	if(x->types_count && h->a_ttl) {
+		ttl = ntohl(h->a_ttl) * 1000ULL;
+
+		mdns_reflector_remember(x->hosts, MDNS_REFLECT_HOSTS,
+			mdns_reflector_hash_name(__MDNS_REFLECT_HASH_INIT, target),
+			x->now + (ttl < __MDNS_REFLECT_HOST_TTL ? ttl : __MDNS_REFLECT_HOST_TTL));
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_reflector_answer_handler_raw(void* ctx, const mdns_answer_hdr_t* h, const char* root, const void* rdata, size_t len)
+{
+	mdns_reflector_t* x = ctx;
+
+	/* rdata of other types may have compressed names, like NSEC */
+	if(!x->query) {
+		++ x->stats.filtered;
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+void mdns_reflector_process(mdns_reflector_t* x, unsigned iface, const void* buf, size_t len, uint64_t now)
+{
+	const mdns_hdr_t* hdr = buf;
+	mdns_handlers_t handlers = {
+		.q = mdns_reflector_query_handler,
+		.a = mdns_reflector_answer_handler_a,
+		.aaaa = mdns_reflector_answer_handler_aaaa,
+		.ptr = mdns_reflector_answer_handler_ptr,
+		.text = mdns_reflector_answer_handler_text,
+		.srv = mdns_reflector_answer_handler_srv,
+		.raw = mdns_reflector_answer_handler_raw,
+	};
+
+	if(x->ifaces < 2 || iface >= x->ifaces || len < sizeof(*hdr)) {
+		return;
+	}
+
+	++ x->stats.in;
+
+	x->now = now;
+	x->iface = iface;
+	x->query = !(ntohs(hdr->flags) & MDNS_FLAG_ANSWER);
+
+	mdns_reflector_start(x, ntohs(hdr->flags));
+	mdns_packet_process(buf, len, &handlers, x);
+	mdns_reflector_flush(x);
+}
@@ -0,0 +1,317 @@
+/**
+ * @file registry.c
+ *
+ * yamdns -- yet another very simple mdns.
+ * Copyright (C) 2013  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+
+#include <yamdns/yamdns.h>
+
+#include "registry.h"
+#include "pool.h"
+
+/*------------------------------------------------------------------------*/
+
+int mdns_registry_listen(const char* path)
+{
+	struct sockaddr_un sa;
+	int fd;
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sun_family = AF_UNIX;
+
+	if(strlen(path) >= sizeof(sa.sun_path)) {
+		return(-1);
+	}
+
+	strcpy(sa.sun_path, path);
+
+	if((fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) == -1) {
+		return(-1);
+	}
+
+	/* remove socket of previous run */
+	unlink(path);
+
+	if(bind(fd, (struct sockaddr*)&sa, sizeof(sa)) == -1 || listen(fd, MDNS_REGISTRY_CLIENTS) == -1) {
+		close(fd);
+
+		return(-1);
+	}
+
+	return(fd);
+}
+
+/*------------------------------------------------------------------------*/
+
+static const uint8_t* mdns_registry_name(const uint8_t* pos, const uint8_t* end)
+{
+	const uint8_t* start = pos;
+
+	/* uncompressed name, RFC 1035 3.1 */
+	while(pos < end && *pos) {
+		if(*pos > 0x3f || pos + 1 + *pos >= end) {
+			return(NULL);
+		}
+
+		pos += 1 + *pos;
+	}
+
+	if(pos == end || pos + 1 - start > MDNS_MAX_NAME) {
+		return(NULL);
+	}
+
+	return(pos + 1);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int mdns_registry_check(uint16_t type, const uint8_t* rdata, size_t len)
+{
+	const uint8_t* end = rdata + len;
+
+	switch(type) {
+		case MDNS_RECORD_A:
+			return(len == sizeof(struct in_addr) ? 0 : -1);
+
+		case MDNS_RECORD_AAAA:
+			return(len == sizeof(struct in6_addr) ? 0 : -1);
+
+		case MDNS_RECORD_PTR:
+			return(mdns_registry_name(rdata, end) == end ? 0 : -1);
+
+		case MDNS_RECORD_SRV:
+			return(len > sizeof(mdns_record_srv_t) && mdns_registry_name(rdata + sizeof(mdns_record_srv_t), end) == end ? 0 : -1);
+
+		case MDNS_RECORD_TEXT:
+			/* list of strings, empty list is one empty string, RFC 6763 6.1 */
+			if(!len) {
+				return(-1);
+			}
+
+			for(; rdata < end; rdata += 1 + *rdata);
+
+			return(rdata == end ? 0 : -1);
+
+		case MDNS_RECORD_NSEC:
+		case MDNS_RECORD_ANY:
+			/* built by responder itself */
+			return(-1);
+
+		default:
+			return(0);
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+static int mdns_registry_add(mdns_responder_t* r, mdns_records_t* t, mdns_records_t* owned, const char* name, const mdns_api_op_t* op, const void* rdata)
+{
+	const mdns_record_t* rec;
+
+	if(mdns_registry_check(op->type, rdata, op->rd_len)) {
+		return(-1);
+	}
+
+	/* already registered record is only updated by its owner */
+	if(mdns_records_get(t, name, op->type, rdata, op->rd_len)) {
+		if(!mdns_records_get(owned, name, op->type, rdata, op->rd_len)) {
+			return(-1);
+		}
+
+		return(mdns_records_add(t, name, op->type, op->ttl, rdata, op->rd_len));
+	}
+
+	if(mdns_records_add(owned, name, op->type, op->ttl, rdata, op->rd_len)) {
+		return(-1);
+	}
+
+	if(mdns_records_add(t, name, op->type, op->ttl, rdata, op->rd_len)) {
+		mdns_records_remove(owned, mdns_records_get(owned, name, op->type, rdata, op->rd_len));
+
+		return(-1);
+	}
+
+	/* probe and announce */
+	if(!(rec = mdns_records_get(t, name, op->type, rdata, op->rd_len))) {
+		return(-1);
+	}
+
+	return(mdns_responder_announce(r, t, rec));
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_registry_withdraw(mdns_responder_t* r, mdns_records_t* t, mdns_records_t* owned, const mdns_record_t* own)
+{
+	const mdns_record_t* rec;
+
+	/* goodbye */
+	if((rec = mdns_records_match(t, owned, own))) {
+		mdns_responder_withdraw(r, t, rec);
+		mdns_records_remove(t, rec);
+	}
+
+	mdns_records_remove(owned, own);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int mdns_registry_remove(mdns_responder_t* r, mdns_records_t* t, mdns_records_t* owned, const char* name, const mdns_api_op_t* op, const void* rdata)
+{
+	const mdns_record_t* rec;
+	uint32_t hash;
+	int found = 0;
+
+	hash = mdns_name_hash(name);
+
+	/* removing moves records, so restart search each time */
+	rec = mdns_records_find(owned, hash, name, NULL);
+
+	while(rec) {
+		if((op->type == MDNS_RECORD_ANY || op->type == rec->type) &&
+		   (!op->rd_len || (op->rd_len == rec->rd_len && !memcmp(mdns_record_rdata(owned, rec), rdata, op->rd_len)))) {
+			mdns_registry_withdraw(r, t, owned, rec);
+			++ found;
+
+			rec = mdns_records_find(owned, hash, name, NULL);
+		} else {
+			rec = mdns_records_find(owned, hash, name, rec);
+		}
+	}
+
+	return(found ? 0 : -1);
+}
+
+/*------------------------------------------------------------------------*/
+
+void mdns_registry_drop(mdns_registry_t* g, mdns_responder_t* r, unsigned client)
+{
+	mdns_records_t* owned = &g->owned[client];
+	mdns_records_t* t = r->tables[MDNS_TABLE_API];
+
+	/* goodbyes of all records of client are packed together */
+	mdns_responder_flush(r);
+
+	while(t && owned->count) {
+		mdns_registry_withdraw(r, t, owned, &owned->recs[owned->count - 1]);
+	}
+
+	mdns_responder_flush(r);
+
+	mdns_records_free(owned);
+}
+
+/*------------------------------------------------------------------------*/
+
+void mdns_registry_free(mdns_registry_t* g)
+{
+	unsigned i;
+
+	for(i = 0; i < MDNS_REGISTRY_CLIENTS; ++ i) {
+		mdns_records_free(&g->owned[i]);
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+int mdns_registry_handle(mdns_registry_t* g, mdns_responder_t* r, unsigned client, int fd)
+{
+	static uint8_t msg[MDNS_API_MAX_MSG];
+	static uint8_t ack[sizeof(mdns_api_ack_t) + UINT16_MAX];
+	mdns_api_ack_t* a = (mdns_api_ack_t*)ack;
+	const mdns_api_hdr_t* hdr = (mdns_api_hdr_t*)msg;
+	const mdns_api_op_t* op;
+	const uint8_t *pos, *end;
+	const char* name;
+	mdns_records_t* t;
+	ssize_t len;
+	int res;
+
+	/* closed connection or error disconnects client */
+	if((len = recv(fd, msg, sizeof(msg), MSG_DONTWAIT)) <= 0) {
+		return(len && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1);
+	}
+
+	if(len < sizeof(*hdr) || hdr->version != MDNS_API_VERSION) {
+		return(-1);
+	}
+
+	/* table for registered records */
+	if(!(t = r->tables[MDNS_TABLE_API])) {
+		if(!(t = mdns_pool_alloc(MDNS_POOL_RECORDS, sizeof(*t)))) {
+			return(-1);
+		}
+
+		mdns_records_init(t);
+		r->tables[MDNS_TABLE_API] = t;
+	}
+
+	a->seq = hdr->seq;
+	a->count = 0;
+	a->failed = 0;
+
+	pos = msg + sizeof(*hdr);
+	end = msg + len;
+
+	/* all goodbyes of batch are packed together */
+	mdns_responder_flush(r);
+
+	for(; a->count < hdr->count; ++ a->count) {
+		op = (const mdns_api_op_t*)pos;
+
+		/* check for range */
+		if(pos + sizeof(*op) > end || pos + sizeof(*op) + op->name_len + op->rd_len > end) {
+			break;
+		}
+
+		name = (const char*)op->data;
+		pos += sizeof(*op) + op->name_len + op->rd_len;
+
+		/* owner name must be terminated and has last dot */
+		if(op->name_len < 2 || name[op->name_len - 1] || name[op->name_len - 2] != '.') {
+			res = -1;
+		} else if(op->op == MDNS_API_ADD) {
+			res = mdns_registry_add(r, t, &g->owned[client], name, op, op->data + op->name_len);
+		} else if(op->op == MDNS_API_REMOVE) {
+			res = mdns_registry_remove(r, t, &g->owned[client], name, op, op->data + op->name_len);
+		} else {
+			res = -1;
+		}
+
+		a->status[a->count] = res ? 1 : 0;
+
+		if(res) {
+			++ a->failed;
+		}
+	}
+
+	mdns_responder_flush(r);
+
+	if(send(fd, ack, sizeof(*a) + a->count, MSG_DONTWAIT | MSG_NOSIGNAL) == -1) {
+		return(-1);
+	}
+
+	return(0);
+}
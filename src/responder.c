@@ -0,0 +1,1832 @@
+/**
+ * @file responder.c
+ *
+ * yamdns -- yet another very simple mdns.
+ * Copyright (C) 2013  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <arpa/inet.h>
+
+#include <yamdns/yamdns.h>
+
+#include "responder.h"
+#include "pool.h"
+#include "name.h"
+
+/*------------------------------------------------------------------------*/
+
+/** number of probes, RFC 6762 8.1 */
+#define __MDNS_PROBE_COUNT 3
+
+/** interval between probes in milliseconds */
+#define __MDNS_PROBE_INTERVAL 250
+
+/** number of announcements, RFC 6762 8.3 */
+#define __MDNS_ANNOUNCE_COUNT 2
+
+/** interval between announcements in milliseconds */
+#define __MDNS_ANNOUNCE_INTERVAL 1000
+
+/** max number of names in one probe packet */
+#define __MDNS_PROBE_MAX_NAMES 256
+
+/** delay of probing after lost tie-break in milliseconds, RFC 6762 8.2 */
+#define __MDNS_PROBE_DEFER 1000
+
+/** max number of compared records of one name in tie-break */
+#define __MDNS_TIEBREAK_MAX 32
+
+/** size of NSEC type bitmap for window 0, RFC 6762 6.1 */
+#define __MDNS_NSEC_BITMAP 32
+
+/** min interval between multicasts of the same RRset in milliseconds */
+#define __MDNS_MULTICAST_INTERVAL 1000
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_responder_reset(mdns_responder_t* r)
+{
+	mdns_hdr_t* hdr = (mdns_hdr_t*)r->buf;
+
+	mdns_packet_init(r->buf, sizeof(r->buf));
+
+	/* we are authoritative for all our records */
+	hdr->flags = htons(MDNS_FLAG_AUTH);
+}
+
+/*------------------------------------------------------------------------*/
+
+void mdns_responder_flush(mdns_responder_t* r)
+{
+	/* if we have answers, send it */
+	if(mdns_packet_is_valid(r->buf, sizeof(r->buf))) {
+		r->send(r->send_ctx, r->buf, mdns_packet_size(r->buf, sizeof(r->buf)));
+		++ r->flushed;
+	}
+
+	mdns_responder_reset(r);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int mdns_record_is_unique(const mdns_records_t* t, const mdns_record_t* rec)
+{
+	/* only PTR of DNS-SD service types are shared */
+	return(rec->type != MDNS_RECORD_PTR || !mdns_services_is_type(mdns_record_name(t, rec)));
+}
+
+/*------------------------------------------------------------------------*/
+
+int mdns_responder_put(mdns_responder_t* r, const mdns_records_t* t, const mdns_record_t* rec, uint32_t ttl)
+{
+	uint64_t start = mdns_latency_clock();
+	uint16_t a_class = MDNS_CLASS_IN;
+	int res;
+
+	/* peers drop stale data of unique RRset, goodbye is only for this record */
+	if(ttl && mdns_record_is_unique(t, rec)) {
+		a_class |= MDNS_CLASS_FLUSH;
+	}
+
+	if((res = mdns_packet_add_record(r->buf, sizeof(r->buf), MDNS_SECTION_ANSWER, a_class, ttl, mdns_record_name(t, rec), rec->type, mdns_record_rdata(t, rec), rec->rd_len))) {
+		/* packet is full, send it and continue with empty packet */
+		mdns_responder_flush(r);
+
+		res = mdns_packet_add_record(r->buf, sizeof(r->buf), MDNS_SECTION_ANSWER, a_class, ttl, mdns_record_name(t, rec), rec->type, mdns_record_rdata(t, rec), rec->rd_len);
+	}
+
+	r->build_ns += mdns_latency_clock() - start;
+
+	return(res);
+}
+
+/*------------------------------------------------------------------------*/
+
+static uint32_t mdns_rrset_key(uint32_t hash, uint16_t type)
+{
+	uint32_t key = (hash ^ type) * 0x9e3779b1;
+
+	/* zero is key of empty slot */
+	return(key ? key : 1);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int mdns_responder_recent(const mdns_responder_t* r, uint32_t key)
+{
+	const mdns_recent_t* e = &r->recent[key & (MDNS_RECENT_SIZE - 1)];
+
+	/* answer of other family wasn't seen by this querier */
+	return(e->key == key && r->now < e->sent[r->family] + __MDNS_MULTICAST_INTERVAL);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_responder_multicast(mdns_responder_t* r, uint32_t key, int both)
+{
+	mdns_recent_t* e = &r->recent[key & (MDNS_RECENT_SIZE - 1)];
+	unsigned i;
+
+	if(e->key != key) {
+		e->key = key;
+
+		for(i = 0; i < MDNS_FAMILIES; ++ i) {
+			e->sent[i] = 0;
+		}
+	}
+
+	/* announcement goes to both groups */
+	for(i = 0; i < MDNS_FAMILIES; ++ i) {
+		if(both || i == r->family) {
+			e->sent[i] = r->now;
+		}
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+static int mdns_responder_limit(mdns_responder_t* r, uint32_t hash, uint16_t type)
+{
+	uint32_t key = mdns_rrset_key(hash, type);
+	unsigned i;
+
+	/* other records of RRset are put too, but RRset isn't repeated for next question */
+	for(i = 0; i < r->rrset_count && i < MDNS_CACHE_MAX_RRSETS; ++ i) {
+		if(r->rrsets[i] == key) {
+			return(i < r->question);
+		}
+	}
+
+	/* the same RRset was multicast less than second ago, RFC 6762 6 */
+	if(!r->probe && mdns_responder_recent(r, key)) {
+		++ r->limited;
+
+		return(1);
+	}
+
+	/* too many RRsets are not cached and not remembered */
+	if(r->rrset_count < MDNS_CACHE_MAX_RRSETS) {
+		r->rrsets[r->rrset_count] = key;
+	}
+
+	++ r->rrset_count;
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+/** records of job, mapped table or own copies */
+#define mdns_probe_table(p) ((p)->ref ? (p)->ref : &(p)->recs)
+
+static int mdns_probe_has(const mdns_probe_t* p, const mdns_record_t* rec)
+{
+	uint32_t i;
+
+	/* copies are removed, records of mapped table are skipped */
+	if(!p || !p->ref) {
+		return(1);
+	}
+
+	i = rec - p->ref->recs;
+
+	return(!(p->skip[i / 8] & (1 << (i % 8))));
+}
+
+/*------------------------------------------------------------------------*/
+
+static int mdns_probe_unique(const mdns_probe_t* p, const mdns_record_t* rec)
+{
+	return(mdns_probe_has(p, rec) && mdns_record_is_unique(mdns_probe_table(p), rec));
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_probe_drop(mdns_probe_t* p, const mdns_record_t* rec)
+{
+	uint32_t i;
+
+	if(!p->ref) {
+		mdns_records_remove(&p->recs, rec);
+
+		return;
+	}
+
+	i = rec - p->ref->recs;
+	p->skip[i / 8] |= 1 << (i % 8);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_probe_drop_name(mdns_probe_t* p, uint32_t hash, const char* name)
+{
+	const mdns_record_t* rec;
+
+	if(!p->ref) {
+		while((rec = mdns_records_find(&p->recs, hash, name, NULL))) {
+			mdns_records_remove(&p->recs, rec);
+		}
+
+		return;
+	}
+
+	for(rec = mdns_records_find(p->ref, hash, name, NULL); rec; rec = mdns_records_find(p->ref, hash, name, rec)) {
+		mdns_probe_drop(p, rec);
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+static int mdns_responder_probing(const mdns_responder_t* r, uint32_t hash, const char* name)
+{
+	const mdns_record_t* rec;
+	const mdns_probe_t* p;
+
+	for(p = r->probes; p; p = p->next) {
+		if(p->step >= __MDNS_PROBE_COUNT) {
+			continue;
+		}
+
+		for(rec = mdns_records_find(mdns_probe_table(p), hash, name, NULL); rec; rec = mdns_records_find(mdns_probe_table(p), hash, name, rec)) {
+			if(mdns_probe_unique(p, rec)) {
+				return(1);
+			}
+		}
+	}
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int mdns_responder_filter(void* ctx, uint32_t hash, const void* buf, size_t len, const void* pos)
+{
+	mdns_responder_t* r = ctx;
+	char name[MDNS_MAX_NAME];
+	int i;
+
+	for(i = 0; i < MDNS_TABLE_MAX; ++ i) {
+		if(r->tables[i] && mdns_records_has_hash(r->tables[i], hash)) {
+			return(1);
+		}
+	}
+
+	/* service discovery meta-query */
+	if(mdns_services_has_hash(&r->services, hash)) {
+		return(1);
+	}
+
+	/* records of designated hosts */
+	if(mdns_proxy_has_hash(&r->proxy, hash)) {
+		return(1);
+	}
+
+	/* reverse names are not hashed, address is parsed from name */
+	return(r->reverse.count && mdns_packet_name(buf, len, pos, name, sizeof(name)) &&
+	       mdns_reverse_lookup(&r->reverse, name));
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_responder_put_type(mdns_responder_t* r, const mdns_service_type_t* st)
+{
+	uint64_t start = mdns_latency_clock();
+	const mdns_service_rr_t* rr;
+
+	for(rr = (const mdns_service_rr_t*)st->answers; (const uint8_t*)rr < st->answers + st->len; rr = mdns_service_rr_next(rr)) {
+		if(!mdns_packet_add_answer_encoded(r->buf, sizeof(r->buf), mdns_service_rr_data(rr), rr->len)) {
+			continue;
+		}
+
+		/* packet is full, send it and continue with empty packet */
+		mdns_responder_flush(r);
+		mdns_packet_add_answer_encoded(r->buf, sizeof(r->buf), mdns_service_rr_data(rr), rr->len);
+	}
+
+	r->build_ns += mdns_latency_clock() - start;
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_responder_put_reverse(mdns_responder_t* r, const char* root, const mdns_reverse_range_t* range)
+{
+	uint64_t start = mdns_latency_clock();
+
+	/* reverse name has the only target */
+	if(mdns_packet_add_record(r->buf, sizeof(r->buf), MDNS_SECTION_ANSWER, MDNS_CLASS_IN | MDNS_CLASS_FLUSH, range->ttl, root, MDNS_RECORD_PTR, range->target, range->target_len)) {
+		/* packet is full, send it and continue with empty packet */
+		mdns_responder_flush(r);
+		mdns_packet_add_record(r->buf, sizeof(r->buf), MDNS_SECTION_ANSWER, MDNS_CLASS_IN | MDNS_CLASS_FLUSH, range->ttl, root, MDNS_RECORD_PTR, range->target, range->target_len);
+	}
+
+	r->build_ns += mdns_latency_clock() - start;
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_responder_put_proxy(mdns_responder_t* r, uint16_t type, uint32_t hash, const char* root)
+{
+	const mdns_record_t* rec;
+	mdns_proxy_owner_t* o;
+	unsigned i;
+
+	for(i = 0; i < r->proxy.count; ++ i) {
+		o = &r->proxy.owners[i];
+
+		if(!(rec = mdns_records_find(&o->recs, hash, root, NULL))) {
+			continue;
+		}
+
+		/* host is given a chance to answer by itself */
+		if(!o->asleep) {
+			if(!o->asked) {
+				o->asked = r->now;
+			}
+
+			continue;
+		}
+
+		for(; rec; rec = mdns_records_find(&o->recs, hash, root, rec)) {
+			if((type == MDNS_RECORD_ANY || type == rec->type) && !mdns_responder_limit(r, hash, rec->type)) {
+				mdns_responder_put(r, &o->recs, rec, mdns_proxy_ttl(rec, r->now));
+			}
+		}
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_responder_query(mdns_responder_t* r, const mdns_query_hdr_t* h, const char* root)
+{
+	const mdns_reverse_range_t* range;
+	const mdns_service_type_t* st;
+	const mdns_record_t* rec;
+	const mdns_records_t* t;
+	const char* unique = NULL;
+	uint16_t type;
+	uint32_t hash;
+	unsigned n;
+	int i;
+
+	type = ntohs(h->q_type);
+	hash = mdns_name_hash(root);
+	r->question = r->rrset_count;
+
+	/* name is not ours yet or was lost */
+	if(mdns_records_find(&r->conflicts, hash, root, NULL) || mdns_responder_probing(r, hash, root)) {
+		return;
+	}
+
+	/* addresses of ranges */
+	if((type == MDNS_RECORD_ANY || type == MDNS_RECORD_PTR) && (range = mdns_reverse_lookup(&r->reverse, root)) &&
+	   !mdns_responder_limit(r, hash, MDNS_RECORD_PTR)) {
+		mdns_responder_put_reverse(r, root, range);
+	}
+
+	/* browsing is answered by prebuilt answers of service type */
+	if((type == MDNS_RECORD_ANY || type == MDNS_RECORD_PTR) && (st = mdns_services_find(&r->services, hash, root))) {
+		if(r->shed) {
+			++ r->overload.stats.shed_browse;
+		} else if(!mdns_responder_limit(r, hash, MDNS_RECORD_PTR)) {
+			mdns_responder_put_type(r, st);
+		}
+	}
+
+	for(i = 0; i < MDNS_TABLE_MAX; ++ i) {
+		if(!(t = r->tables[i])) {
+			continue;
+		}
+
+		for(rec = mdns_records_find(t, hash, root, NULL); rec; rec = mdns_records_find(t, hash, root, rec)) {
+			/* PTR of service types are in index */
+			if(rec->type == MDNS_RECORD_PTR && mdns_services_is_type(root)) {
+				continue;
+			}
+
+			if((type == MDNS_RECORD_ANY || type == rec->type) && !mdns_responder_limit(r, hash, rec->type)) {
+				mdns_responder_put(r, t, rec, rec->ttl);
+			}
+
+			if(mdns_record_is_unique(t, rec)) {
+				unique = mdns_record_name(t, rec);
+			}
+		}
+	}
+
+	/* on behalf of sleeping hosts */
+	if(r->proxy.count) {
+		mdns_responder_put_proxy(r, type, hash, root);
+	}
+
+	/* only owner of unique records can assert nonexistence of other types */
+	if(!unique || r->nsec_count == MDNS_NSEC_MAX) {
+		return;
+	}
+
+	for(n = 0; n < r->nsec_count; ++ n) {
+		if(!mdns_name_casecmp(r->nsec[n], unique)) {
+			return;
+		}
+	}
+
+	r->nsec[r->nsec_count ++] = unique;
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_responder_query_handler(void* ctx, const mdns_query_hdr_t* h, const char* root)
+{
+	mdns_responder_t* r = ctx;
+	uint64_t start = mdns_latency_clock();
+
+	mdns_responder_query(r, h, root);
+
+	/* building of answers is included, it is subtracted later */
+	r->lookup_ns += mdns_latency_clock() - start;
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_responder_nsec(mdns_responder_t* r, const char* name)
+{
+	uint8_t rdata[MDNS_MAX_NAME + 2 + __MDNS_NSEC_BITMAP];
+	uint8_t* bitmap;
+	const mdns_record_t* rec;
+	const mdns_records_t* t;
+	uint32_t hash, ttl = UINT32_MAX;
+	size_t len, bitmap_len = 0;
+	int i;
+
+	/* next domain name is the owner itself, RFC 6762 6.1 */
+	if(!(len = mdns_name_encode(rdata, MDNS_MAX_NAME, name))) {
+		return;
+	}
+
+	bitmap = &rdata[len + 2];
+	memset(bitmap, 0, __MDNS_NSEC_BITMAP);
+
+	hash = mdns_name_hash(name);
+
+	for(i = 0; i < MDNS_TABLE_MAX; ++ i) {
+		if(!(t = r->tables[i])) {
+			continue;
+		}
+
+		for(rec = mdns_records_find(t, hash, name, NULL); rec; rec = mdns_records_find(t, hash, name, rec)) {
+			/* only window 0 is used in mDNS */
+			if(rec->type >= __MDNS_NSEC_BITMAP * 8) {
+				continue;
+			}
+
+			bitmap[rec->type / 8] |= 0x80 >> (rec->type % 8);
+
+			if(rec->type / 8 + 1 > bitmap_len) {
+				bitmap_len = rec->type / 8 + 1;
+			}
+
+			if(mdns_record_is_unique(t, rec) && rec->ttl < ttl) {
+				ttl = rec->ttl;
+			}
+		}
+	}
+
+	if(!bitmap_len) {
+		return;
+	}
+
+	rdata[len] = 0;
+	rdata[len + 1] = bitmap_len;
+	len += 2 + bitmap_len;
+
+	/* NSEC is unique as well, RFC 6762 6.1 */
+	if(!mdns_packet_add_record(r->buf, sizeof(r->buf), MDNS_SECTION_ADDITIONAL, MDNS_CLASS_IN | MDNS_CLASS_FLUSH, ttl, name, MDNS_RECORD_NSEC, rdata, len)) {
+		return;
+	}
+
+	/* packet is full, send it and continue with empty packet */
+	mdns_responder_flush(r);
+	mdns_packet_add_record(r->buf, sizeof(r->buf), MDNS_SECTION_ADDITIONAL, MDNS_CLASS_IN | MDNS_CLASS_FLUSH, ttl, name, MDNS_RECORD_NSEC, rdata, len);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int mdns_record_points(const mdns_records_t* t, const mdns_record_t* rec, const uint8_t* wire, size_t len)
+{
+	/* PTR of service type to instance */
+	return(rec->type == MDNS_RECORD_PTR && rec->rd_len == len && !mdns_record_is_unique(t, rec) &&
+	       mdns_name_caseeq(mdns_record_rdata(t, rec), wire, len));
+}
+
+/*------------------------------------------------------------------------*/
+
+static int mdns_probe_pending(const mdns_probe_t* p, const mdns_records_t* t, const mdns_record_t* rec)
+{
+	const mdns_record_t* queued;
+
+	/* records are indexed at the end of probing */
+	return(p->step <= __MDNS_PROBE_COUNT && (queued = mdns_records_match(mdns_probe_table(p), t, rec)) && mdns_probe_has(p, queued));
+}
+
+/*------------------------------------------------------------------------*/
+
+static int mdns_responder_pending(const mdns_responder_t* r, const mdns_records_t* t, const mdns_record_t* rec)
+{
+	const mdns_probe_t* p;
+
+	for(p = r->probes; p; p = p->next) {
+		if(mdns_probe_pending(p, t, rec)) {
+			return(1);
+		}
+	}
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int mdns_responder_lost(const mdns_responder_t* r, const mdns_records_t* t, const mdns_record_t* rec)
+{
+	char target[MDNS_MAX_NAME];
+
+	/* instance of PTR was withdrawn by conflict */
+	return(mdns_packet_name(mdns_record_rdata(t, rec), rec->rd_len, mdns_record_rdata(t, rec), target, sizeof(target)) &&
+	       mdns_records_find(&r->conflicts, mdns_name_hash(target), target, NULL));
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_responder_index(mdns_responder_t* r, const mdns_probe_t* p)
+{
+	const mdns_records_t* t = mdns_probe_table(p);
+	const mdns_record_t* rec;
+	uint32_t i;
+
+	for(i = 0, rec = t->recs; i < t->count; ++ i, ++ rec) {
+		if(!mdns_probe_has(p, rec) || mdns_record_is_unique(t, rec) || mdns_responder_lost(r, t, rec)) {
+			continue;
+		}
+
+		if(mdns_services_add(&r->services, mdns_record_name(t, rec), rec->ttl, mdns_record_rdata(t, rec), rec->rd_len)) {
+			syslog(LOG_ERR, "service %s is not browsable, out of memory", mdns_record_name(t, rec));
+		}
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_responder_conflict(mdns_responder_t* r, uint32_t hash, const char* name)
+{
+	uint8_t wire[MDNS_MAX_NAME];
+	const mdns_record_t* rec;
+	const mdns_records_t* t;
+	mdns_probe_t* p;
+	size_t len;
+	uint32_t j;
+	int i;
+
+	if(mdns_records_find(&r->conflicts, hash, name, NULL)) {
+		return;
+	}
+
+	syslog(LOG_WARNING, "name %s is already in use, withdrawn", name);
+
+	len = mdns_name_wire(wire, sizeof(wire), name);
+
+	/* browsing doesn't offer instance anymore */
+	for(i = 0; len && i < MDNS_TABLE_MAX; ++ i) {
+		if(!(t = r->tables[i])) {
+			continue;
+		}
+
+		for(j = 0, rec = t->recs; j < t->count; ++ j, ++ rec) {
+			if(mdns_record_points(t, rec, wire, len) && !mdns_responder_pending(r, t, rec)) {
+				mdns_services_remove(&r->services, mdns_record_name(t, rec), mdns_record_rdata(t, rec), rec->rd_len);
+			}
+		}
+	}
+
+	mdns_records_add(&r->conflicts, name, 0, 0, "", 0);
+	mdns_responder_invalidate(r);
+
+	/* drop all records of name and pointers to it from probing and announcing */
+	for(p = r->probes; p; p = p->next) {
+		mdns_probe_drop_name(p, hash, name);
+
+		for(t = mdns_probe_table(p), j = t->count; len && j > 0; -- j) {
+			if(mdns_probe_has(p, &t->recs[j - 1]) && mdns_record_points(t, &t->recs[j - 1], wire, len)) {
+				mdns_probe_drop(p, &t->recs[j - 1]);
+			}
+		}
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+static const void* mdns_responder_rdata(const mdns_responder_t* r, uint16_t type, const void* rdata, size_t* len, uint8_t* buf, size_t size)
+{
+	char target[MDNS_MAX_NAME];
+	size_t off, n;
+
+	/* names in rdata can be compressed, they are compared unpacked */
+	switch(type) {
+		case MDNS_RECORD_PTR:
+			off = 0;
+			break;
+
+		case MDNS_RECORD_SRV:
+			off = sizeof(mdns_record_srv_t);
+			break;
+
+		default:
+			return(rdata);
+	}
+
+	if(*len <= off || !mdns_packet_name(r->packet, r->packet_len, (const uint8_t*)rdata + off, target, sizeof(target)) ||
+	   !(n = mdns_name_wire(buf + off, size - off, target))) {
+		return(NULL);
+	}
+
+	memcpy(buf, rdata, off);
+	*len = off + n;
+
+	return(buf);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int mdns_records_differ(const mdns_records_t* t, const mdns_probe_t* p, uint32_t hash, const char* name, uint16_t type, const void* rdata, size_t len)
+{
+	const mdns_record_t* rec;
+	int differ = 0;
+
+	/* -1 for our record, 1 if we have only another data of the same type */
+	for(rec = mdns_records_find(t, hash, name, NULL); rec; rec = mdns_records_find(t, hash, name, rec)) {
+		if(rec->type != type || !mdns_probe_has(p, rec) || !mdns_record_is_unique(t, rec)) {
+			continue;
+		}
+
+		if(rec->rd_len == len && !memcmp(mdns_record_rdata(t, rec), rdata, len)) {
+			return(-1);
+		}
+
+		differ = 1;
+	}
+
+	return(differ);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int mdns_responder_owns(const mdns_responder_t* r, uint32_t hash)
+{
+	const mdns_probe_t* p;
+	int i;
+
+	for(i = 0; i < MDNS_TABLE_MAX; ++ i) {
+		if(r->tables[i] && mdns_records_has_hash(r->tables[i], hash)) {
+			return(1);
+		}
+	}
+
+	for(p = r->probes; p; p = p->next) {
+		if(mdns_records_has_hash(mdns_probe_table(p), hash)) {
+			return(1);
+		}
+	}
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_responder_reprobe(mdns_responder_t* r, uint32_t hash, const char* name)
+{
+	const mdns_record_t* rec;
+	const mdns_records_t* t;
+	mdns_probe_t* p;
+	int i;
+
+	syslog(LOG_WARNING, "name %s is claimed by another host, probing again", name);
+
+	/* announcing of name is stopped */
+	for(p = r->probes; p; p = p->next) {
+		mdns_probe_drop_name(p, hash, name);
+	}
+
+	for(i = 0; i < MDNS_TABLE_MAX; ++ i) {
+		if(!(t = r->tables[i])) {
+			continue;
+		}
+
+		for(rec = mdns_records_find(t, hash, name, NULL); rec; rec = mdns_records_find(t, hash, name, rec)) {
+			if(mdns_record_is_unique(t, rec) && mdns_responder_announce(r, t, rec)) {
+				syslog(LOG_ERR, "name %s is not probed, out of memory", name);
+			}
+		}
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_responder_record_handler(void* ctx, const mdns_answer_hdr_t* h, const char* root, const void* rdata, size_t len)
+{
+	mdns_responder_t* r = ctx;
+	const mdns_hdr_t* hdr = r->packet;
+	uint8_t buf[sizeof(mdns_record_srv_t) + MDNS_MAX_NAME];
+	int i, differ, probed = 0, owned = 0;
+	mdns_probe_t* p;
+	unsigned index;
+	uint16_t type;
+	uint32_t hash;
+
+	index = r->packet_rr ++;
+	type = ntohs(h->a_type);
+	hash = mdns_name_hash(root);
+
+	if((ntohs(h->a_class) & ~MDNS_CLASS_FLUSH) != MDNS_CLASS_IN || !mdns_responder_owns(r, hash) ||
+	   !(rdata = mdns_responder_rdata(r, type, rdata, &len, buf, sizeof(buf)))) {
+		return;
+	}
+
+	/* authority section of probe is compared after whole packet, RFC 6762 8.2 */
+	if(!(ntohs(hdr->flags) & MDNS_FLAG_ANSWER)) {
+		if(index >= ntohs(hdr->an_cnt) && index < ntohs(hdr->an_cnt) + ntohs(hdr->ns_cnt) &&
+		   mdns_responder_probing(r, hash, root)) {
+			mdns_records_add(&r->peer, root, type, ntohl(h->a_ttl), rdata, len);
+		}
+
+		return;
+	}
+
+	/* somebody else answers with another data for name we are probing */
+	for(p = r->probes; p; p = p->next) {
+		if(p->step < __MDNS_PROBE_COUNT && (differ = mdns_records_differ(mdns_probe_table(p), p, hash, root, type, rdata, len))) {
+			if(differ < 0) {
+				return;
+			}
+
+			probed = 1;
+		}
+	}
+
+	/* the same data in any table is our own response */
+	for(i = 0; i < MDNS_TABLE_MAX; ++ i) {
+		if(r->tables[i] && (differ = mdns_records_differ(r->tables[i], NULL, hash, root, type, rdata, len))) {
+			if(differ < 0) {
+				return;
+			}
+
+			owned = 1;
+		}
+	}
+
+	if(probed) {
+		mdns_responder_conflict(r, hash, root);
+	} else if(owned && !mdns_responder_probing(r, hash, root) && !mdns_records_find(&r->conflicts, hash, root, NULL)) {
+		/* announced names are defended by probing again, RFC 6762 9 */
+		mdns_responder_reprobe(r, hash, root);
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+static int mdns_record_cmp(const mdns_records_t* a, const mdns_record_t* ra, const mdns_records_t* b, const mdns_record_t* rb)
+{
+	int cmp;
+
+	/* class is always IN, so type and rdata are compared */
+	if(ra->type != rb->type) {
+		return(ra->type < rb->type ? -1 : 1);
+	}
+
+	if((cmp = memcmp(mdns_record_rdata(a, ra), mdns_record_rdata(b, rb), ra->rd_len < rb->rd_len ? ra->rd_len : rb->rd_len))) {
+		return(cmp);
+	}
+
+	return((int)ra->rd_len - (int)rb->rd_len);
+}
+
+/*------------------------------------------------------------------------*/
+
+static unsigned mdns_records_sorted(const mdns_records_t* t, const mdns_probe_t* p, uint32_t hash, const char* name, const mdns_record_t** sorted)
+{
+	const mdns_record_t* rec;
+	unsigned n = 0, i;
+
+	/* insertion sort of few records of name */
+	for(rec = mdns_records_find(t, hash, name, NULL); rec && n < __MDNS_TIEBREAK_MAX; rec = mdns_records_find(t, hash, name, rec)) {
+		if(!mdns_probe_has(p, rec) || !mdns_record_is_unique(t, rec)) {
+			continue;
+		}
+
+		for(i = n ++; i > 0 && mdns_record_cmp(t, sorted[i - 1], t, rec) > 0; -- i) {
+			sorted[i] = sorted[i - 1];
+		}
+
+		sorted[i] = rec;
+	}
+
+	return(n);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int mdns_responder_tiebreak(const mdns_responder_t* r, const mdns_probe_t* p, uint32_t hash, const char* name)
+{
+	const mdns_records_t* t = mdns_probe_table(p);
+	const mdns_record_t *ours[__MDNS_TIEBREAK_MAX], *theirs[__MDNS_TIEBREAK_MAX];
+	unsigned n, m, i;
+	int cmp;
+
+	n = mdns_records_sorted(t, p, hash, name, ours);
+	m = mdns_records_sorted(&r->peer, NULL, hash, name, theirs);
+
+	/* lexicographically later data wins, the same data is our own probe */
+	for(i = 0; i < n && i < m; ++ i) {
+		if((cmp = mdns_record_cmp(t, ours[i], &r->peer, theirs[i]))) {
+			return(cmp);
+		}
+	}
+
+	return((int)n - (int)m);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_responder_simultaneous(mdns_responder_t* r)
+{
+	const mdns_record_t* rec;
+	const mdns_records_t* t;
+	mdns_probe_t* p;
+	uint32_t i;
+
+	for(p = r->probes; p; p = p->next) {
+		if(p->step >= __MDNS_PROBE_COUNT) {
+			continue;
+		}
+
+		for(i = 0, t = mdns_probe_table(p); i < t->count; ++ i) {
+			rec = &t->recs[i];
+
+			if(!mdns_probe_unique(p, rec) || !mdns_records_has_hash(&r->peer, rec->hash) ||
+			   mdns_responder_tiebreak(r, p, rec->hash, mdns_record_name(t, rec)) >= 0) {
+				continue;
+			}
+
+			/* lost, probing starts again after a second */
+			syslog(LOG_INFO, "name %s is probed by another host, deferred", mdns_record_name(t, rec));
+
+			p->step = 0;
+			p->deadline = r->now + __MDNS_PROBE_DEFER;
+
+			break;
+		}
+	}
+
+	mdns_records_free(&r->peer);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_probe_free(mdns_probe_t* p)
+{
+	mdns_records_free(&p->recs);
+	mdns_pool_free(p->skip);
+	mdns_pool_free(p);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int mdns_responder_probe_records(mdns_responder_t* r, const mdns_probe_t* p, const mdns_record_t** rec)
+{
+	const mdns_records_t* t = mdns_probe_table(p);
+	const char* name = mdns_record_name(t, *rec);
+
+	/* proposed records of name go to authority section */
+	for(; *rec; *rec = mdns_records_find(t, (*rec)->hash, name, *rec)) {
+		if(mdns_probe_unique(p, *rec) &&
+		   mdns_packet_add_authority_rdata(r->buf, sizeof(r->buf), (*rec)->ttl, name, (*rec)->type, mdns_record_rdata(t, *rec), (*rec)->rd_len)) {
+			return(-1);
+		}
+	}
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_responder_probe_split(mdns_responder_t* r, const mdns_probe_t* p, const mdns_record_t* first)
+{
+	const mdns_records_t* t = mdns_probe_table(p);
+	const mdns_record_t *rec, *start;
+
+	/* records of one name exceed packet, each part repeats question */
+	for(rec = first; rec;) {
+		start = rec;
+
+		mdns_packet_init(r->buf, sizeof(r->buf));
+
+		if(mdns_packet_add_query_in(r->buf, sizeof(r->buf), MDNS_RECORD_ANY, mdns_record_name(t, first))) {
+			break;
+		}
+
+		if(mdns_responder_probe_records(r, p, &rec) && rec == start) {
+			/* record alone doesn't fit, it can't be probed */
+			rec = mdns_records_find(t, rec->hash, mdns_record_name(t, rec), rec);
+		}
+
+		if(((const mdns_hdr_t*)r->buf)->ns_cnt) {
+			r->send(r->send_ctx, r->buf, mdns_packet_size(r->buf, sizeof(r->buf)));
+		}
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_responder_probe_send(mdns_responder_t* r, const mdns_probe_t* p, const mdns_record_t** names, size_t n)
+{
+	const mdns_records_t* t = mdns_probe_table(p);
+	const mdns_record_t* rec;
+	size_t i, j, k;
+
+	for(i = 0; i < n; i = j) {
+		j = n;
+
+		/* questions precede authority, so packet is built again with fewer names */
+		do {
+			/* probe is a query */
+			mdns_packet_init(r->buf, sizeof(r->buf));
+
+			for(k = i; k < j && !mdns_packet_add_query_in(r->buf, sizeof(r->buf), MDNS_RECORD_ANY, mdns_record_name(t, names[k])); ++ k);
+
+			if(k == i) {
+				break;
+			}
+
+			/* with proposed records in authority section */
+			for(j = k, k = i; k < j; ++ k) {
+				rec = names[k];
+
+				if(mdns_responder_probe_records(r, p, &rec)) {
+					break;
+				}
+			}
+		} while(k < j && (j = k) > i);
+
+		if(k == i) {
+			mdns_responder_probe_split(r, p, names[i]);
+			j = i + 1;
+
+			continue;
+		}
+
+		r->send(r->send_ctx, r->buf, mdns_packet_size(r->buf, sizeof(r->buf)));
+	}
+
+	mdns_responder_reset(r);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int mdns_responder_probe(mdns_responder_t* r, mdns_probe_t* p)
+{
+	const mdns_record_t* names[__MDNS_PROBE_MAX_NAMES];
+	const mdns_record_t *rec, *first;
+	const mdns_records_t* t;
+	size_t size, n, need;
+	const char* name;
+	uint32_t i;
+
+	t = mdns_probe_table(p);
+	size = sizeof(mdns_hdr_t);
+	n = 0;
+
+	/* pack as many names as possible into each probe */
+	for(i = 0; i < t->count; ++ i) {
+		rec = &t->recs[i];
+		name = mdns_record_name(t, rec);
+
+		if(!mdns_probe_unique(p, rec)) {
+			continue;
+		}
+
+		/* each name is probed once, by its first record */
+		first = mdns_records_find(t, rec->hash, name, NULL);
+
+		while(first && !mdns_probe_unique(p, first)) {
+			first = mdns_records_find(t, rec->hash, name, first);
+		}
+
+		if(first != rec) {
+			continue;
+		}
+
+		/* question and proposed records of name */
+		need = strlen(name) + 1 + sizeof(mdns_query_hdr_t);
+
+		for(; first; first = mdns_records_find(t, rec->hash, name, first)) {
+			if(mdns_probe_unique(p, first)) {
+				need += strlen(name) + 1 + sizeof(mdns_answer_hdr_t) + first->rd_len;
+			}
+		}
+
+		if(n && (size + need > MDNS_MAX_PACKET || n == __MDNS_PROBE_MAX_NAMES)) {
+			mdns_responder_probe_send(r, p, names, n);
+
+			size = sizeof(mdns_hdr_t);
+			n = 0;
+		}
+
+		names[n ++] = rec;
+		size += need;
+	}
+
+	if(n) {
+		mdns_responder_probe_send(r, p, names, n);
+	}
+
+	return(n != 0);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_responder_step(mdns_responder_t* r, mdns_probe_t* p)
+{
+	const mdns_records_t* t = mdns_probe_table(p);
+	const mdns_record_t* rec;
+	uint32_t i;
+
+	if(p->step < __MDNS_PROBE_COUNT) {
+		/* nothing to probe, announce at once */
+		if(!mdns_responder_probe(r, p)) {
+			p->step = __MDNS_PROBE_COUNT;
+
+			mdns_responder_step(r, p);
+
+			return;
+		}
+
+		p->deadline = r->now + __MDNS_PROBE_INTERVAL;
+	} else {
+		/* probed names are answered and browsed from now */
+		if(p->step == __MDNS_PROBE_COUNT) {
+			mdns_responder_index(r, p);
+			mdns_responder_invalidate(r);
+		}
+
+		mdns_responder_flush(r);
+
+		for(i = 0, rec = t->recs; i < t->count; ++ i, ++ rec) {
+			if(mdns_probe_has(p, rec)) {
+				mdns_responder_put(r, t, rec, rec->ttl);
+				mdns_responder_multicast(r, mdns_rrset_key(rec->hash, rec->type), 1);
+			}
+		}
+
+		mdns_responder_flush(r);
+
+		p->deadline = r->now + __MDNS_ANNOUNCE_INTERVAL;
+	}
+
+	++ p->step;
+}
+
+/*------------------------------------------------------------------------*/
+
+void mdns_responder_init(mdns_responder_t* r, mdns_send_handler send, void* ctx)
+{
+	memset(r, 0, sizeof(*r));
+
+	r->send = send;
+	r->send_ctx = ctx;
+
+	mdns_records_init(&r->conflicts);
+	mdns_records_init(&r->peer);
+	mdns_services_init(&r->services);
+	mdns_reverse_init(&r->reverse);
+	mdns_proxy_init(&r->proxy);
+	mdns_overload_init(&r->overload);
+
+	/* zeroed cache entries are stale */
+	r->gen = 1;
+
+	mdns_responder_reset(r);
+}
+
+/*------------------------------------------------------------------------*/
+
+void mdns_responder_free(mdns_responder_t* r)
+{
+	mdns_probe_t* p;
+	int i;
+
+	for(i = 0; i < MDNS_TABLE_MAX; ++ i) {
+		if(r->tables[i]) {
+			mdns_records_free(r->tables[i]);
+			mdns_pool_free(r->tables[i]);
+			r->tables[i] = NULL;
+		}
+	}
+
+	while((p = r->probes)) {
+		r->probes = p->next;
+		mdns_probe_free(p);
+	}
+
+	mdns_records_free(&r->conflicts);
+	mdns_records_free(&r->peer);
+	mdns_services_free(&r->services);
+	mdns_reverse_free(&r->reverse);
+	mdns_proxy_free(&r->proxy);
+}
+
+/*------------------------------------------------------------------------*/
+
+void mdns_responder_snoop(mdns_responder_t* r, const struct in_addr* from, const void* buf, size_t len)
+{
+	if(r->proxy.count && mdns_proxy_snoop(&r->proxy, from, buf, len, r->now)) {
+		mdns_responder_invalidate(r);
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+void mdns_responder_admit(mdns_responder_t* r, const void* addr, size_t addr_len, const void* buf, size_t len)
+{
+	const mdns_hdr_t* hdr = buf;
+
+	/* only queries are paid */
+	if(len >= sizeof(*hdr) && !(ntohs(hdr->flags) & MDNS_FLAG_ANSWER)) {
+		r->shed = mdns_overload_admit(&r->overload, addr, addr_len, r->now);
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+void mdns_responder_stamp(mdns_responder_t* r, const struct timespec* stamp)
+{
+	r->stamp = *stamp;
+}
+
+/*------------------------------------------------------------------------*/
+
+void mdns_responder_family(mdns_responder_t* r, int family)
+{
+	r->family = family == AF_INET6;
+}
+
+/*------------------------------------------------------------------------*/
+
+int mdns_responder_host(mdns_records_t* t, const char* host, struct in_addr in)
+{
+	char addr_name[MDNS_MAX_NAME];
+	uint8_t rdata[MDNS_MAX_NAME];
+	size_t len;
+
+	/* host name resolves to address */
+	if(mdns_records_add(t, host, MDNS_RECORD_A, 60, &in, sizeof(in))) {
+		return(-1);
+	}
+
+	/* and reverse */
+	if(mdns_format_address_name(addr_name, sizeof(addr_name), in) ||
+	   !(len = mdns_name_encode(rdata, sizeof(rdata), host))) {
+		return(-1);
+	}
+
+	return(mdns_records_add(t, addr_name, MDNS_RECORD_PTR, 60, rdata, len));
+}
+
+/*------------------------------------------------------------------------*/
+
+int mdns_responder_host6(mdns_records_t* t, const char* host, const struct in6_addr* in6)
+{
+	char addr_name[MDNS_MAX_NAME];
+	uint8_t rdata[MDNS_MAX_NAME];
+	size_t len;
+
+	/* host name resolves to address */
+	if(mdns_records_add(t, host, MDNS_RECORD_AAAA, 60, in6, sizeof(*in6))) {
+		return(-1);
+	}
+
+	/* and reverse */
+	if(mdns_format_address6_name(addr_name, sizeof(addr_name), in6) ||
+	   !(len = mdns_name_encode(rdata, sizeof(rdata), host))) {
+		return(-1);
+	}
+
+	return(mdns_records_add(t, addr_name, MDNS_RECORD_PTR, 60, rdata, len));
+}
+
+/*------------------------------------------------------------------------*/
+
+static mdns_probe_t* mdns_responder_queue(mdns_responder_t* r)
+{
+	mdns_probe_t *p, **last;
+
+	if(!(p = mdns_pool_alloc(MDNS_POOL_PROBES, sizeof(*p)))) {
+		return(NULL);
+	}
+
+	mdns_records_init(&p->recs);
+	p->ref = NULL;
+	p->skip = NULL;
+	p->step = 0;
+	p->next = NULL;
+
+	/* random delay before first probe, RFC 6762 8.1 */
+	p->deadline = r->now + rand() % __MDNS_PROBE_INTERVAL;
+
+	for(last = &r->probes; *last; last = &(*last)->next);
+
+	*last = p;
+
+	return(p);
+}
+
+/*------------------------------------------------------------------------*/
+
+int mdns_responder_announce(mdns_responder_t* r, const mdns_records_t* t, const mdns_record_t* rec)
+{
+	mdns_probe_t* p;
+
+	/* find tail of queue */
+	for(p = r->probes; p && p->next; p = p->next);
+
+	/* join to the last job, if it has not started yet and has copies */
+	if((!p || p->step || p->ref) && !(p = mdns_responder_queue(r))) {
+		return(-1);
+	}
+
+	mdns_responder_invalidate(r);
+
+	/* pointers of service types are indexed after probing */
+	return(mdns_records_add(&p->recs, mdns_record_name(t, rec), rec->type, rec->ttl, mdns_record_rdata(t, rec), rec->rd_len));
+}
+
+/*------------------------------------------------------------------------*/
+
+void mdns_responder_withdraw(mdns_responder_t* r, const mdns_records_t* t, const mdns_record_t* rec)
+{
+	const mdns_record_t* queued;
+	mdns_probe_t* p;
+
+	mdns_responder_put(r, t, rec, 0);
+	mdns_responder_invalidate(r);
+
+	/* only pointers, which have passed probing, are in index */
+	if(!mdns_record_is_unique(t, rec) && !mdns_responder_pending(r, t, rec) && !mdns_responder_lost(r, t, rec)) {
+		mdns_services_remove(&r->services, mdns_record_name(t, rec), mdns_record_rdata(t, rec), rec->rd_len);
+	}
+
+	/* don't announce it anymore */
+	for(p = r->probes; p; p = p->next) {
+		if((queued = mdns_records_match(mdns_probe_table(p), t, rec)) && mdns_probe_has(p, queued)) {
+			mdns_probe_drop(p, queued);
+		}
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+static int mdns_responder_announced(const mdns_responder_t* r, const mdns_records_t* t, const mdns_record_t* rec)
+{
+	const mdns_record_t* same;
+	const mdns_probe_t* p;
+
+	/* lost name belongs to another host */
+	if(mdns_records_find(&r->conflicts, rec->hash, mdns_record_name(t, rec), NULL)) {
+		return(0);
+	}
+
+	/* record of job is announced after the last probe */
+	for(p = r->probes; p; p = p->next) {
+		if(p->step > __MDNS_PROBE_COUNT) {
+			continue;
+		}
+
+		if((same = mdns_records_match(mdns_probe_table(p), t, rec)) && mdns_probe_has(p, same)) {
+			return(0);
+		}
+	}
+
+	return(1);
+}
+
+/*------------------------------------------------------------------------*/
+
+void mdns_responder_goodbye(mdns_responder_t* r)
+{
+	const mdns_records_t* t;
+	uint32_t i;
+	int idx;
+
+	mdns_responder_flush(r);
+
+	for(idx = 0; idx < MDNS_TABLE_MAX; ++ idx) {
+		if(!(t = r->tables[idx])) {
+			continue;
+		}
+
+		for(i = 0; i < t->count; ++ i) {
+			if(mdns_responder_announced(r, t, &t->recs[i])) {
+				mdns_responder_put(r, t, &t->recs[i], 0);
+			}
+		}
+	}
+
+	mdns_responder_flush(r);
+}
+
+/*------------------------------------------------------------------------*/
+
+void mdns_responder_timer(mdns_responder_t* r, uint64_t now)
+{
+	mdns_probe_t *p, **prev;
+
+	r->now = now;
+
+	for(prev = &r->probes; (p = *prev);) {
+		if(p->deadline <= now) {
+			if(p->step == __MDNS_PROBE_COUNT + __MDNS_ANNOUNCE_COUNT) {
+				/* job is finished */
+				*prev = p->next;
+				mdns_probe_free(p);
+
+				continue;
+			}
+
+			mdns_responder_step(r, p);
+		}
+
+		prev = &p->next;
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+int mdns_responder_timeout(const mdns_responder_t* r)
+{
+	const mdns_probe_t* p;
+	uint64_t deadline = UINT64_MAX;
+
+	for(p = r->probes; p; p = p->next) {
+		if(p->deadline < deadline) {
+			deadline = p->deadline;
+		}
+	}
+
+	if(deadline == UINT64_MAX) {
+		return(-1);
+	}
+
+	return(deadline > r->now ? deadline - r->now : 0);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int mdns_responder_carried(const mdns_responder_t* r, const mdns_records_t* old, const mdns_records_t* t, const mdns_record_t* rec)
+{
+	const mdns_probe_t* p;
+
+	/* jobs of replaced mapped table are dropped, their records are probed again */
+	for(p = r->probes; old && p; p = p->next) {
+		if(p->ref == old && mdns_probe_pending(p, t, rec)) {
+			return(1);
+		}
+	}
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int mdns_responder_refer(mdns_responder_t* r, const mdns_records_t* old, const mdns_records_t* t)
+{
+	mdns_probe_t* p;
+	uint8_t* skip;
+	uint32_t i, n;
+
+	if(!(skip = mdns_pool_calloc(MDNS_POOL_PROBES, t->count / 8 + 1, 1))) {
+		return(-1);
+	}
+
+	/* mapped records are probed in place, unchanged records are skipped */
+	for(i = n = 0; i < t->count; ++ i) {
+		if(old && mdns_records_match(old, t, &t->recs[i]) && !mdns_responder_carried(r, old, t, &t->recs[i])) {
+			skip[i / 8] |= 1 << (i % 8);
+		} else {
+			++ n;
+		}
+	}
+
+	if(!n) {
+		mdns_pool_free(skip);
+
+		return(0);
+	}
+
+	if(!(p = mdns_responder_queue(r))) {
+		mdns_pool_free(skip);
+
+		return(-1);
+	}
+
+	p->ref = t;
+	p->skip = skip;
+
+	mdns_responder_invalidate(r);
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+void mdns_responder_swap(mdns_responder_t* r, mdns_table_t idx, mdns_records_t* t)
+{
+	mdns_probe_t *p, **prev;
+	mdns_records_t* old;
+	uint32_t i;
+
+	old = r->tables[idx];
+
+	mdns_responder_reset(r);
+
+	/* goodbye for removed records */
+	for(i = 0; old && i < old->count; ++ i) {
+		if(!t || !mdns_records_match(t, old, &old->recs[i])) {
+			mdns_responder_withdraw(r, old, &old->recs[i]);
+		}
+	}
+
+	mdns_responder_flush(r);
+
+	/* probe and announce only new and changed records, mapped ones without copying */
+	if(t && (!t->map || mdns_responder_refer(r, old, t))) {
+		for(i = 0; i < t->count; ++ i) {
+			if(!old || !mdns_records_match(old, t, &t->recs[i]) || mdns_responder_carried(r, old, t, &t->recs[i])) {
+				mdns_responder_announce(r, t, &t->recs[i]);
+			}
+		}
+	}
+
+	for(prev = &r->probes; old && (p = *prev);) {
+		if(p->ref == old) {
+			*prev = p->next;
+			mdns_probe_free(p);
+
+			continue;
+		}
+
+		prev = &p->next;
+	}
+
+	/* new table is completely built, just replace it */
+	r->tables[idx] = t;
+	mdns_responder_invalidate(r);
+
+	if(old) {
+		mdns_records_free(old);
+		mdns_pool_free(old);
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+void mdns_responder_invalidate(mdns_responder_t* r)
+{
+	++ r->gen;
+
+	/* wrapped to zero, which is generation of empty entries */
+	if(!r->gen) {
+		memset(r->cache, 0, sizeof(r->cache));
+		r->gen = 1;
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+static uint32_t mdns_cache_hash(const void* buf, size_t len)
+{
+	const uint8_t* pos = buf;
+	uint32_t hash = 0x811c9dc5;
+
+	/* FNV-1a */
+	while(len --) {
+		hash = (hash ^ *pos ++) * 0x01000193;
+	}
+
+	return(hash);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_responder_check(mdns_responder_t* r, const void* buf, size_t len)
+{
+	mdns_handlers_t handlers = {
+		.rr = mdns_responder_record_handler,
+	};
+
+	r->packet = buf;
+	r->packet_len = len;
+	r->packet_rr = 0;
+
+	mdns_packet_process(buf, len, &handlers, r);
+
+	r->packet = NULL;
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_responder_begin(mdns_responder_t* r)
+{
+	mdns_responder_reset(r);
+	r->flushed = 0;
+	r->limited = 0;
+	r->rrset_count = 0;
+	r->question = 0;
+	r->nsec_count = 0;
+	r->lookup_ns = 0;
+	r->build_ns = 0;
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_responder_end(mdns_responder_t* r)
+{
+	unsigned i;
+
+	/* negative responses follow all answers */
+	for(i = 0; i < r->nsec_count; ++ i) {
+		if(!mdns_responder_limit(r, mdns_name_hash(r->nsec[i]), MDNS_RECORD_NSEC)) {
+			mdns_responder_nsec(r, r->nsec[i]);
+		}
+	}
+
+	for(i = 0; i < r->rrset_count && i < MDNS_CACHE_MAX_RRSETS; ++ i) {
+		mdns_responder_multicast(r, r->rrsets[i], 0);
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_responder_latency(mdns_responder_t* r, uint64_t start, uint64_t parsed)
+{
+	/* handlers are called from parser, builders are called from handlers */
+	mdns_hist_record(&r->latency.parse, parsed - start - r->lookup_ns);
+	mdns_hist_record(&r->latency.lookup, r->lookup_ns - r->build_ns);
+	mdns_hist_record(&r->latency.build, r->build_ns + mdns_latency_clock() - parsed);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_responder_answer(mdns_responder_t* r, const void* buf, size_t len, mdns_cache_entry_t* e, uint32_t hash, size_t q_len)
+{
+	const mdns_hdr_t* hdr = buf;
+	mdns_handlers_t handlers = {
+		.q = mdns_responder_query_handler,
+	};
+	uint64_t start, parsed;
+
+	start = mdns_latency_clock();
+
+	mdns_responder_begin(r);
+	mdns_packet_process(buf, len, &handlers, r);
+
+	parsed = mdns_latency_clock();
+
+	mdns_responder_end(r);
+
+	/* only complete responses of one packet are cached */
+	if(q_len && q_len <= sizeof(e->questions) && !r->flushed && !r->shed && !r->limited && r->rrset_count <= MDNS_CACHE_MAX_RRSETS) {
+		e->hash = hash;
+		e->gen = r->gen;
+		e->q_len = q_len;
+		e->qd_cnt = hdr->qd_cnt;
+		e->rrset_count = r->rrset_count;
+		memcpy(e->questions, (const uint8_t*)buf + sizeof(*hdr), q_len);
+		memcpy(e->rrsets, r->rrsets, r->rrset_count * sizeof(*e->rrsets));
+
+		if(mdns_packet_is_valid(r->buf, sizeof(r->buf))) {
+			e->len = mdns_packet_size(r->buf, sizeof(r->buf));
+			memcpy(e->packet, r->buf, e->len);
+		} else {
+			e->len = 0;
+		}
+	}
+
+	mdns_responder_flush(r);
+	mdns_responder_latency(r, start, parsed);
+
+	if(r->flushed && r->stamp.tv_sec) {
+		mdns_hist_record(&r->latency.total, mdns_latency_since(&r->stamp));
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_responder_deferred_handler(void* ctx, const mdns_query_hdr_t* h, const char* root)
+{
+	const mdns_deferred_t* d = ctx;
+
+	/* questions of packets are mixed, shedding follows each of them */
+	d->r->shed = d->shed;
+	mdns_responder_query_handler(d->r, h, root);
+}
+
+/*------------------------------------------------------------------------*/
+
+void mdns_responder_process_deferred(mdns_responder_t* r)
+{
+	const void* bufs[MDNS_DEFER_MAX];
+	size_t lens[MDNS_DEFER_MAX], results[MDNS_DEFER_MAX];
+	void* ctxs[MDNS_DEFER_MAX];
+	mdns_handlers_t handlers = {
+		.q = mdns_responder_deferred_handler,
+	};
+	mdns_deferred_t* d;
+	uint64_t start, parsed;
+	unsigned i, count;
+
+	if(!(count = r->deferred_count)) {
+		return;
+	}
+
+	r->deferred_count = 0;
+
+	/* alone query is answered as usual, so its response is cached */
+	if(count == 1) {
+		d = &r->deferred[0];
+		r->shed = d->shed;
+		r->stamp = d->stamp;
+
+		mdns_responder_answer(r, d->buf, d->len, d->entry, d->hash, d->q_len);
+
+		r->shed = MDNS_SHED_NONE;
+		r->stamp.tv_sec = 0;
+
+		return;
+	}
+
+	for(i = 0; i < count; ++ i) {
+		bufs[i] = r->deferred[i].buf;
+		lens[i] = r->deferred[i].len;
+		ctxs[i] = &r->deferred[i];
+	}
+
+	start = mdns_latency_clock();
+
+	/* one response answers all packets, it isn't cached */
+	mdns_responder_begin(r);
+	mdns_packet_process_batch(bufs, lens, count, &handlers, ctxs, results);
+
+	parsed = mdns_latency_clock();
+
+	r->shed = MDNS_SHED_NONE;
+	mdns_responder_end(r);
+	mdns_responder_flush(r);
+	mdns_responder_latency(r, start, parsed);
+
+	for(i = 0; r->flushed && i < count; ++ i) {
+		if(r->deferred[i].stamp.tv_sec) {
+			mdns_hist_record(&r->latency.total, mdns_latency_since(&r->deferred[i].stamp));
+		}
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_responder_handle(mdns_responder_t* r, const void* buf, size_t len, int defer)
+{
+	const mdns_hdr_t* hdr = buf;
+	mdns_cache_entry_t* e = NULL;
+	mdns_deferred_t* d;
+	uint32_t hash = 0;
+	size_t q_len;
+	unsigned i;
+
+	if(r->stamp.tv_sec) {
+		mdns_hist_record(&r->latency.queue, mdns_latency_since(&r->stamp));
+	}
+
+	if(len < sizeof(*hdr)) {
+		return;
+	}
+
+	/* responses are only checked for conflicts */
+	if(ntohs(hdr->flags) & MDNS_FLAG_ANSWER) {
+		mdns_responder_check(r, buf, len);
+
+		return;
+	}
+
+	/* probes of other hosts are compared with ours and always answered */
+	r->probe = hdr->ns_cnt != 0;
+
+	if(r->probe && r->probes) {
+		mdns_responder_check(r, buf, len);
+		mdns_responder_simultaneous(r);
+	}
+
+	/* hosts, which left query unanswered, are answered by proxy */
+	if(r->proxy.count && mdns_proxy_update(&r->proxy, r->now)) {
+		mdns_responder_invalidate(r);
+	}
+
+	/* question section with number of questions is key of cache */
+	if((q_len = mdns_packet_questions(buf, len))) {
+		q_len -= sizeof(*hdr);
+		hash = mdns_cache_hash((const uint8_t*)buf + sizeof(*hdr), q_len) ^ hdr->qd_cnt;
+		e = &r->cache[hash & (MDNS_CACHE_SIZE - 1)];
+
+		if(e->gen == r->gen && e->hash == hash && e->qd_cnt == hdr->qd_cnt && e->q_len == q_len &&
+		   !memcmp(e->questions, (const uint8_t*)buf + sizeof(*hdr), q_len)) {
+			if(r->shed >= MDNS_SHED_REPEATS) {
+				++ r->overload.stats.shed_repeats;
+				return;
+			}
+
+			/* response with recently multicast RRsets is built again without them */
+			for(i = 0; !r->probe && i < e->rrset_count && !mdns_responder_recent(r, e->rrsets[i]); ++ i);
+
+			if(r->probe || i == e->rrset_count) {
+				for(i = 0; i < e->rrset_count; ++ i) {
+					mdns_responder_multicast(r, e->rrsets[i], 0);
+				}
+
+				if(e->len) {
+					r->send(r->send_ctx, e->packet, e->len);
+
+					if(r->stamp.tv_sec) {
+						mdns_hist_record(&r->latency.total, mdns_latency_since(&r->stamp));
+					}
+				}
+
+				return;
+			}
+		}
+	}
+
+	if(!mdns_packet_prefilter(buf, len, mdns_responder_filter, r)) {
+		/* nothing is asked about our names */
+		return;
+	}
+
+	/* probes are answered at once */
+	if(!defer || r->probe) {
+		mdns_responder_answer(r, buf, len, e, hash, q_len);
+
+		return;
+	}
+
+	if(r->deferred_count == MDNS_DEFER_MAX) {
+		mdns_responder_process_deferred(r);
+	}
+
+	d = &r->deferred[r->deferred_count ++];
+	d->r = r;
+	d->buf = buf;
+	d->len = len;
+	d->shed = r->shed;
+	d->stamp = r->stamp;
+	d->entry = e;
+	d->hash = hash;
+	d->q_len = q_len;
+}
+
+/*------------------------------------------------------------------------*/
+
+void mdns_responder_process(mdns_responder_t* r, const void* buf, size_t len)
+{
+	mdns_responder_handle(r, buf, len, 0);
+
+	r->shed = MDNS_SHED_NONE;
+	r->stamp.tv_sec = 0;
+}
+
+/*------------------------------------------------------------------------*/
+
+void mdns_responder_defer(mdns_responder_t* r, const void* buf, size_t len)
+{
+	mdns_responder_handle(r, buf, len, 1);
+
+	r->shed = MDNS_SHED_NONE;
+	r->stamp.tv_sec = 0;
+}
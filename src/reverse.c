@@ -0,0 +1,356 @@
+/**
+ * @file reverse.c
+ *
+ * yamdns -- yet another very simple mdns.
+ * Copyright (C) 2013  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+
+#include <yamdns/yamdns.h>
+
+#include "reverse.h"
+#include "pool.h"
+
+/*------------------------------------------------------------------------*/
+
+/** test bit of prefix length */
+#define __MDNS_PREFIX_ISSET(set, n) ((set)[(n) / 64] & (1ULL << ((n) % 64)))
+
+/*------------------------------------------------------------------------*/
+
+void mdns_reverse_init(mdns_reverse_t* x)
+{
+	memset(x, 0, sizeof(*x));
+}
+
+/*------------------------------------------------------------------------*/
+
+void mdns_reverse_free(mdns_reverse_t* x)
+{
+	mdns_pool_free(x->ranges);
+	mdns_pool_free(x->buckets);
+
+	mdns_reverse_init(x);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_reverse_mask(mdns_reverse_key_t* key, uint8_t prefix)
+{
+	size_t i;
+
+	key->prefix = prefix;
+
+	for(i = 0; i < sizeof(key->addr); ++ i, prefix = prefix > 8 ? prefix - 8 : 0) {
+		if(prefix < 8) {
+			key->addr[i] &= (uint8_t)(0xff00 >> prefix);
+		}
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+static uint32_t mdns_reverse_hash(const mdns_reverse_key_t* key)
+{
+	uint32_t hash = 0x811c9dc5;
+	size_t i;
+
+	/* FNV-1a */
+	for(i = 0; i < sizeof(key->addr); ++ i) {
+		hash = (hash ^ key->addr[i]) * 0x01000193;
+	}
+
+	hash = (hash ^ key->family) * 0x01000193;
+	hash = (hash ^ key->prefix) * 0x01000193;
+
+	return(hash);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int mdns_reverse_rehash(mdns_reverse_t* x, uint32_t nbuckets)
+{
+	uint32_t* buckets;
+	uint32_t i, b;
+
+	if(!(buckets = mdns_pool_alloc(MDNS_POOL_REVERSE, nbuckets * sizeof(*buckets)))) {
+		return(-1);
+	}
+
+	memset(buckets, 0xff, nbuckets * sizeof(*buckets));
+
+	for(i = 0; i < x->count; ++ i) {
+		b = x->ranges[i].hash & (nbuckets - 1);
+		x->ranges[i].next = buckets[b];
+		buckets[b] = i;
+	}
+
+	mdns_pool_free(x->buckets);
+	x->buckets = buckets;
+	x->nbuckets = nbuckets;
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+static const mdns_reverse_range_t* mdns_reverse_get(const mdns_reverse_t* x, const mdns_reverse_key_t* key, uint32_t hash)
+{
+	const mdns_reverse_range_t* r;
+	uint32_t i;
+
+	for(i = x->buckets[hash & (x->nbuckets - 1)]; i < x->count; i = r->next) {
+		r = &x->ranges[i];
+
+		if(r->hash == hash && !memcmp(&r->key, key, sizeof(*key))) {
+			return(r);
+		}
+	}
+
+	return(NULL);
+}
+
+/*------------------------------------------------------------------------*/
+
+int mdns_reverse_add(mdns_reverse_t* x, const char* range, const char* target, uint32_t ttl)
+{
+	char addr[INET6_ADDRSTRLEN];
+	mdns_reverse_range_t* r;
+	mdns_reverse_key_t key;
+	const char* slash;
+	unsigned long prefix;
+	size_t size, len;
+	char* end;
+
+	memset(&key, 0, sizeof(key));
+
+	/* address and optional prefix length */
+	len = (slash = strchr(range, '/')) ? slash - range : strlen(range);
+
+	if(len >= sizeof(addr)) {
+		return(-1);
+	}
+
+	memcpy(addr, range, len);
+	addr[len] = 0;
+
+	if(inet_pton(AF_INET, addr, key.addr) == 1) {
+		key.family = AF_INET;
+		prefix = 32;
+	} else if(inet_pton(AF_INET6, addr, key.addr) == 1) {
+		key.family = AF_INET6;
+		prefix = 128;
+	} else {
+		return(-1);
+	}
+
+	if(slash) {
+		len = prefix;
+		prefix = strtoul(slash + 1, &end, 10);
+
+		if(*end || end == slash + 1 || prefix > len) {
+			return(-1);
+		}
+	}
+
+	mdns_reverse_mask(&key, prefix);
+
+	/* load factor is kept below one */
+	if(x->count >= x->nbuckets && mdns_reverse_rehash(x, x->nbuckets ? x->nbuckets * 2 : 16)) {
+		return(-1);
+	}
+
+	/* range is replaced */
+	if((r = (mdns_reverse_range_t*)mdns_reverse_get(x, &key, mdns_reverse_hash(&key)))) {
+		r->ttl = ttl;
+
+		return((r->target_len = mdns_name_encode(r->target, sizeof(r->target), target)) ? 0 : -1);
+	}
+
+	if(x->count == x->size) {
+		size = x->size ? x->size * 2 : 16;
+
+		if(!(r = mdns_pool_realloc(MDNS_POOL_REVERSE, x->ranges, size * sizeof(*r)))) {
+			return(-1);
+		}
+
+		x->ranges = r;
+		x->size = size;
+	}
+
+	r = &x->ranges[x->count];
+	r->key = key;
+	r->hash = mdns_reverse_hash(&key);
+	r->ttl = ttl;
+
+	if(!(r->target_len = mdns_name_encode(r->target, sizeof(r->target), target))) {
+		return(-1);
+	}
+
+	r->next = x->buckets[r->hash & (x->nbuckets - 1)];
+	x->buckets[r->hash & (x->nbuckets - 1)] = x->count ++;
+
+	if(key.family == AF_INET) {
+		x->prefixes4 |= 1ULL << prefix;
+	} else {
+		x->prefixes6[prefix / 64] |= 1ULL << (prefix % 64);
+	}
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int mdns_reverse_suffix(const char* pos, const char* suffix)
+{
+	size_t len;
+
+	/* last dot is optional */
+	len = strlen(pos);
+
+	if(len && pos[len - 1] == '.') {
+		-- len;
+	}
+
+	return(len == strlen(suffix) - 1 && !strncasecmp(pos, suffix, len));
+}
+
+/*------------------------------------------------------------------------*/
+
+static int mdns_reverse_parse4(const char* pos, mdns_reverse_key_t* key)
+{
+	unsigned value;
+	int i;
+
+	/* decimal labels from the last byte */
+	for(i = 3; i >= 0; -- i) {
+		if(*pos < '0' || *pos > '9') {
+			return(-1);
+		}
+
+		for(value = 0; *pos >= '0' && *pos <= '9'; ++ pos) {
+			value = value * 10 + *pos - '0';
+
+			if(value > 0xff) {
+				return(-1);
+			}
+		}
+
+		if(*pos ++ != '.') {
+			return(-1);
+		}
+
+		key->addr[i] = value;
+	}
+
+	if(!mdns_reverse_suffix(pos, MDNS_QUERY_RESOLVE_ADDRESS)) {
+		return(-1);
+	}
+
+	key->family = AF_INET;
+	key->prefix = 32;
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int mdns_reverse_parse6(const char* pos, mdns_reverse_key_t* key)
+{
+	int i, nibble;
+
+	/* hex nibbles from the last one */
+	for(i = 31; i >= 0; -- i) {
+		if(*pos >= '0' && *pos <= '9') {
+			nibble = *pos - '0';
+		} else if((*pos | 0x20) >= 'a' && (*pos | 0x20) <= 'f') {
+			nibble = (*pos | 0x20) - 'a' + 10;
+		} else {
+			return(-1);
+		}
+
+		if(pos[1] != '.') {
+			return(-1);
+		}
+
+		key->addr[i / 2] |= i % 2 ? nibble : nibble << 4;
+		pos += 2;
+	}
+
+	if(!mdns_reverse_suffix(pos, MDNS_QUERY_RESOLVE_ADDRESS6)) {
+		return(-1);
+	}
+
+	key->family = AF_INET6;
+	key->prefix = 128;
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+int mdns_reverse_parse(const char* name, mdns_reverse_key_t* key)
+{
+	memset(key, 0, sizeof(*key));
+
+	if(!mdns_reverse_parse4(name, key)) {
+		return(0);
+	}
+
+	memset(key, 0, sizeof(*key));
+
+	return(mdns_reverse_parse6(name, key));
+}
+
+/*------------------------------------------------------------------------*/
+
+const mdns_reverse_range_t* mdns_reverse_lookup(const mdns_reverse_t* x, const char* name)
+{
+	const mdns_reverse_range_t* r;
+	mdns_reverse_key_t key, masked;
+	uint64_t prefixes[3];
+	int prefix;
+
+	if(!x->count || mdns_reverse_parse(name, &key)) {
+		return(NULL);
+	}
+
+	if(key.family == AF_INET) {
+		prefixes[0] = x->prefixes4;
+		prefixes[1] = prefixes[2] = 0;
+	} else {
+		memcpy(prefixes, x->prefixes6, sizeof(prefixes));
+	}
+
+	/* the longest prefix wins */
+	for(prefix = key.prefix; prefix >= 0; -- prefix) {
+		if(!__MDNS_PREFIX_ISSET(prefixes, prefix)) {
+			continue;
+		}
+
+		masked = key;
+		mdns_reverse_mask(&masked, prefix);
+
+		if((r = mdns_reverse_get(x, &masked, mdns_reverse_hash(&masked)))) {
+			return(r);
+		}
+	}
+
+	return(NULL);
+}
@@ -0,0 +1,363 @@
+/**
+ * @file services.c
+ *
+ * yamdns -- yet another very simple mdns.
+ * Copyright (C) 2013  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+
+#include <yamdns/yamdns.h>
+
+#include "services.h"
+#include "pool.h"
+#include "name.h"
+
+/*------------------------------------------------------------------------*/
+
+/** initial number of buckets */
+#define __MDNS_SERVICES_BUCKETS 64
+
+/** size of encoded answer with prefix, prefixes are kept aligned */
+#define __MDNS_SERVICES_RR_SIZE(rr) (sizeof(*(rr)) + (((rr)->len + 1) & ~1))
+
+/** marker of subtype, RFC 6763 7.1 */
+#define __MDNS_SERVICES_SUB "._sub."
+
+/*------------------------------------------------------------------------*/
+
+int mdns_services_is_type(const char* name)
+{
+	return(*name == '_');
+}
+
+/*------------------------------------------------------------------------*/
+
+void mdns_services_init(mdns_services_t* s)
+{
+	memset(s, 0, sizeof(*s));
+}
+
+/*------------------------------------------------------------------------*/
+
+void mdns_services_free(mdns_services_t* s)
+{
+	mdns_service_type_t *st, *next;
+	unsigned i;
+
+	for(i = 0; i < s->nbuckets; ++ i) {
+		for(st = s->buckets[i]; st; st = next) {
+			next = st->next;
+
+			mdns_pool_free(st->answers);
+			mdns_pool_free(st);
+		}
+	}
+
+	mdns_pool_free(s->buckets);
+
+	mdns_services_init(s);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int mdns_services_rehash(mdns_services_t* s, unsigned nbuckets)
+{
+	mdns_service_type_t **buckets, *st, *next;
+	unsigned i;
+
+	if(!(buckets = mdns_pool_calloc(MDNS_POOL_SERVICES, nbuckets, sizeof(*buckets)))) {
+		return(-1);
+	}
+
+	for(i = 0; i < s->nbuckets; ++ i) {
+		for(st = s->buckets[i]; st; st = next) {
+			next = st->next;
+
+			st->next = buckets[st->hash & (nbuckets - 1)];
+			buckets[st->hash & (nbuckets - 1)] = st;
+		}
+	}
+
+	mdns_pool_free(s->buckets);
+
+	s->buckets = buckets;
+	s->nbuckets = nbuckets;
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+const mdns_service_type_t* mdns_services_find(const mdns_services_t* s, uint32_t hash, const char* name)
+{
+	const mdns_service_type_t* st;
+
+	if(!s->nbuckets) {
+		return(NULL);
+	}
+
+	for(st = s->buckets[hash & (s->nbuckets - 1)]; st; st = st->next) {
+		if(st->hash == hash && !mdns_name_casecmp(st->name, name)) {
+			return(st);
+		}
+	}
+
+	return(NULL);
+}
+
+/*------------------------------------------------------------------------*/
+
+int mdns_services_has_hash(const mdns_services_t* s, uint32_t hash)
+{
+	const mdns_service_type_t* st;
+
+	if(!s->nbuckets) {
+		return(0);
+	}
+
+	for(st = s->buckets[hash & (s->nbuckets - 1)]; st; st = st->next) {
+		if(st->hash == hash) {
+			return(1);
+		}
+	}
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+static mdns_service_type_t* mdns_services_get(mdns_services_t* s, uint32_t hash, const char* name)
+{
+	mdns_service_type_t* st;
+
+	if((st = (mdns_service_type_t*)mdns_services_find(s, hash, name))) {
+		return(st);
+	}
+
+	/* load factor is kept below one */
+	if(s->count >= s->nbuckets && mdns_services_rehash(s, s->nbuckets ? s->nbuckets * 2 : __MDNS_SERVICES_BUCKETS)) {
+		return(NULL);
+	}
+
+	if(strlen(name) >= sizeof(st->name) || !(st = mdns_pool_calloc(MDNS_POOL_SERVICES, 1, sizeof(*st)))) {
+		return(NULL);
+	}
+
+	st->hash = hash;
+	strcpy(st->name, name);
+
+	st->next = s->buckets[hash & (s->nbuckets - 1)];
+	s->buckets[hash & (s->nbuckets - 1)] = st;
+	++ s->count;
+
+	return(st);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_services_put(mdns_services_t* s, mdns_service_type_t* st)
+{
+	mdns_service_type_t** prev;
+
+	if(st->count) {
+		return;
+	}
+
+	/* type without answers is dropped */
+	for(prev = &s->buckets[st->hash & (s->nbuckets - 1)]; *prev != st; prev = &(*prev)->next);
+
+	*prev = st->next;
+	-- s->count;
+
+	mdns_pool_free(st->answers);
+	mdns_pool_free(st);
+}
+
+/*------------------------------------------------------------------------*/
+
+static mdns_service_rr_t* mdns_services_rr(const mdns_service_type_t* st, const void* rdata, size_t rd_len)
+{
+	mdns_service_rr_t* rr;
+	size_t pos;
+
+	for(pos = 0; pos < st->len; pos += __MDNS_SERVICES_RR_SIZE(rr)) {
+		rr = (mdns_service_rr_t*)&st->answers[pos];
+
+		if(rr->len - rr->rdata == rd_len && !memcmp((uint8_t*)(rr + 1) + rr->rdata, rdata, rd_len)) {
+			return(rr);
+		}
+	}
+
+	return(NULL);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int mdns_services_add_rr(mdns_service_type_t* st, uint32_t ttl, const void* rdata, size_t rd_len, int* added)
+{
+	mdns_answer_hdr_t* hdr;
+	mdns_service_rr_t* rr;
+	size_t len, size;
+	uint8_t* pos;
+
+	*added = 0;
+
+	/* the same record from another table */
+	if((rr = mdns_services_rr(st, rdata, rd_len))) {
+		hdr = (mdns_answer_hdr_t*)((uint8_t*)(rr + 1) + rr->rdata - sizeof(*hdr));
+		hdr->a_ttl = htonl(ttl);
+		++ rr->refs;
+
+		return(0);
+	}
+
+	/* room for prefix, owner name, header and rdata */
+	if(st->len + sizeof(*rr) + MDNS_MAX_NAME + sizeof(*hdr) + rd_len + 1 > st->size) {
+		size = st->size ? st->size * 2 : 512;
+
+		while(st->len + sizeof(*rr) + MDNS_MAX_NAME + sizeof(*hdr) + rd_len + 1 > size) {
+			size *= 2;
+		}
+
+		if(!(pos = mdns_pool_realloc(MDNS_POOL_SERVICES, st->answers, size))) {
+			return(-1);
+		}
+
+		st->answers = pos;
+		st->size = size;
+	}
+
+	rr = (mdns_service_rr_t*)&st->answers[st->len];
+	pos = (uint8_t*)(rr + 1);
+
+	if(!(len = mdns_name_encode(pos, MDNS_MAX_NAME, st->name))) {
+		return(-1);
+	}
+
+	hdr = (mdns_answer_hdr_t*)(pos + len);
+	hdr->a_type = htons(MDNS_RECORD_PTR);
+	hdr->a_class = htons(MDNS_CLASS_IN);
+	hdr->a_ttl = htonl(ttl);
+	hdr->rd_len = htons(rd_len);
+	memcpy(hdr + 1, rdata, rd_len);
+
+	rr->rdata = len + sizeof(*hdr);
+	rr->len = rr->rdata + rd_len;
+	rr->refs = 1;
+
+	st->len += __MDNS_SERVICES_RR_SIZE(rr);
+	++ st->count;
+	*added = 1;
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int mdns_services_remove_rr(mdns_service_type_t* st, const void* rdata, size_t rd_len)
+{
+	mdns_service_rr_t* rr;
+	size_t len;
+
+	if(!(rr = mdns_services_rr(st, rdata, rd_len)) || -- rr->refs) {
+		return(0);
+	}
+
+	len = __MDNS_SERVICES_RR_SIZE(rr);
+	memmove(rr, (uint8_t*)rr + len, st->answers + st->len - (uint8_t*)rr - len);
+	st->len -= len;
+	-- st->count;
+
+	return(1);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int mdns_services_is_meta(const char* name)
+{
+	/* subtypes and meta-query itself are not enumerated, RFC 6763 9 */
+	return(!strcasecmp(name, MDNS_QUERY_SERVICE_DISCOVERY) || strcasestr(name, __MDNS_SERVICES_SUB));
+}
+
+/*------------------------------------------------------------------------*/
+
+int mdns_services_add(mdns_services_t* s, const char* name, uint32_t ttl, const void* rdata, size_t rd_len)
+{
+	mdns_service_type_t *st, *meta;
+	uint8_t type[MDNS_MAX_NAME];
+	size_t len;
+	int added;
+
+	if(!(st = mdns_services_get(s, mdns_name_hash(name), name))) {
+		return(-1);
+	}
+
+	if(mdns_services_add_rr(st, ttl, rdata, rd_len, &added)) {
+		mdns_services_put(s, st);
+
+		return(-1);
+	}
+
+	/* first instance of type, so type is enumerated */
+	if(!added || st->count > 1 || mdns_services_is_meta(name)) {
+		return(0);
+	}
+
+	if(!(len = mdns_name_encode(type, sizeof(type), name)) ||
+	   !(meta = mdns_services_get(s, mdns_name_hash(MDNS_QUERY_SERVICE_DISCOVERY), MDNS_QUERY_SERVICE_DISCOVERY))) {
+		return(-1);
+	}
+
+	if(mdns_services_add_rr(meta, ttl, type, len, &added)) {
+		mdns_services_put(s, meta);
+
+		return(-1);
+	}
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+void mdns_services_remove(mdns_services_t* s, const char* name, const void* rdata, size_t rd_len)
+{
+	mdns_service_type_t *st, *meta;
+	uint8_t type[MDNS_MAX_NAME];
+	size_t len;
+
+	if(!(st = (mdns_service_type_t*)mdns_services_find(s, mdns_name_hash(name), name))) {
+		return;
+	}
+
+	if(!mdns_services_remove_rr(st, rdata, rd_len) || st->count) {
+		return;
+	}
+
+	mdns_services_put(s, st);
+
+	/* last instance of type is gone */
+	if(mdns_services_is_meta(name) || !(len = mdns_name_encode(type, sizeof(type), name))) {
+		return;
+	}
+
+	if((meta = (mdns_service_type_t*)mdns_services_find(s, mdns_name_hash(MDNS_QUERY_SERVICE_DISCOVERY), MDNS_QUERY_SERVICE_DISCOVERY))) {
+		mdns_services_remove_rr(meta, type, len);
+		mdns_services_put(s, meta);
+	}
+}
@@ -0,0 +1,849 @@
+/* yamdns -- yet another very simple mdns.
+ * Copyright (C) 2013  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+
+#include <yamdns/yamdns.h>
+
+#include "responder.h"
+#include "latency.h"
+#include "name.h"
+#include "pool.h"
+
+/*------------------------------------------------------------------------*/
+
+/** sender of lookups, it is not a responder */
+#define __SIM_QUERIER UINT32_MAX
+
+/** service type of simulated hosts */
+#define __SIM_SERVICE "_sim._tcp"
+
+/** browsed name */
+#define __SIM_BROWSE __SIM_SERVICE "." MDNS_DOMAIN
+
+/** first retransmission of lookup in microseconds, doubled each time, RFC 6762 5.2 */
+#define __SIM_RETRY_INTERVAL 1000000
+
+/** max number of retransmissions of lookup */
+#define __SIM_RETRY_MAX 3
+
+/** number of buckets of pending lookups, power of two */
+#define __SIM_LOOKUP_BUCKETS 4096
+
+/** no lookup in chain */
+#define __SIM_NONE UINT32_MAX
+
+/*------------------------------------------------------------------------*/
+
+/** kinds of events */
+enum {
+	/** host is powered on and starts probing */
+	SIM_BOOT,
+
+	/** probing and announcing step of host */
+	SIM_TIMER,
+
+	/** packet reaches all hosts of segment */
+	SIM_DELIVER,
+
+	/** querier starts new lookup */
+	SIM_LOOKUP,
+
+	/** lookup is not answered in time */
+	SIM_RETRY,
+};
+
+/** packet on the wire */
+typedef struct sim_packet {
+	/** index of sender */
+	uint32_t from;
+
+	/** length of packet */
+	uint32_t len;
+
+	/** packet */
+	uint8_t data[MDNS_MAX_PACKET];
+} sim_packet_t;
+
+/** scheduled event */
+typedef struct sim_event {
+	/** virtual time in microseconds */
+	uint64_t time;
+
+	/** order of scheduling, keeps events of the same time in order */
+	uint64_t seq;
+
+	/** SIM_* */
+	uint32_t kind;
+
+	/** index of host or lookup */
+	uint32_t id;
+
+	/** packet of SIM_DELIVER */
+	sim_packet_t* pkt;
+} sim_event_t;
+
+/** simulated host */
+typedef struct sim_host {
+	/** responder of host */
+	mdns_responder_t r;
+
+	/** time of scheduled timer, UINT64_MAX if none */
+	uint64_t timer;
+
+	/** host is booted */
+	int up;
+} sim_host_t;
+
+/** lookup of querier */
+typedef struct sim_lookup {
+	/** dotted name */
+	char name[MDNS_MAX_NAME];
+
+	/** hash of name */
+	uint32_t hash;
+
+	/** type of question */
+	uint16_t type;
+
+	/** number of sent queries */
+	uint16_t tries;
+
+	/** time of the first query */
+	uint64_t start;
+
+	/** next lookup of bucket */
+	uint32_t next;
+
+	/** lookup is answered or given up */
+	int done;
+} sim_lookup_t;
+
+/** counters of segment */
+typedef struct sim_stats {
+	/** packets on the wire */
+	uint64_t packets;
+
+	/** bytes of packets */
+	uint64_t bytes;
+
+	/** queries with proposed records */
+	uint64_t probes;
+
+	/** other queries */
+	uint64_t queries;
+
+	/** responses */
+	uint64_t responses;
+
+	/** packets passed to responders */
+	uint64_t deliveries;
+
+	/** packets lost for one receiver */
+	uint64_t dropped;
+
+	/** retransmissions of lookups */
+	uint64_t retries;
+
+	/** answered lookups */
+	uint64_t resolved;
+
+	/** lookups without answer after all retries */
+	uint64_t failed;
+
+	/** events processed */
+	uint64_t events;
+
+	/** time from the first query to answer of address */
+	mdns_hist_t resolve;
+
+	/** time from the first query to the first instance of service */
+	mdns_hist_t browse;
+} sim_stats_t;
+
+/*------------------------------------------------------------------------*/
+
+/** parameters */
+static unsigned hosts_count = 2000;
+static unsigned long long seed = 1;
+static unsigned duration = 10;
+static unsigned boot_ms = 1000;
+static unsigned latency_us = 1000;
+static unsigned jitter_us = 500;
+static double loss;
+static unsigned lookup_rate = 50;
+static unsigned browse_percent = 10;
+static unsigned service_percent = 50;
+static unsigned conflicts;
+static int verbose;
+
+/** state of simulation */
+static sim_host_t* hosts;
+static sim_event_t* events;
+static size_t events_count;
+static size_t events_size;
+static uint64_t events_seq;
+static uint64_t now;
+static uint64_t rng;
+
+static sim_lookup_t* lookups;
+static uint32_t lookups_count;
+static uint32_t lookups_size;
+static uint32_t buckets[__SIM_LOOKUP_BUCKETS];
+
+static sim_stats_t stats;
+
+/** packets and bytes of each second */
+static uint64_t* second_packets;
+static uint64_t* second_bytes;
+
+/*------------------------------------------------------------------------*/
+
+static uint64_t sim_random(void)
+{
+	/* splitmix64, the whole run depends only on seed */
+	uint64_t z = (rng += 0x9e3779b97f4a7c15ULL);
+
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+
+	return(z ^ (z >> 31));
+}
+
+/*------------------------------------------------------------------------*/
+
+static uint64_t sim_uniform(uint64_t n)
+{
+	return(n ? sim_random() % n : 0);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int sim_before(const sim_event_t* a, const sim_event_t* b)
+{
+	return(a->time < b->time || (a->time == b->time && a->seq < b->seq));
+}
+
+/*------------------------------------------------------------------------*/
+
+static int sim_push(uint64_t time, uint32_t kind, uint32_t id, sim_packet_t* pkt)
+{
+	sim_event_t* tmp;
+	sim_event_t ev;
+	size_t i;
+
+	if(events_count == events_size) {
+		if(!(tmp = realloc(events, (events_size ? events_size * 2 : 1024) * sizeof(*events)))) {
+			return(-1);
+		}
+
+		events = tmp;
+		events_size = events_size ? events_size * 2 : 1024;
+	}
+
+	ev.time = time;
+	ev.seq = events_seq ++;
+	ev.kind = kind;
+	ev.id = id;
+	ev.pkt = pkt;
+
+	/* binary heap, sift up */
+	for(i = events_count ++; i && sim_before(&ev, &events[(i - 1) / 2]); i = (i - 1) / 2) {
+		events[i] = events[(i - 1) / 2];
+	}
+
+	events[i] = ev;
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void sim_pop(sim_event_t* ev)
+{
+	sim_event_t last;
+	size_t i, child;
+
+	*ev = events[0];
+	last = events[-- events_count];
+
+	/* sift down */
+	for(i = 0; (child = 2 * i + 1) < events_count; i = child) {
+		if(child + 1 < events_count && sim_before(&events[child + 1], &events[child])) {
+			++ child;
+		}
+
+		if(!sim_before(&events[child], &last)) {
+			break;
+		}
+
+		events[i] = events[child];
+	}
+
+	events[i] = last;
+}
+
+/*------------------------------------------------------------------------*/
+
+static int sim_send(void* ctx, const void* buf, size_t len)
+{
+	const mdns_hdr_t* hdr = buf;
+	sim_packet_t* pkt;
+	unsigned sec;
+
+	if(len > sizeof(pkt->data) || !(pkt = malloc(sizeof(*pkt)))) {
+		return(-1);
+	}
+
+	pkt->from = ctx ? (uint32_t)((sim_host_t*)ctx - hosts) : __SIM_QUERIER;
+	pkt->len = len;
+	memcpy(pkt->data, buf, len);
+
+	++ stats.packets;
+	stats.bytes += len;
+
+	if(ntohs(hdr->flags) & MDNS_FLAG_ANSWER) {
+		++ stats.responses;
+	} else if(hdr->ns_cnt) {
+		++ stats.probes;
+	} else {
+		++ stats.queries;
+	}
+
+	if((sec = now / 1000000) < duration) {
+		++ second_packets[sec];
+		second_bytes[sec] += len;
+	}
+
+	/* segment is shared, everybody gets the same packet at once */
+	if(sim_push(now + latency_us + sim_uniform(jitter_us), SIM_DELIVER, 0, pkt)) {
+		free(pkt);
+
+		return(-1);
+	}
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void sim_schedule(uint32_t id)
+{
+	sim_host_t* h = &hosts[id];
+	uint64_t time;
+	int timeout;
+
+	if((timeout = mdns_responder_timeout(&h->r)) < 0) {
+		return;
+	}
+
+	/* responder counts milliseconds */
+	time = (h->r.now + timeout) * 1000;
+
+	if(time < now) {
+		time = now;
+	}
+
+	/* later timer is dropped when it fires */
+	if(time < h->timer && !sim_push(time, SIM_TIMER, id, NULL)) {
+		h->timer = time;
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+static void sim_host_name(char* name, size_t size, uint32_t id)
+{
+	/* the last hosts take names of the first hosts */
+	if(id >= hosts_count - conflicts) {
+		id -= hosts_count - conflicts;
+	}
+
+	snprintf(name, size, "host-%u.%s", id, MDNS_DOMAIN);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int sim_boot(uint32_t id)
+{
+	static const uint8_t txt[] = "\x09txtvers=1";
+	char name[MDNS_MAX_NAME], instance[MDNS_MAX_LABEL_NAME];
+	sim_host_t* h = &hosts[id];
+	mdns_records_t *host, *config;
+	struct in_addr in;
+
+	mdns_responder_init(&h->r, sim_send, h);
+	mdns_responder_timer(&h->r, now / 1000);
+
+	h->timer = UINT64_MAX;
+	h->up = 1;
+
+	sim_host_name(name, sizeof(name), id);
+	in.s_addr = htonl(0x0a000001 + id);
+
+	if(!(host = mdns_pool_alloc(MDNS_POOL_RECORDS, sizeof(*host)))) {
+		return(-1);
+	}
+
+	mdns_records_init(host);
+
+	if(mdns_responder_host(host, name, in)) {
+		mdns_records_free(host);
+		mdns_pool_free(host);
+
+		return(-1);
+	}
+
+	mdns_responder_swap(&h->r, MDNS_TABLE_HOST, host);
+
+	if(sim_uniform(100) < service_percent) {
+		if(!(config = mdns_pool_alloc(MDNS_POOL_RECORDS, sizeof(*config)))) {
+			return(-1);
+		}
+
+		mdns_records_init(config);
+		snprintf(instance, sizeof(instance), "host-%u", id);
+
+		if(mdns_records_add_service(config, instance, __SIM_SERVICE, 80, name, txt, sizeof(txt) - 1)) {
+			mdns_records_free(config);
+			mdns_pool_free(config);
+
+			return(-1);
+		}
+
+		mdns_responder_swap(&h->r, MDNS_TABLE_CONFIG, config);
+	}
+
+	sim_schedule(id);
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void sim_query(const sim_lookup_t* l)
+{
+	uint8_t buf[MDNS_MAX_PACKET];
+
+	mdns_packet_init(buf, sizeof(buf));
+
+	if(!mdns_packet_add_query_in(buf, sizeof(buf), l->type, l->name)) {
+		sim_send(NULL, buf, mdns_packet_size(buf, sizeof(buf)));
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+static void sim_unlink(uint32_t id)
+{
+	uint32_t* pos;
+
+	for(pos = &buckets[lookups[id].hash & (__SIM_LOOKUP_BUCKETS - 1)]; *pos != id; pos = &lookups[*pos].next);
+
+	*pos = lookups[id].next;
+	lookups[id].done = 1;
+}
+
+/*------------------------------------------------------------------------*/
+
+static int sim_lookup(void)
+{
+	sim_lookup_t* tmp;
+	sim_lookup_t* l;
+	uint32_t id;
+
+	if(lookups_count == lookups_size) {
+		if(!(tmp = realloc(lookups, (lookups_size ? lookups_size * 2 : 256) * sizeof(*lookups)))) {
+			return(-1);
+		}
+
+		lookups = tmp;
+		lookups_size = lookups_size ? lookups_size * 2 : 256;
+	}
+
+	id = lookups_count ++;
+	l = &lookups[id];
+
+	/* address of any host, some are not booted yet */
+	if(sim_uniform(100) < browse_percent) {
+		strcpy(l->name, __SIM_BROWSE);
+		l->type = MDNS_RECORD_PTR;
+	} else {
+		sim_host_name(l->name, sizeof(l->name), sim_uniform(hosts_count - conflicts));
+		l->type = MDNS_RECORD_A;
+	}
+
+	l->hash = mdns_name_hash(l->name);
+	l->tries = 1;
+	l->start = now;
+	l->done = 0;
+	l->next = buckets[l->hash & (__SIM_LOOKUP_BUCKETS - 1)];
+	buckets[l->hash & (__SIM_LOOKUP_BUCKETS - 1)] = id;
+
+	sim_query(l);
+
+	return(sim_push(now + __SIM_RETRY_INTERVAL, SIM_RETRY, id, NULL));
+}
+
+/*------------------------------------------------------------------------*/
+
+static int sim_retry(uint32_t id)
+{
+	sim_lookup_t* l = &lookups[id];
+
+	if(l->done) {
+		return(0);
+	}
+
+	if(l->tries > __SIM_RETRY_MAX) {
+		sim_unlink(id);
+		++ stats.failed;
+
+		return(0);
+	}
+
+	++ l->tries;
+	++ stats.retries;
+
+	sim_query(l);
+
+	return(sim_push(now + ((uint64_t)__SIM_RETRY_INTERVAL << (l->tries - 1)), SIM_RETRY, id, NULL));
+}
+
+/*------------------------------------------------------------------------*/
+
+static void sim_answer_handler(void* ctx, const mdns_answer_hdr_t* h, const char* root, const void* rdata, size_t len)
+{
+	uint32_t hash, id, next;
+	uint16_t type;
+
+	/* goodbye is not an answer */
+	if(!h->a_ttl) {
+		return;
+	}
+
+	type = ntohs(h->a_type);
+	hash = mdns_name_hash(root);
+
+	for(id = buckets[hash & (__SIM_LOOKUP_BUCKETS - 1)]; id != __SIM_NONE; id = next) {
+		next = lookups[id].next;
+
+		if(lookups[id].hash != hash || lookups[id].type != type || mdns_name_casecmp(lookups[id].name, root)) {
+			continue;
+		}
+
+		mdns_hist_record(type == MDNS_RECORD_PTR ? &stats.browse : &stats.resolve, (now - lookups[id].start) * 1000);
+		++ stats.resolved;
+
+		sim_unlink(id);
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+static void sim_deliver(sim_packet_t* pkt)
+{
+	const mdns_hdr_t* hdr = (const mdns_hdr_t*)pkt->data;
+	mdns_handlers_t handlers = {
+		.rr = sim_answer_handler,
+	};
+	uint32_t i;
+
+	for(i = 0; i < hosts_count; ++ i) {
+		if(!hosts[i].up || i == pkt->from) {
+			continue;
+		}
+
+		/* each receiver loses packet independently */
+		if(loss > 0 && sim_uniform(1000000) < loss * 10000) {
+			++ stats.dropped;
+			continue;
+		}
+
+		++ stats.deliveries;
+
+		mdns_responder_timer(&hosts[i].r, now / 1000);
+		mdns_responder_process(&hosts[i].r, pkt->data, pkt->len);
+		sim_schedule(i);
+	}
+
+	/* querier listens to responses only */
+	if(pkt->from != __SIM_QUERIER && (ntohs(hdr->flags) & MDNS_FLAG_ANSWER) &&
+	   !(loss > 0 && sim_uniform(1000000) < loss * 10000)) {
+		mdns_packet_process(pkt->data, pkt->len, &handlers, NULL);
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+static int sim_run(void)
+{
+	sim_event_t ev;
+	uint32_t i;
+
+	for(i = 0; i < hosts_count; ++ i) {
+		if(sim_push(sim_uniform(boot_ms * 1000ULL), SIM_BOOT, i, NULL)) {
+			return(-1);
+		}
+	}
+
+	if(lookup_rate && sim_push(sim_uniform(1000000 / lookup_rate), SIM_LOOKUP, 0, NULL)) {
+		return(-1);
+	}
+
+	while(events_count && events[0].time < duration * 1000000ULL) {
+		sim_pop(&ev);
+		now = ev.time;
+		++ stats.events;
+
+		switch(ev.kind) {
+			case SIM_BOOT:
+				if(sim_boot(ev.id)) {
+					return(-1);
+				}
+				break;
+
+			case SIM_TIMER:
+				/* timer was moved earlier */
+				if(ev.time != hosts[ev.id].timer) {
+					break;
+				}
+
+				hosts[ev.id].timer = UINT64_MAX;
+				mdns_responder_timer(&hosts[ev.id].r, now / 1000);
+				sim_schedule(ev.id);
+				break;
+
+			case SIM_DELIVER:
+				sim_deliver(ev.pkt);
+				free(ev.pkt);
+				break;
+
+			case SIM_LOOKUP:
+				/* random gaps, lookup_rate per second on average */
+				if(sim_lookup() ||
+				   sim_push(now + 1 + sim_uniform(2000000 / lookup_rate), SIM_LOOKUP, 0, NULL)) {
+					return(-1);
+				}
+				break;
+
+			case SIM_RETRY:
+				if(sim_retry(ev.id)) {
+					return(-1);
+				}
+				break;
+		}
+	}
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void sim_hist_print(const char* name, const mdns_hist_t* h)
+{
+	if(!h->count) {
+		printf("%s: none\n", name);
+		return;
+	}
+
+	printf("%s: count %llu, p50 %.3f, p90 %.3f, p99 %.3f, max %.3f ms\n",
+		name, (unsigned long long)h->count,
+		mdns_hist_percentile(h, 50) / 1e6, mdns_hist_percentile(h, 90) / 1e6,
+		mdns_hist_percentile(h, 99) / 1e6, h->max / 1e6
+	);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void sim_report(void)
+{
+	uint64_t peak_packets = 0, peak_bytes = 0;
+	unsigned long withdrawn = 0;
+	unsigned i;
+
+	for(i = 0; i < duration; ++ i) {
+		if(second_packets[i] > peak_packets) {
+			peak_packets = second_packets[i];
+		}
+
+		if(second_bytes[i] > peak_bytes) {
+			peak_bytes = second_bytes[i];
+		}
+
+		if(verbose) {
+			printf("second %u: %llu packets, %llu bytes\n", i,
+				(unsigned long long)second_packets[i], (unsigned long long)second_bytes[i]);
+		}
+	}
+
+	for(i = 0; i < hosts_count; ++ i) {
+		withdrawn += hosts[i].r.conflicts.count;
+	}
+
+	printf("hosts %u, seed %llu, %u s, boot %u ms, latency %u us, jitter %u us, loss %.2f%%\n",
+		hosts_count, seed, duration, boot_ms, latency_us, jitter_us, loss);
+	printf("segment: %llu packets, %llu bytes, %llu probes, %llu queries, %llu responses\n",
+		(unsigned long long)stats.packets, (unsigned long long)stats.bytes,
+		(unsigned long long)stats.probes, (unsigned long long)stats.queries,
+		(unsigned long long)stats.responses);
+	printf("rate: %.1f packets/s, peak %llu packets/s, %.1f bytes/s, peak %llu bytes/s\n",
+		(double)stats.packets / duration, (unsigned long long)peak_packets,
+		(double)stats.bytes / duration, (unsigned long long)peak_bytes);
+	printf("receivers: %llu delivered, %llu dropped\n",
+		(unsigned long long)stats.deliveries, (unsigned long long)stats.dropped);
+	printf("conflicts: %lu names withdrawn\n", withdrawn);
+	printf("lookups: %u started, %llu resolved, %llu failed, %llu pending, %llu retries\n",
+		lookups_count, (unsigned long long)stats.resolved, (unsigned long long)stats.failed,
+		(unsigned long long)(lookups_count - stats.resolved - stats.failed),
+		(unsigned long long)stats.retries);
+
+	sim_hist_print("resolve", &stats.resolve);
+	sim_hist_print("browse", &stats.browse);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void usage(const char* prog)
+{
+	printf("Usage: %s [-n hosts] [-s seed] [-t seconds] [-b boot ms] [-l latency us] [-j jitter us] "
+		"[-p loss %%] [-q lookups/s] [-B browse %%] [-S services %%] [-c conflicts] [-v]\n", prog);
+}
+
+/*------------------------------------------------------------------------*/
+
+int main(int narg, char** argv)
+{
+	uint64_t start;
+	int exit_code = 1;
+	unsigned i;
+	int opt;
+
+	while((opt = getopt(narg, argv, "n:s:t:b:l:j:p:q:B:S:c:v")) != -1) {
+		switch(opt) {
+			case 'n':
+				hosts_count = strtoul(optarg, NULL, 0);
+				break;
+
+			case 's':
+				seed = strtoull(optarg, NULL, 0);
+				break;
+
+			case 't':
+				duration = strtoul(optarg, NULL, 0);
+				break;
+
+			case 'b':
+				boot_ms = strtoul(optarg, NULL, 0);
+				break;
+
+			case 'l':
+				latency_us = strtoul(optarg, NULL, 0);
+				break;
+
+			case 'j':
+				jitter_us = strtoul(optarg, NULL, 0);
+				break;
+
+			case 'p':
+				loss = strtod(optarg, NULL);
+				break;
+
+			case 'q':
+				lookup_rate = strtoul(optarg, NULL, 0);
+				break;
+
+			case 'B':
+				browse_percent = strtoul(optarg, NULL, 0);
+				break;
+
+			case 'S':
+				service_percent = strtoul(optarg, NULL, 0);
+				break;
+
+			case 'c':
+				conflicts = strtoul(optarg, NULL, 0);
+				break;
+
+			case 'v':
+				verbose = 1;
+				break;
+
+			default:
+				usage(argv[0]);
+				return(exit_code);
+		}
+	}
+
+	if(optind != narg || !hosts_count || conflicts >= hosts_count || !duration || loss < 0 || loss > 100) {
+		usage(argv[0]);
+		return(exit_code);
+	}
+
+	/* responders take random delay of probes from rand() */
+	rng = seed;
+	srand(seed);
+
+	memset(buckets, 0xff, sizeof(buckets));
+
+	hosts = calloc(hosts_count, sizeof(*hosts));
+	second_packets = calloc(duration, sizeof(*second_packets));
+	second_bytes = calloc(duration, sizeof(*second_bytes));
+
+	if(!hosts || !second_packets || !second_bytes) {
+		perror("calloc()");
+		goto error;
+	}
+
+	start = mdns_latency_clock();
+
+	if(sim_run()) {
+		perror("simulation");
+		goto error;
+	}
+
+	sim_report();
+
+	/* wall time differs between runs, report goes to stdout only */
+	fprintf(stderr, "%llu events in %.3f s\n", (unsigned long long)stats.events,
+		(mdns_latency_clock() - start) / 1e9);
+
+	exit_code = 0;
+
+error:
+	for(i = 0; hosts && i < hosts_count; ++ i) {
+		if(hosts[i].up) {
+			mdns_responder_free(&hosts[i].r);
+		}
+	}
+
+	while(events_count) {
+		free(events[-- events_count].pkt);
+	}
+
+	free(events);
+	free(lookups);
+	free(hosts);
+	free(second_packets);
+	free(second_bytes);
+
+	return(exit_code);
+}
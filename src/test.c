@@ -0,0 +1,764 @@
+/* yamdns -- yet another very simple mdns.
+ * Copyright (C) 2013  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#include <yamdns/yamdns.h>
+
+#include "responder.h"
+#include "reflector.h"
+#include "json.h"
+#include "pool.h"
+
+/*------------------------------------------------------------------------*/
+
+/** host name of tested responder */
+#define __TEST_HOST "test." MDNS_DOMAIN
+
+/** reverse name of address of tested responder */
+#define __TEST_REVERSE "2.2.0.192.in-addr.arpa."
+
+/** max number of packets in tested batch */
+#define __TEST_BATCH_PACKETS 8
+
+/** max number of questions in packet of tested batch */
+#define __TEST_BATCH_QUESTIONS 60
+
+/*------------------------------------------------------------------------*/
+
+/** number of responses sent by tested responder */
+static unsigned sent;
+
+/** last response of tested responder */
+static uint8_t last[MDNS_MAX_PACKET];
+
+/** packets forwarded by tested reflector */
+static struct {
+	/** number of packets */
+	unsigned count;
+
+	/** interface of last packet */
+	unsigned iface;
+
+	/** length of last packet */
+	size_t len;
+
+	/** last packet */
+	uint8_t buf[MDNS_MAX_PACKET];
+} reflected;
+
+/** handled questions and records of batch */
+static struct {
+	/** number of handled questions */
+	unsigned questions;
+
+	/** number of handled records */
+	unsigned records;
+
+	/** number of records handled after the first question */
+	unsigned late;
+
+	/** number of questions with lower hash than previous one */
+	unsigned descents;
+
+	/** hash of previous question */
+	uint32_t hash;
+
+	/** number of handler calls of each question */
+	unsigned seen[__TEST_BATCH_PACKETS][__TEST_BATCH_QUESTIONS];
+} batch;
+
+/*------------------------------------------------------------------------*/
+
+static int test_send(void* ctx, const void* buf, size_t len)
+{
+	++ sent;
+	memcpy(last, buf, len < sizeof(last) ? len : sizeof(last));
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int test_responder(mdns_responder_t* r, uint64_t* now)
+{
+	mdns_records_t* host;
+	struct in_addr in;
+
+	mdns_responder_init(r, test_send, NULL);
+	mdns_responder_timer(r, *now);
+
+	if(!(host = mdns_pool_alloc(MDNS_POOL_RECORDS, sizeof(*host)))) {
+		return(-1);
+	}
+
+	mdns_records_init(host);
+	in.s_addr = htonl(0xc0000202);
+
+	if(mdns_responder_host(host, __TEST_HOST, in)) {
+		mdns_records_free(host);
+		mdns_pool_free(host);
+
+		return(-1);
+	}
+
+	mdns_responder_swap(r, MDNS_TABLE_HOST, host);
+
+	/* nobody else is on the segment, probing and announcing finish */
+	while(mdns_responder_timeout(r) >= 0) {
+		*now += mdns_responder_timeout(r);
+		mdns_responder_timer(r, *now);
+	}
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+static unsigned test_query(mdns_responder_t* r, int family, uint16_t type, const char* name)
+{
+	uint8_t buf[MDNS_MAX_PACKET];
+	unsigned before = sent;
+
+	mdns_packet_init(buf, sizeof(buf));
+
+	if(mdns_packet_add_query_in(buf, sizeof(buf), type, name)) {
+		return(0);
+	}
+
+	mdns_responder_family(r, family);
+	mdns_responder_process(r, buf, mdns_packet_size(buf, sizeof(buf)));
+	mdns_responder_flush(r);
+
+	return(sent - before);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int test_family_limit(void)
+{
+	mdns_responder_t* r;
+	uint64_t now = 1000;
+	int res = -1;
+
+	if(!(r = malloc(sizeof(*r)))) {
+		return(-1);
+	}
+
+	if(test_responder(r, &now)) {
+		free(r);
+
+		return(-1);
+	}
+
+	now += 5000;
+	mdns_responder_timer(r, now);
+
+	/* querier of other family didn't see the first answer */
+	if(test_query(r, AF_INET, MDNS_RECORD_A, __TEST_HOST) != 1 ||
+	   test_query(r, AF_INET6, MDNS_RECORD_A, __TEST_HOST) != 1) {
+		fprintf(stderr, "%s: answer isn't sent to both families\n", __func__);
+		goto out;
+	}
+
+	/* the same family is limited within a second, cached response too */
+	if(test_query(r, AF_INET, MDNS_RECORD_A, __TEST_HOST) ||
+	   test_query(r, AF_INET6, MDNS_RECORD_A, __TEST_HOST)) {
+		fprintf(stderr, "%s: answer isn't limited per family\n", __func__);
+		goto out;
+	}
+
+	now += 1000;
+	mdns_responder_timer(r, now);
+
+	if(test_query(r, AF_INET6, MDNS_RECORD_A, __TEST_HOST) != 1) {
+		fprintf(stderr, "%s: answer is limited after interval\n", __func__);
+		goto out;
+	}
+
+	res = 0;
+
+out:
+	mdns_responder_free(r);
+	free(r);
+
+	return(res);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void test_batch_query_handler(void* ctx, const mdns_query_hdr_t* h, const char* root)
+{
+	unsigned packet, question;
+	uint32_t hash = mdns_name_hash(root);
+
+	if(batch.questions && hash < batch.hash) {
+		++ batch.descents;
+	}
+
+	++ batch.questions;
+	batch.hash = hash;
+
+	/* name tells packet and question, context has to agree */
+	if(sscanf(root, "q-%u-%u.", &packet, &question) == 2 && packet == *(const unsigned*)ctx &&
+	   packet < __TEST_BATCH_PACKETS && question < __TEST_BATCH_QUESTIONS) {
+		++ batch.seen[packet][question];
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+static void test_batch_record_handler(void* ctx, const mdns_answer_hdr_t* h, const char* root, const void* rdata, size_t len)
+{
+	++ batch.records;
+
+	if(batch.questions) {
+		++ batch.late;
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+static int test_batch(unsigned count, unsigned questions, unsigned* descents)
+{
+	static uint8_t bufs[__TEST_BATCH_PACKETS][MDNS_MAX_PACKET];
+	const void* ptrs[__TEST_BATCH_PACKETS];
+	size_t lens[__TEST_BATCH_PACKETS], results[__TEST_BATCH_PACKETS];
+	unsigned ids[__TEST_BATCH_PACKETS];
+	void* ctxs[__TEST_BATCH_PACKETS];
+	mdns_handlers_t handlers = {
+		.q = test_batch_query_handler,
+		.rr = test_batch_record_handler,
+	};
+	char name[MDNS_MAX_NAME];
+	struct in_addr in;
+	unsigned i, j;
+
+	memset(&batch, 0, sizeof(batch));
+
+	for(i = 0; i < count; ++ i) {
+		mdns_packet_init(bufs[i], sizeof(bufs[i]));
+
+		for(j = 0; j < questions; ++ j) {
+			snprintf(name, sizeof(name), "q-%u-%u.%s", i, j, MDNS_DOMAIN);
+
+			if(mdns_packet_add_query_in(bufs[i], sizeof(bufs[i]), MDNS_RECORD_A, name)) {
+				return(-1);
+			}
+		}
+
+		/* known answer follows questions */
+		in.s_addr = htonl(0xc0000200 + i);
+
+		if(mdns_packet_add_answer_in(bufs[i], sizeof(bufs[i]), 120, name, in)) {
+			return(-1);
+		}
+
+		ptrs[i] = bufs[i];
+		lens[i] = mdns_packet_size(bufs[i], sizeof(bufs[i]));
+		ids[i] = i;
+		ctxs[i] = &ids[i];
+	}
+
+	if(mdns_packet_process_batch(ptrs, lens, count, &handlers, ctxs, results) != count * questions) {
+		fprintf(stderr, "%s: not all questions are dispatched\n", __func__);
+		return(-1);
+	}
+
+	for(i = 0; i < count; ++ i) {
+		if(results[i] != lens[i]) {
+			fprintf(stderr, "%s: packet %u is parsed up to %zu of %zu\n", __func__, i, results[i], lens[i]);
+			return(-1);
+		}
+
+		for(j = 0; j < questions; ++ j) {
+			if(batch.seen[i][j] != 1) {
+				fprintf(stderr, "%s: question %u of packet %u is handled %u times\n", __func__, j, i, batch.seen[i][j]);
+				return(-1);
+			}
+		}
+	}
+
+	if(batch.questions != count * questions || batch.records != count) {
+		fprintf(stderr, "%s: %u questions and %u records are handled\n", __func__, batch.questions, batch.records);
+		return(-1);
+	}
+
+	*descents = batch.descents;
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int test_batch_order(void)
+{
+	unsigned descents;
+
+	if(test_batch(3, 5, &descents)) {
+		return(-1);
+	}
+
+	/* one group, records of all packets are handled before questions */
+	if(descents || batch.late) {
+		fprintf(stderr, "%s: %u questions out of hash order, %u records after questions\n", __func__, descents, batch.late);
+		return(-1);
+	}
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int test_batch_overflow(void)
+{
+	unsigned descents;
+
+	/* more questions than one group, at least 64 in each of full groups */
+	if(test_batch(__TEST_BATCH_PACKETS, __TEST_BATCH_QUESTIONS, &descents)) {
+		return(-1);
+	}
+
+	if(descents > __TEST_BATCH_PACKETS * __TEST_BATCH_QUESTIONS / 64) {
+		fprintf(stderr, "%s: %u questions out of hash order\n", __func__, descents);
+		return(-1);
+	}
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int test_defer(void)
+{
+	static uint8_t bufs[3][MDNS_MAX_PACKET];
+	static const char* const names[3] = {__TEST_HOST, __TEST_REVERSE, __TEST_HOST};
+	static const uint16_t types[3] = {MDNS_RECORD_A, MDNS_RECORD_PTR, MDNS_RECORD_A};
+	const mdns_hdr_t* hdr = (const mdns_hdr_t*)last;
+	mdns_responder_t* r;
+	uint64_t now = 1000;
+	unsigned i, before;
+	int res = -1;
+
+	if(!(r = malloc(sizeof(*r)))) {
+		return(-1);
+	}
+
+	if(test_responder(r, &now)) {
+		free(r);
+
+		return(-1);
+	}
+
+	now += 5000;
+	mdns_responder_timer(r, now);
+	before = sent;
+
+	/* packets are kept by caller until they are answered */
+	for(i = 0; i < 3; ++ i) {
+		mdns_packet_init(bufs[i], sizeof(bufs[i]));
+
+		if(mdns_packet_add_query_in(bufs[i], sizeof(bufs[i]), types[i], names[i])) {
+			goto out;
+		}
+
+		mdns_responder_family(r, AF_INET);
+		mdns_responder_defer(r, bufs[i], mdns_packet_size(bufs[i], sizeof(bufs[i])));
+	}
+
+	if(sent != before || r->deferred_count != 3) {
+		fprintf(stderr, "%s: queries aren't deferred\n", __func__);
+		goto out;
+	}
+
+	mdns_responder_process_deferred(r);
+
+	/* address asked twice is answered once */
+	if(sent != before + 1 || ntohs(hdr->an_cnt) != 2) {
+		fprintf(stderr, "%s: %u responses, last has %u answers\n", __func__, sent - before, ntohs(hdr->an_cnt));
+		goto out;
+	}
+
+	res = 0;
+
+out:
+	mdns_responder_free(r);
+	free(r);
+
+	return(res);
+}
+
+/** packet with compressed names in all sections */
+static const uint8_t test_compressed[] = {
+	/* query with known answer, authority and additional records */
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x01, 0x00, 0x01, 0x00, 0x01,
+	/* 12: _http._tcp.local. PTR, local. is at 23 */
+	0x05, '_', 'h', 't', 't', 'p', 0x04, '_', 't', 'c', 'p', 0x05, 'l', 'o', 'c', 'a', 'l', 0x00,
+	0x00, 0x0c, 0x00, 0x01,
+	/* 34: answer, owner and rdata point to question */
+	0xc0, 0x0c, 0x00, 0x0c, 0x00, 0x01, 0x00, 0x00, 0x11, 0x94, 0x00, 0x06,
+	0x03, 'w', 'e', 'b', 0xc0, 0x0c,
+	/* 52: authority, owner points to rdata of answer at 46 */
+	0xc0, 0x2e, 0x00, 0x21, 0x00, 0x01, 0x00, 0x00, 0x00, 0x78, 0x00, 0x0d,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x50, 0x04, 'h', 'o', 's', 't', 0xc0, 0x17,
+	/* 77: additional, owner points to target of SRV at 70 */
+	0xc0, 0x46, 0x00, 0x01, 0x80, 0x01, 0x00, 0x00, 0x00, 0x78, 0x00, 0x04,
+	0xc0, 0x00, 0x02, 0x02,
+};
+
+/*------------------------------------------------------------------------*/
+
+static int test_desc(const mdns_rr_desc_t* rr, const char* name, const char* target, uint16_t type, uint16_t a_class, uint32_t ttl, uint16_t rd_off, uint16_t rd_len)
+{
+	if(strcmp(rr->name, name) || rr->hash != mdns_name_hash(name) || rr->type != type || rr->class != a_class ||
+	   rr->ttl != ttl || rr->rd_off != rd_off || rr->rd_len != rd_len ||
+	   (target ? !rr->target || strcmp(rr->target, target) : rr->target != NULL)) {
+		fprintf(stderr, "test_decode: %s type %u class 0x%04x ttl %u rdata %u+%u target %s is decoded wrong\n",
+			rr->name, rr->type, rr->class, rr->ttl, rr->rd_off, rr->rd_len, rr->target ? rr->target : "-");
+		return(-1);
+	}
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int test_decode(void)
+{
+	static void* mem[128];
+	mdns_decoded_t d;
+	mdns_arena_t a;
+
+	mdns_arena_init(&a, mem, sizeof(mem));
+
+	if(mdns_packet_decode(test_compressed, sizeof(test_compressed), &a, &d)) {
+		fprintf(stderr, "%s: packet isn't decoded\n", __func__);
+		return(-1);
+	}
+
+	if(d.qd_cnt != 1 || d.an_cnt != 1 || d.ns_cnt != 1 || d.ar_cnt != 1) {
+		fprintf(stderr, "%s: %u/%u/%u/%u descriptors\n", __func__, d.qd_cnt, d.an_cnt, d.ns_cnt, d.ar_cnt);
+		return(-1);
+	}
+
+	/* questions, then records of all sections */
+	if(test_desc(&d.rrs[0], "_http._tcp.local.", NULL, MDNS_RECORD_PTR, MDNS_CLASS_IN, 0, 0, 0) ||
+	   test_desc(&d.rrs[1], "_http._tcp.local.", "web._http._tcp.local.", MDNS_RECORD_PTR, MDNS_CLASS_IN, 4500, 46, 6) ||
+	   test_desc(&d.rrs[2], "web._http._tcp.local.", "host.local.", MDNS_RECORD_SRV, MDNS_CLASS_IN, 120, 64, 13) ||
+	   test_desc(&d.rrs[3], "host.local.", NULL, MDNS_RECORD_A, MDNS_CLASS_IN | MDNS_CLASS_FLUSH, 120, 89, 4)) {
+		return(-1);
+	}
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int test_decode_full(void)
+{
+	static void* mem[128];
+	mdns_decoded_t d;
+	mdns_arena_t a;
+	size_t size, used;
+	void* mark;
+
+	/* arena of each smaller size fails and is left as before */
+	for(size = 0; size <= sizeof(mem); size += sizeof(void*)) {
+		mdns_arena_init(&a, mem, size);
+
+		mark = mdns_arena_alloc(&a, 1);
+		used = a.used;
+
+		if(!mdns_packet_decode(test_compressed, sizeof(test_compressed), &a, &d)) {
+			break;
+		}
+
+		if(a.used != used) {
+			fprintf(stderr, "%s: failed decode keeps %zu bytes of %zu\n", __func__, a.used - used, size);
+			return(-1);
+		}
+
+		/* arena is usable after failure */
+		mdns_arena_reset(&a);
+
+		if(size && (!mark || mdns_arena_alloc(&a, size) != mem || mdns_arena_alloc(&a, 1))) {
+			fprintf(stderr, "%s: arena of %zu bytes is broken after failure\n", __func__, size);
+			return(-1);
+		}
+	}
+
+	if(size > sizeof(mem) || size < 4 * sizeof(mdns_rr_desc_t)) {
+		fprintf(stderr, "%s: packet is decoded into %zu bytes\n", __func__, size);
+		return(-1);
+	}
+
+	return(0);
+}
+
+static int test_json_utf8(void)
+{
+	static const uint8_t txt[] = "\x04" "a=\xc3\xa9" "\x03" "b=\xff" "\x03" "c=\xc3" "\x05" "d=\xed\xa0\x80" "\x05" "e=\xe2\x82\xac";
+	static const char* const expected[] = {
+		"\"a=\xc3\xa9\"", "\"b=\\u00ff\"", "\"c=\\u00c3\"", "\"d=\\u00ed\\u00a0\\u0080\"", "\"e=\xe2\x82\xac\"",
+	};
+	uint8_t buf[MDNS_MAX_PACKET];
+	char text[4096];
+	mdns_json_source_t src;
+	mdns_dump_t d;
+	unsigned i;
+
+	mdns_packet_init(buf, sizeof(buf));
+
+	if(mdns_packet_add_answer_rdata(buf, sizeof(buf), 120, __TEST_HOST, MDNS_RECORD_TEXT, txt, sizeof(txt) - 1)) {
+		return(-1);
+	}
+
+	memset(&src, 0, sizeof(src));
+	mdns_dump_init(&d, text, sizeof(text) - 1, -1);
+
+	if(mdns_json_packet(&d, NULL, &src, buf, mdns_packet_size(buf, sizeof(buf))) != 1) {
+		fprintf(stderr, "%s: record isn't written\n", __func__);
+		return(-1);
+	}
+
+	text[d.len] = 0;
+
+	/* valid sequences are kept, any byte of invalid one is escaped */
+	for(i = 0; i < sizeof(expected) / sizeof(expected[0]); ++ i) {
+		if(!strstr(text, expected[i])) {
+			fprintf(stderr, "%s: %s isn't found in %s", __func__, expected[i], text);
+			return(-1);
+		}
+	}
+
+	return(0);
+}
+
+static int test_overload_drops(void)
+{
+	mdns_overload_t o;
+
+	mdns_overload_init(&o);
+
+	/* counters of sockets are independent, they don't look like wraps */
+	mdns_overload_drops(&o, 0, 5, 1000);
+	mdns_overload_drops(&o, 1, 3, 1000);
+	mdns_overload_drops(&o, 0, 5, 1000);
+	mdns_overload_drops(&o, 1, 4, 1000);
+
+	if(o.stats.drops != 9) {
+		fprintf(stderr, "%s: %lu drops are counted instead of 9\n", __func__, o.stats.drops);
+		return(-1);
+	}
+
+	return(0);
+}
+
+#ifdef MDNS_STATIC
+static size_t test_pool_used(void)
+{
+	char line[256], name[32];
+	size_t size, used = 0;
+	FILE* f;
+
+	if(!(f = tmpfile())) {
+		return(0);
+	}
+
+	mdns_pool_report(f);
+	rewind(f);
+
+	while(fgets(line, sizeof(line), f)) {
+		if(sscanf(line, "pool %31[^:]: size %zu, used %zu", name, &size, &used) == 3 && !strcmp(name, "records")) {
+			break;
+		}
+	}
+
+	fclose(f);
+
+	return(used);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int test_pool_realloc(void)
+{
+	void *a, *b, *c;
+	size_t before;
+
+	before = test_pool_used();
+
+	/* freed neighbour is merged, but it is too small to grow in place */
+	a = mdns_pool_alloc(MDNS_POOL_RECORDS, 16);
+	b = mdns_pool_alloc(MDNS_POOL_RECORDS, 40);
+	c = mdns_pool_alloc(MDNS_POOL_RECORDS, 16);
+	mdns_pool_free(b);
+
+	if(!a || !b || !c || !(a = mdns_pool_realloc(MDNS_POOL_RECORDS, a, 200))) {
+		return(-1);
+	}
+
+	/* shrink and grow in place */
+	if(!(a = mdns_pool_realloc(MDNS_POOL_RECORDS, a, 20)) || !(a = mdns_pool_realloc(MDNS_POOL_RECORDS, a, 150))) {
+		return(-1);
+	}
+
+	mdns_pool_free(a);
+	mdns_pool_free(c);
+
+	if(test_pool_used() != before) {
+		fprintf(stderr, "%s: %zu bytes are used instead of %zu\n", __func__, test_pool_used(), before);
+		return(-1);
+	}
+
+	return(0);
+}
+#endif
+
+static int test_reflect_send(void* ctx, unsigned iface, const void* buf, size_t len)
+{
+	++ reflected.count;
+	reflected.iface = iface;
+	reflected.len = len < sizeof(reflected.buf) ? len : sizeof(reflected.buf);
+	memcpy(reflected.buf, buf, reflected.len);
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+static size_t test_reflect_ptr(uint8_t* buf, const char* type, const char* instance, uint32_t ttl)
+{
+	mdns_packet_init(buf, MDNS_MAX_PACKET);
+
+	if(mdns_packet_add_answer_in_ptr(buf, MDNS_MAX_PACKET, ttl, type, instance)) {
+		return(0);
+	}
+
+	return(mdns_packet_size(buf, MDNS_MAX_PACKET));
+}
+
+/*------------------------------------------------------------------------*/
+
+static int test_reflector(void)
+{
+	uint8_t buf[MDNS_MAX_PACKET], echo[MDNS_MAX_PACKET];
+	mdns_reflector_t* x;
+	size_t len, echo_len;
+	int res = -1;
+
+	if(!(x = malloc(sizeof(*x)))) {
+		return(-1);
+	}
+
+	memset(&reflected, 0, sizeof(reflected));
+	mdns_reflector_init(x, 2, test_reflect_send, NULL);
+
+	if(mdns_reflector_type(x, "_ipp._tcp.local.") ||
+	   !(len = test_reflect_ptr(buf, "_ipp._tcp.local.", "printer._ipp._tcp.local.", 4500))) {
+		goto out;
+	}
+
+	mdns_reflector_process(x, 0, buf, len, 1000);
+
+	if(reflected.count != 1 || reflected.iface != 1 || x->stats.forwarded != 1) {
+		fprintf(stderr, "%s: record isn't forwarded to other interface\n", __func__);
+		goto out;
+	}
+
+	/* the copy comes back on egress interface within interval */
+	echo_len = reflected.len;
+	memcpy(echo, reflected.buf, echo_len);
+	mdns_reflector_process(x, 1, echo, echo_len, 1500);
+
+	if(reflected.count != 1 || x->stats.duplicates != 1) {
+		fprintf(stderr, "%s: reflected copy isn't a duplicate\n", __func__);
+		goto out;
+	}
+
+	/* goodbye differs from live record */
+	if(!(len = test_reflect_ptr(buf, "_ipp._tcp.local.", "printer._ipp._tcp.local.", 0))) {
+		goto out;
+	}
+
+	mdns_reflector_process(x, 0, buf, len, 1600);
+
+	if(reflected.count != 2 || x->stats.forwarded != 2 || x->stats.duplicates != 1) {
+		fprintf(stderr, "%s: goodbye isn't forwarded\n", __func__);
+		goto out;
+	}
+
+	/* other service types stay on their link */
+	if(!(len = test_reflect_ptr(buf, "_http._tcp.local.", "web._http._tcp.local.", 4500))) {
+		goto out;
+	}
+
+	mdns_reflector_process(x, 0, buf, len, 1700);
+
+	if(reflected.count != 2 || x->stats.filtered != 1) {
+		fprintf(stderr, "%s: record of other type isn't filtered\n", __func__);
+		goto out;
+	}
+
+	res = 0;
+
+out:
+	free(x);
+
+	return(res);
+}
+
+/*------------------------------------------------------------------------*/
+
+int main(int argc, char* argv[])
+{
+	static const struct {
+		const char* name;
+		int (*run)(void);
+	} tests[] = {
+		{"family_limit", test_family_limit},
+		{"batch_order", test_batch_order},
+		{"batch_overflow", test_batch_overflow},
+		{"defer", test_defer},
+		{"decode", test_decode},
+		{"decode_full", test_decode_full},
+		{"json_utf8", test_json_utf8},
+		{"overload_drops", test_overload_drops},
+		{"reflector", test_reflector},
+#ifdef MDNS_STATIC
+		{"pool_realloc", test_pool_realloc},
+#endif
+	};
+	unsigned i, failed = 0;
+	int res;
+
+	for(i = 0; i < sizeof(tests) / sizeof(tests[0]); ++ i) {
+		if((res = tests[i].run())) {
+			++ failed;
+		}
+
+		printf("%s: %s\n", tests[i].name, res ? "FAILED" : "ok");
+	}
+
+	printf("tests: %u run, %u failed\n", i, failed);
+
+	return(failed ? EXIT_FAILURE : EXIT_SUCCESS);
+}
@@ -0,0 +1,484 @@
+/**
+ * @file uring.c
+ *
+ * yamdns -- yet another very simple mdns.
+ * Copyright (C) 2013  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#include "uring.h"
+
+/*------------------------------------------------------------------------*/
+
+/** group of provided buffers */
+#define __MDNS_URING_BGID 0
+
+/** index of socket in registered files */
+#define __MDNS_URING_SOCKET 0
+
+/** user data of multishot recvmsg */
+#define __MDNS_URING_RECV 0xffffffffffffffffULL
+
+/*------------------------------------------------------------------------*/
+
+static int mdns_ring_setup(mdns_ring_t* ring, unsigned entries, unsigned cq_entries, int sockfd)
+{
+	struct io_uring_params p;
+	uint8_t *sq, *cq;
+
+	memset(ring, 0, sizeof(*ring));
+	memset(&p, 0, sizeof(p));
+
+	p.flags = IORING_SETUP_CQSIZE;
+	p.cq_entries = cq_entries;
+
+	if((ring->fd = syscall(__NR_io_uring_setup, entries, &p)) == -1) {
+		return(-1);
+	}
+
+	ring->sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	ring->cq_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	ring->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+
+	if((ring->sq = mmap(NULL, ring->sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING)) == MAP_FAILED) {
+		ring->sq = NULL;
+		return(-1);
+	}
+
+	if((ring->cq = mmap(NULL, ring->cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING)) == MAP_FAILED) {
+		ring->cq = NULL;
+		return(-1);
+	}
+
+	if((ring->sqes = mmap(NULL, ring->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES)) == MAP_FAILED) {
+		ring->sqes = NULL;
+		return(-1);
+	}
+
+	sq = ring->sq;
+	cq = ring->cq;
+
+	ring->sq_head = (unsigned*)(sq + p.sq_off.head);
+	ring->sq_tail = (unsigned*)(sq + p.sq_off.tail);
+	ring->sq_array = (unsigned*)(sq + p.sq_off.array);
+	ring->sq_mask = *(unsigned*)(sq + p.sq_off.ring_mask);
+	ring->tail = *ring->sq_tail;
+
+	ring->cq_head = (unsigned*)(cq + p.cq_off.head);
+	ring->cq_tail = (unsigned*)(cq + p.cq_off.tail);
+	ring->cq_mask = *(unsigned*)(cq + p.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe*)(cq + p.cq_off.cqes);
+
+	/* socket is referenced by index, without lookup of descriptor */
+	if(syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_FILES, &sockfd, 1) == -1) {
+		return(-1);
+	}
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_ring_free(mdns_ring_t* ring)
+{
+	if(ring->sqes) {
+		munmap(ring->sqes, ring->sqes_len);
+	}
+
+	if(ring->cq) {
+		munmap(ring->cq, ring->cq_len);
+	}
+
+	if(ring->sq) {
+		munmap(ring->sq, ring->sq_len);
+	}
+
+	if(ring->fd != -1) {
+		close(ring->fd);
+	}
+
+	memset(ring, 0, sizeof(*ring));
+	ring->fd = -1;
+}
+
+/*------------------------------------------------------------------------*/
+
+static struct io_uring_sqe* mdns_ring_sqe(mdns_ring_t* ring)
+{
+	struct io_uring_sqe* sqe;
+	unsigned idx;
+
+	/* submission queue is full */
+	if(ring->tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) > ring->sq_mask) {
+		return(NULL);
+	}
+
+	idx = ring->tail ++ & ring->sq_mask;
+
+	sqe = &ring->sqes[idx];
+	memset(sqe, 0, sizeof(*sqe));
+
+	ring->sq_array[idx] = idx;
+
+	return(sqe);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int mdns_ring_submit(mdns_ring_t* ring, unsigned wait)
+{
+	unsigned count;
+	int res;
+
+	count = ring->tail - *ring->sq_tail;
+
+	/* publish prepared entries */
+	__atomic_store_n(ring->sq_tail, ring->tail, __ATOMIC_RELEASE);
+
+	do {
+		res = syscall(__NR_io_uring_enter, ring->fd, count, wait, wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+	} while(res == -1 && errno == EINTR);
+
+	return(res);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_uring_provide(mdns_uring_t* u, uint16_t bid)
+{
+	struct io_uring_buf* b;
+
+	b = &u->br->bufs[u->br_tail & (MDNS_URING_BUFS - 1)];
+	b->addr = (uintptr_t)(u->bufs + bid * MDNS_URING_BUF_SIZE);
+	b->len = MDNS_URING_BUF_SIZE;
+	b->bid = bid;
+
+	++ u->br_tail;
+}
+
+/*------------------------------------------------------------------------*/
+
+static int mdns_uring_arm(mdns_uring_t* u)
+{
+	struct io_uring_sqe* sqe;
+
+	if(!(sqe = mdns_ring_sqe(&u->rx))) {
+		return(-1);
+	}
+
+	sqe->opcode = IORING_OP_RECVMSG;
+	sqe->fd = __MDNS_URING_SOCKET;
+	sqe->flags = IOSQE_FIXED_FILE | IOSQE_BUFFER_SELECT;
+	sqe->ioprio = IORING_RECV_MULTISHOT;
+	sqe->addr = (uintptr_t)&u->rmsg;
+	sqe->len = 1;
+	sqe->buf_group = __MDNS_URING_BGID;
+	sqe->user_data = __MDNS_URING_RECV;
+
+	return(mdns_ring_submit(&u->rx, 0) == -1 ? -1 : 0);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int mdns_uring_armed(mdns_uring_t* u)
+{
+	const struct io_uring_cqe* cqe;
+	unsigned head;
+
+	head = *u->rx.cq_head;
+
+	if(head == __atomic_load_n(u->rx.cq_tail, __ATOMIC_ACQUIRE)) {
+		return(0);
+	}
+
+	cqe = &u->rx.cqes[head & u->rx.cq_mask];
+
+	/* kernel before 6.0 rejects multishot flag at once */
+	if(!(cqe->flags & IORING_CQE_F_MORE) && cqe->res < 0) {
+		errno = -cqe->res;
+
+		return(-1);
+	}
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+int mdns_uring_init(mdns_uring_t* u, int sockfd)
+{
+	struct io_uring_buf_reg reg;
+	size_t ring_len;
+	uint16_t i;
+
+	memset(u, 0, sizeof(*u));
+	u->rx.fd = -1;
+	u->tx.fd = -1;
+
+	/* multishot receive produces completion per buffer */
+	if(mdns_ring_setup(&u->rx, 4, MDNS_URING_BUFS * 2, sockfd) ||
+	   mdns_ring_setup(&u->tx, MDNS_BATCH_MAX, MDNS_BATCH_MAX * 2, sockfd)) {
+		goto error;
+	}
+
+	/* ring of provided buffers must be page aligned, buffers follow it */
+	ring_len = (MDNS_URING_BUFS * sizeof(struct io_uring_buf) + getpagesize() - 1) & ~(getpagesize() - 1);
+	u->br_len = ring_len + MDNS_URING_BUFS * MDNS_URING_BUF_SIZE;
+
+	if((u->br = mmap(NULL, u->br_len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)) == MAP_FAILED) {
+		u->br = NULL;
+		goto error;
+	}
+
+	u->bufs = (uint8_t*)u->br + ring_len;
+
+	memset(&reg, 0, sizeof(reg));
+	reg.ring_addr = (uintptr_t)u->br;
+	reg.ring_entries = MDNS_URING_BUFS;
+	reg.bgid = __MDNS_URING_BGID;
+
+	if(syscall(__NR_io_uring_register, u->rx.fd, IORING_REGISTER_PBUF_RING, &reg, 1) == -1) {
+		goto error;
+	}
+
+	for(i = 0; i < MDNS_URING_BUFS; ++ i) {
+		mdns_uring_provide(u, i);
+	}
+
+	__atomic_store_n(&u->br->tail, u->br_tail, __ATOMIC_RELEASE);
+
+	/* each buffer has header, source address, drop counter and packet */
+	u->rmsg.msg_namelen = sizeof(struct sockaddr_in);
+	u->rmsg.msg_controllen = CMSG_SPACE(sizeof(uint32_t)) + CMSG_SPACE(sizeof(struct timespec));
+
+	u->to.sin_family = AF_INET;
+	u->to.sin_port = htons(__MDNS_PORT);
+	u->to.sin_addr = __MDNS_MC_GROUP;
+
+	if(mdns_uring_arm(u) || mdns_uring_armed(u)) {
+		goto error;
+	}
+
+	return(0);
+
+error:
+	mdns_uring_free(u);
+
+	return(-1);
+}
+
+/*------------------------------------------------------------------------*/
+
+void mdns_uring_free(mdns_uring_t* u)
+{
+	/* closing of ring cancels pending receive */
+	mdns_ring_free(&u->rx);
+	mdns_ring_free(&u->tx);
+
+	if(u->br) {
+		munmap(u->br, u->br_len);
+		u->br = NULL;
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+static void mdns_uring_control(mdns_uring_t* u, const struct io_uring_recvmsg_out* out)
+{
+	struct cmsghdr* cmsg;
+	struct msghdr msg;
+
+	/* control data follows source address */
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_control = (uint8_t*)(out + 1) + u->rmsg.msg_namelen;
+	msg.msg_controllen = out->controllen;
+
+	for(cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+		if(cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL) {
+			memcpy(&u->drops, CMSG_DATA(cmsg), sizeof(u->drops));
+		} else if(cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_TIMESTAMPNS) {
+			memcpy(&u->stamp, CMSG_DATA(cmsg), sizeof(u->stamp));
+		}
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+int mdns_uring_recv(mdns_uring_t* u, mdns_uring_handler handler, mdns_uring_done_handler done, void* ctx)
+{
+	const struct io_uring_recvmsg_out* out;
+	const struct io_uring_cqe* cqe;
+	unsigned head, tail;
+	int count = 0, rearm = 0, fatal = 0;
+	size_t offset, len;
+	uint16_t bid;
+
+	head = *u->rx.cq_head;
+	tail = __atomic_load_n(u->rx.cq_tail, __ATOMIC_ACQUIRE);
+
+	for(; head != tail; ++ head) {
+		cqe = &u->rx.cqes[head & u->rx.cq_mask];
+
+		/* multishot is stopped when buffers are exhausted, other errors aren't recoverable */
+		if(!(cqe->flags & IORING_CQE_F_MORE)) {
+			if(cqe->res < 0 && cqe->res != -ENOBUFS) {
+				fatal = -cqe->res;
+			}
+
+			rearm = 1;
+		}
+
+		if(!(cqe->flags & IORING_CQE_F_BUFFER)) {
+			continue;
+		}
+
+		bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+
+		if(cqe->res > 0) {
+			out = (const struct io_uring_recvmsg_out*)(u->bufs + bid * MDNS_URING_BUF_SIZE);
+			offset = sizeof(*out) + u->rmsg.msg_namelen + u->rmsg.msg_controllen;
+			len = cqe->res - offset;
+
+			/* truncated packets are dropped */
+			if(cqe->res >= offset && !(out->flags & MSG_TRUNC) && out->payloadlen <= len) {
+				mdns_uring_control(u, out);
+
+				handler(ctx, (const uint8_t*)out + offset, out->payloadlen,
+					(const struct sockaddr_in*)(out + 1));
+				++ count;
+			}
+		}
+
+		mdns_uring_provide(u, bid);
+	}
+
+	/* kernel doesn't see provided buffers until tail is stored */
+	if(done && count) {
+		done(ctx);
+	}
+
+	__atomic_store_n(&u->br->tail, u->br_tail, __ATOMIC_RELEASE);
+	__atomic_store_n(u->rx.cq_head, head, __ATOMIC_RELEASE);
+
+	if(fatal) {
+		errno = fatal;
+
+		return(-1);
+	}
+
+	if(rearm && mdns_uring_arm(u)) {
+		return(-1);
+	}
+
+	return(count);
+}
+
+/*------------------------------------------------------------------------*/
+
+int mdns_uring_add(mdns_uring_t* u, const void* buf, size_t len)
+{
+	struct io_uring_sqe* sqe;
+
+	if(len > sizeof(u->out[0])) {
+		return(-1);
+	}
+
+	if(u->count == MDNS_BATCH_MAX && mdns_uring_flush(u) == -1) {
+		return(-1);
+	}
+
+	if(!(sqe = mdns_ring_sqe(&u->tx))) {
+		return(-1);
+	}
+
+	memcpy(u->out[u->count], buf, len);
+	u->iov[u->count].iov_base = u->out[u->count];
+	u->iov[u->count].iov_len = len;
+
+	memset(&u->msgs[u->count], 0, sizeof(u->msgs[0]));
+	u->msgs[u->count].msg_name = &u->to;
+	u->msgs[u->count].msg_namelen = sizeof(u->to);
+	u->msgs[u->count].msg_iov = &u->iov[u->count];
+	u->msgs[u->count].msg_iovlen = 1;
+
+	sqe->opcode = IORING_OP_SENDMSG;
+	sqe->fd = __MDNS_URING_SOCKET;
+	sqe->flags = IOSQE_FIXED_FILE;
+	sqe->addr = (uintptr_t)&u->msgs[u->count];
+	sqe->len = 1;
+	sqe->user_data = u->count;
+
+	++ u->count;
+
+	return(len);
+}
+
+/*------------------------------------------------------------------------*/
+
+int mdns_uring_flush(mdns_uring_t* u)
+{
+	const struct io_uring_cqe* cqe;
+	unsigned head, tail, done;
+	int sent = 0;
+
+	if(!u->count) {
+		return(0);
+	}
+
+	/* buffers are reused after completion of the whole batch */
+	if(mdns_ring_submit(&u->tx, u->count) == -1) {
+		u->tx.tail = *u->tx.sq_tail;
+		u->count = 0;
+
+		return(-1);
+	}
+
+	head = *u->tx.cq_head;
+
+	for(done = 0; done < u->count;) {
+		tail = __atomic_load_n(u->tx.cq_tail, __ATOMIC_ACQUIRE);
+
+		/* some sends are still in flight */
+		if(head == tail) {
+			if(syscall(__NR_io_uring_enter, u->tx.fd, 0, u->count - done, IORING_ENTER_GETEVENTS, NULL, 0) == -1 && errno != EINTR) {
+				break;
+			}
+
+			continue;
+		}
+
+		for(; head != tail; ++ head, ++ done) {
+			cqe = &u->tx.cqes[head & u->tx.cq_mask];
+
+			if(cqe->res >= 0) {
+				++ sent;
+			}
+		}
+	}
+
+	__atomic_store_n(u->tx.cq_head, head, __ATOMIC_RELEASE);
+
+	u->count = 0;
+
+	return(sent);
+}
@@ -19,12 +19,15 @@
  */
 
 #include <stdio.h>
+#include <ctype.h>
 #include <string.h>
+#include <unistd.h>
 #include <arpa/inet.h>
 
 #include <yamdns/yamdns.h>
 
 #include "dump.h"
+#include "name.h"
 
 /*------------------------------------------------------------------------*/
 
@@ -47,6 +50,12 @@ const char* mdns_str_type(mdns_record_type_t rec)
 		case MDNS_RECORD_SRV:
 			return("SRV");
 
+		case MDNS_RECORD_NSEC:
+			return("NSEC");
+
+		case MDNS_RECORD_ANY:
+			return("ANY");
+
 		default:
 			return("Unknown");
 	}
@@ -74,22 +83,75 @@ int mdns_format_address_name(char* s, size_t len, struct in_addr in)
 
 /*------------------------------------------------------------------------*/
 
+int mdns_format_address6_name(char* s, size_t len, const struct in6_addr* in6)
+{
+	static const char digits[] = "0123456789abcdef";
+	int i;
+
+	if(len < MDNS_MAX_ADDRESS6_NAME) {
+		return(-1);
+	}
+
+	/* nibbles from the last one */
+	for(i = 15; i >= 0; -- i) {
+		*s ++ = digits[in6->s6_addr[i] & 0x0f];
+		*s ++ = '.';
+		*s ++ = digits[in6->s6_addr[i] >> 4];
+		*s ++ = '.';
+	}
+
+	strcpy(s, MDNS_QUERY_RESOLVE_ADDRESS6);
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+/** initial value of FNV-1a hash */
+#define __MDNS_HASH_INIT 0x811c9dc5
+
+/** one step of case insensitive FNV-1a hash */
+#define __MDNS_HASH_STEP(hash, c) (((hash) ^ (uint8_t)tolower(c)) * 0x01000193)
+
+uint32_t mdns_name_hash(const char* name)
+{
+	uint32_t hash = __MDNS_HASH_INIT;
+	const char* pos;
+
+	for(pos = name; *pos; ++ pos) {
+		hash = __MDNS_HASH_STEP(hash, *pos);
+	}
+
+	/* hash is always calculated with last dot */
+	if(pos == name || pos[-1] != '.') {
+		hash = __MDNS_HASH_STEP(hash, '.');
+	}
+
+	return(hash);
+}
+
+/*------------------------------------------------------------------------*/
+
 static const void* mdns_name_unpack(const uint8_t* buf, const uint8_t* pos, const uint8_t* end, char* name, size_t len)
 {
-	char label[MDNS_MAX_LABEL_NAME];
 	const uint8_t* cur;
+	size_t n = 0, copy;
 
 	*name = 0;
 	cur = pos;
 
 	/* parse name */
-	while(*cur && cur < end) {
+	while(cur < end && *cur) {
 		/* check if label is compressed */
 		if((*cur & 0xc0) == 0xc0) {
 			uint16_t index;
 
+			if(cur + 2 > end) {
+				return(NULL);
+			}
+
 			/* calculate index of label */
-			index = ntohs(*(uint16_t*)cur) & 0x3fff;
+			index = ((cur[0] << 8) | cur[1]) & 0x3fff;
 
 			/* check for invalid index */
 			if(&buf[index] >= cur || &buf[index] >= pos) {
@@ -100,22 +162,21 @@ static const void* mdns_name_unpack(const uint8_t* buf, const uint8_t* pos, cons
 		}
 
 		/* check length of label */
-		if(*cur > 0x3f) {
+		if(*cur > 0x3f || cur + *cur + 1 > end) {
 			/* invalid length, failed */
 			return(NULL);
 		}
 
-		/* safety copying label */
-		memcpy(label, cur + 1, *cur);
-		label[*cur] = 0;
+		/* add label and dot, name is truncated by its buffer */
+		copy = *cur < len - n - 1 ? *cur : len - n - 1;
+		memcpy(name + n, cur + 1, copy);
+		n += copy;
 
-		/* add label */
-		strncat(name, label, len - strlen(name) - 1);
-		name[len - 1] = 0;
+		if(n < len - 1) {
+			name[n ++] = '.';
+		}
 
-		/* dot */
-		strncat(name, ".", len - strlen(name) - 1);
-		name[len - 1] = 0;
+		name[n] = 0;
 
 		/* next chunk name */
 		cur += *cur + 1;
@@ -148,49 +209,24 @@ static const void* mdns_name_unpack(const uint8_t* buf, const uint8_t* pos, cons
 
 static void* mdns_name_pack(void* buf, size_t* len, const char* name)
 {
-	const char* label;
-	size_t namelen;
-	uint8_t* pos;
+	size_t res;
 
 	/* TODO: implement compress */
-	pos = buf;
-	namelen = strlen(name) + 1;
-
-	/* check for buffer length */
-	if(namelen > *len) {
+	if(!(res = mdns_name_wire(buf, *len, name))) {
 		return(NULL);
 	}
 
 	/* update length, descrement length of buffer */
-	*len -= namelen;
-
-	while((label = strchr(name, '.'))) {
-		/* put label length */
-		*pos = label - name;
-
-		/* put label */
-		memcpy(pos + 1, name, *pos);
-
-		/* moving next */
-		name = label + 1;
-		pos += *pos + 1;
-	}
-
-	/* if user forget about last dot */
-	if(*name) {
-		*pos = namelen - ((uintptr_t)pos - (uintptr_t)buf + 1);
+	*len -= res;
 
-		/* put label */
-		memcpy(pos + 1, name, *pos);
-
-		/* moving next */
-		pos += *pos + 1;
-	}
+	return((uint8_t*)buf + res);
+}
 
-	/* terminate packed name by 0 */
-	*pos ++ = 0;
+/*------------------------------------------------------------------------*/
 
-	return(pos);
+size_t mdns_name_encode(void* buf, size_t len, const char* name)
+{
+	return(mdns_name_wire(buf, len, name));
 }
 
 /*------------------------------------------------------------------------*/
@@ -236,83 +272,44 @@ int mdns_packet_is_valid(void* buf, size_t len)
 
 /*------------------------------------------------------------------------*/
 
-size_t mdns_packet_process(const void* buf, size_t len, const mdns_handlers_t* handlers, void* ctx)
+static const uint8_t* mdns_packet_records(const void* buf, const uint8_t* pos, const uint8_t* end, const mdns_handlers_t* handlers, void* ctx, char* root)
 {
-	const mdns_hdr_t* hdr;
-	const mdns_query_hdr_t* query_hdr;
+	const mdns_hdr_t* hdr = buf;
 	const mdns_answer_hdr_t* answer_hdr;
-	const uint8_t *pos, *cur, *end;
-	char root[MDNS_MAX_NAME];
+	const uint8_t *cur, *next;
+	char target[MDNS_MAX_NAME];
 	mdns_record_srv_t* srv;
 	int i;
 
-	pos = buf;
-	hdr = buf;
-	end = pos + len;
-
-	/* length of packet is to small for mDNS*/
-	if(len < sizeof(*hdr)) {
-		goto err;
-	}
-
-	pos += sizeof(mdns_hdr_t);
-
-	/* check for range */
-	if(pos >= end) {
-		goto err;
-	}
-
-	/* check for queries */
-	if(hdr->qd_cnt) {
-		/* parse queries */
-		for(i = ntohs(hdr->qd_cnt); i > 0; -- i) {
-			pos = mdns_name_unpack(buf, pos, end, root, sizeof(root));
-
-			/* if failed to checkout root name from labels */
-			if(!pos) {
-				/* packet is invalid */
-				goto err;
-			}
-
-			query_hdr = (mdns_query_hdr_t*)pos;
-
-			/* moving next */
-			pos += sizeof(mdns_query_hdr_t);
-
-			/* check for range */
-			if(pos > end) {
-				goto err;
-			}
-
-			/* call query handler */
-			if(handlers->q) {
-				handlers->q(ctx, query_hdr, root);
-			}
-		}
-	}
-
-	/* check for answers */
-	if(hdr->an_cnt) {
-		/* parse answers */
-		for(i = ntohs(hdr->an_cnt); i > 0; -- i) {
-			pos = mdns_name_unpack(buf, pos, end, root, sizeof(root));
+	/* check for answers, authority and additional records */
+	if(hdr->an_cnt || hdr->ns_cnt || hdr->ar_cnt) {
+		/* records of all sections have the same format */
+		for(i = ntohs(hdr->an_cnt) + ntohs(hdr->ns_cnt) + ntohs(hdr->ar_cnt); i > 0; -- i) {
+			next = mdns_name_unpack(buf, pos, end, root, MDNS_MAX_NAME);
 
 			/* if failed to checkout owner from labels */
-			if(!pos) {
+			if(!next) {
 				/* packet is invalid */
 				goto err;
 			}
 
+			pos = next;
+
 			answer_hdr = (mdns_answer_hdr_t*)pos;
 
 			/* moving next */
 			pos += sizeof(mdns_answer_hdr_t);
 
 			/* check for range */
-			if(pos > end) {
+			if(pos > end || pos + ntohs(answer_hdr->rd_len) > end) {
 				goto err;
 			}
 
+			/* call handler of any record */
+			if(handlers->rr) {
+				handlers->rr(ctx, answer_hdr, root, pos, ntohs(answer_hdr->rd_len));
+			}
+
 			/* parse rdata */
 			switch(ntohs(answer_hdr->a_type)) {
 				case MDNS_RECORD_A: {
@@ -331,27 +328,51 @@ size_t mdns_packet_process(const void* buf, size_t len, const mdns_handlers_t* h
 					break;
 				}
 
+				case MDNS_RECORD_AAAA: {
+					cur = pos + sizeof(struct in6_addr);
+
+					/* check for range */
+					if(cur > end) {
+						goto err;
+					}
+
+					/* call a type handler */
+					if(handlers->aaaa) {
+						handlers->aaaa(ctx, answer_hdr, root, (struct in6_addr*)pos);
+					}
+
+					break;
+				}
+
 				case MDNS_RECORD_TEXT: {
-					char text[MDNS_MAX_NAME];
+					mdns_text_iter_t it;
+					mdns_text_t text;
+					const char* str;
+					size_t str_len;
+					int res;
 
-					cur = mdns_name_unpack(buf, pos, pos + ntohs(answer_hdr->rd_len), text, sizeof(text));
+					text.data = pos;
+					text.len = ntohs(answer_hdr->rd_len);
+					cur = pos + text.len;
 
-					/* check for range */
-					if(!cur || cur > end) {
+					/* strings must fill rdata exactly */
+					mdns_text_iter_init(&it, &text);
+
+					while((res = mdns_text_next(&it, &str, &str_len)) > 0);
+
+					if(res) {
 						goto err;
 					}
 
 					/* call text handler */
 					if(handlers->text) {
-						handlers->text(ctx, answer_hdr, root, text);
+						handlers->text(ctx, answer_hdr, root, &text);
 					}
 
 					break;
 				}
 
 				case MDNS_RECORD_PTR: {
-					char target[MDNS_MAX_NAME];
-
 					cur = mdns_name_unpack(buf, pos, pos + ntohs(answer_hdr->rd_len), target, sizeof(target));
 
 					/* check for range */
@@ -368,8 +389,6 @@ size_t mdns_packet_process(const void* buf, size_t len, const mdns_handlers_t* h
 				}
 
 				case MDNS_RECORD_SRV: {
-					char service[MDNS_MAX_NAME];
-
 					srv = (mdns_record_srv_t*)pos;
 					cur = pos + sizeof(mdns_record_srv_t);
 
@@ -378,141 +397,862 @@ size_t mdns_packet_process(const void* buf, size_t len, const mdns_handlers_t* h
 						goto err;
 					}
 
-					cur = mdns_name_unpack(buf, (void*)&srv->hostname, pos + ntohs(answer_hdr->rd_len), service, sizeof(service));
+					cur = mdns_name_unpack(buf, (void*)&srv->hostname, pos + ntohs(answer_hdr->rd_len), target, sizeof(target));
 
 					/* check for range */
 					if(!cur || cur > end) {
 						goto err;
 					}
 
-					/* call service handler */
-					if(handlers->srv) {
-						handlers->srv(ctx, answer_hdr, root, srv, service);
-					}
+					/* call service handler */
+					if(handlers->srv) {
+						handlers->srv(ctx, answer_hdr, root, srv, target);
+					}
+
+					break;
+				}
+
+				default: {
+					cur = pos + ntohs(answer_hdr->rd_len);
+
+					/* call raw handler */
+					if(handlers->raw) {
+						handlers->raw(ctx, answer_hdr, root, pos, ntohs(answer_hdr->rd_len));
+					}
+
+					break;
+				}
+			}
+
+			pos += ntohs(answer_hdr->rd_len);
+
+			/* check for range */
+			if(pos != cur || pos > end) {
+				goto err;
+			}
+		}
+	}
+
+
+err:
+	return(pos);
+}
+
+/*------------------------------------------------------------------------*/
+
+size_t mdns_packet_process(const void* buf, size_t len, const mdns_handlers_t* handlers, void* ctx)
+{
+	const mdns_hdr_t* hdr;
+	const mdns_query_hdr_t* query_hdr;
+	const uint8_t *pos, *next, *end;
+	char root[MDNS_MAX_NAME];
+	int i;
+
+	pos = buf;
+	hdr = buf;
+	end = pos + len;
+
+	/* length of packet is to small for mDNS*/
+	if(len < sizeof(*hdr)) {
+		goto err;
+	}
+
+	pos += sizeof(mdns_hdr_t);
+
+	/* check for range */
+	if(pos >= end) {
+		goto err;
+	}
+
+	/* check for queries */
+	if(hdr->qd_cnt) {
+		/* parse queries */
+		for(i = ntohs(hdr->qd_cnt); i > 0; -- i) {
+			next = mdns_name_unpack(buf, pos, end, root, sizeof(root));
+
+			/* if failed to checkout root name from labels */
+			if(!next) {
+				/* packet is invalid */
+				goto err;
+			}
+
+			pos = next;
+
+			query_hdr = (mdns_query_hdr_t*)pos;
+
+			/* moving next */
+			pos += sizeof(mdns_query_hdr_t);
+
+			/* check for range */
+			if(pos > end) {
+				goto err;
+			}
+
+			/* call query handler */
+			if(handlers->q) {
+				handlers->q(ctx, query_hdr, root);
+			}
+		}
+	}
+
+	/* parse answers, authority and additional records */
+	/* name buffer is shared to keep stack small */
+	pos = mdns_packet_records(buf, pos, end, handlers, ctx, root);
+
+err:
+	return((uintptr_t)pos - (uintptr_t)buf);
+}
+
+/*------------------------------------------------------------------------*/
+
+/** alignment of arena allocations */
+#define __MDNS_ARENA_ALIGN sizeof(void*)
+
+void mdns_arena_init(mdns_arena_t* a, void* buf, size_t size)
+{
+	a->buf = buf;
+	a->size = size;
+	a->used = 0;
+}
+
+/*------------------------------------------------------------------------*/
+
+void* mdns_arena_alloc(mdns_arena_t* a, size_t size)
+{
+	size_t pos;
+
+	pos = (a->used + __MDNS_ARENA_ALIGN - 1) & ~(__MDNS_ARENA_ALIGN - 1);
+
+	if(pos > a->size || size > a->size - pos) {
+		return(NULL);
+	}
+
+	a->used = pos + size;
+
+	return(a->buf + pos);
+}
+
+/*------------------------------------------------------------------------*/
+
+void mdns_arena_reset(mdns_arena_t* a)
+{
+	a->used = 0;
+}
+
+/*------------------------------------------------------------------------*/
+
+static const uint8_t* mdns_arena_name(mdns_arena_t* a, const uint8_t* buf, const uint8_t* pos, const uint8_t* end, const char** name)
+{
+	char* dst = (char*)a->buf + a->used;
+	size_t room = a->size - a->used;
+
+	if(room > MDNS_MAX_NAME) {
+		room = MDNS_MAX_NAME;
+	}
+
+	/* name is unpacked in place, only its length is taken */
+	if(!room || !(pos = mdns_name_unpack(buf, pos, end, dst, room))) {
+		return(NULL);
+	}
+
+	*name = dst;
+	a->used += strlen(dst) + 1;
+
+	/* name was cut by the end of arena */
+	if(a->used == a->size && room < MDNS_MAX_NAME) {
+		return(NULL);
+	}
+
+	return(pos);
+}
+
+/*------------------------------------------------------------------------*/
+
+int mdns_packet_decode(const void* buf, size_t len, mdns_arena_t* a, mdns_decoded_t* d)
+{
+	const mdns_hdr_t* hdr = buf;
+	const mdns_query_hdr_t* query_hdr;
+	const mdns_answer_hdr_t* answer_hdr;
+	const uint8_t *pos, *end;
+	mdns_rr_desc_t* rr;
+	size_t mark;
+	unsigned i, count;
+
+	if(len < sizeof(*hdr) || len > UINT16_MAX) {
+		return(-1);
+	}
+
+	mark = a->used;
+	pos = (const uint8_t*)buf + sizeof(*hdr);
+	end = (const uint8_t*)buf + len;
+
+	d->buf = buf;
+	d->len = len;
+	d->qd_cnt = ntohs(hdr->qd_cnt);
+	d->an_cnt = ntohs(hdr->an_cnt);
+	d->ns_cnt = ntohs(hdr->ns_cnt);
+	d->ar_cnt = ntohs(hdr->ar_cnt);
+	count = d->qd_cnt + d->an_cnt + d->ns_cnt + d->ar_cnt;
+
+	/* descriptors are contiguous, names follow them */
+	if(!(d->rrs = mdns_arena_alloc(a, count * sizeof(*d->rrs)))) {
+		goto err;
+	}
+
+	for(i = 0; i < count; ++ i) {
+		rr = &d->rrs[i];
+		rr->target = NULL;
+
+		if(!(pos = mdns_arena_name(a, buf, pos, end, &rr->name))) {
+			goto err;
+		}
+
+		rr->hash = mdns_name_hash(rr->name);
+
+		if(i < d->qd_cnt) {
+			query_hdr = (const mdns_query_hdr_t*)pos;
+			pos += sizeof(*query_hdr);
+
+			if(pos > end) {
+				goto err;
+			}
+
+			rr->type = ntohs(query_hdr->q_type);
+			rr->class = ntohs(query_hdr->q_class);
+			rr->ttl = 0;
+			rr->rd_off = 0;
+			rr->rd_len = 0;
+
+			continue;
+		}
+
+		answer_hdr = (const mdns_answer_hdr_t*)pos;
+		pos += sizeof(*answer_hdr);
+
+		if(pos > end || ntohs(answer_hdr->rd_len) > end - pos) {
+			goto err;
+		}
+
+		rr->type = ntohs(answer_hdr->a_type);
+		rr->class = ntohs(answer_hdr->a_class);
+		rr->ttl = ntohl(answer_hdr->a_ttl);
+		rr->rd_off = pos - (const uint8_t*)buf;
+		rr->rd_len = ntohs(answer_hdr->rd_len);
+
+		/* only names of rdata are unpacked, the rest is read from packet */
+		if(rr->type == MDNS_RECORD_PTR) {
+			if(!mdns_arena_name(a, buf, pos, pos + rr->rd_len, &rr->target)) {
+				goto err;
+			}
+		} else if(rr->type == MDNS_RECORD_SRV) {
+			if(rr->rd_len < sizeof(mdns_record_srv_t) ||
+				!mdns_arena_name(a, buf, pos + sizeof(mdns_record_srv_t), pos + rr->rd_len, &rr->target)) {
+				goto err;
+			}
+		}
+
+		pos += rr->rd_len;
+	}
+
+	return(0);
+
+err:
+	a->used = mark;
+
+	return(-1);
+}
+
+/*------------------------------------------------------------------------*/
+
+static const uint8_t* mdns_question_skip(const void* buf, const uint8_t* pos, const uint8_t* end, uint32_t* hash)
+{
+	const uint8_t* cur;
+	size_t len;
+	int jumps;
+
+	*hash = __MDNS_HASH_INIT;
+	cur = pos;
+	jumps = 0;
+
+	/* hash labels as they are */
+	while(cur < end && *cur) {
+		/* follow compressed label, only backward */
+		if((*cur & 0xc0) == 0xc0) {
+			if(cur + 1 >= end || ++ jumps > MDNS_MAX_NAME / 2) {
+				return(NULL);
+			}
+
+			if(cur >= pos) {
+				pos = cur + 2;
+			}
+
+			cur = (const uint8_t*)buf + (((cur[0] & 0x3f) << 8) | cur[1]);
+
+			if(cur >= pos) {
+				return(NULL);
+			}
+
+			continue;
+		}
+
+		if(*cur > 0x3f || cur + *cur + 1 > end) {
+			return(NULL);
+		}
+
+		for(len = *cur ++; len; -- len) {
+			*hash = __MDNS_HASH_STEP(*hash, *cur ++);
+		}
+
+		*hash = __MDNS_HASH_STEP(*hash, '.');
+	}
+
+	if(cur >= end) {
+		return(NULL);
+	}
+
+	/* skip terminating zero of uncompressed name */
+	if(!jumps) {
+		pos = cur + 1;
+	}
+
+	/* skip query header */
+	pos += sizeof(mdns_query_hdr_t);
+
+	return(pos > end ? NULL : pos);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int mdns_packet_is_query(const void* buf, size_t len)
+{
+	const mdns_hdr_t* hdr = buf;
+
+	/* only standard queries, RFC 6762 18.3 and 18.11 */
+	return(len >= sizeof(*hdr) && !(ntohs(hdr->flags) & 0xf80f) && hdr->qd_cnt);
+}
+
+/*------------------------------------------------------------------------*/
+
+int mdns_packet_prefilter(const void* buf, size_t len, mdns_name_filter filter, void* ctx)
+{
+	const mdns_hdr_t* hdr = buf;
+	const uint8_t *pos, *end, *name;
+	uint32_t hash;
+	int i;
+
+	if(!mdns_packet_is_query(buf, len)) {
+		return(0);
+	}
+
+	pos = (const uint8_t*)buf + sizeof(*hdr);
+	end = (const uint8_t*)buf + len;
+
+	for(i = ntohs(hdr->qd_cnt); i > 0; -- i) {
+		name = pos;
+
+		if(!(pos = mdns_question_skip(buf, pos, end, &hash))) {
+			return(0);
+		}
+
+		if(filter(ctx, hash, buf, len, name)) {
+			return(1);
+		}
+	}
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+const void* mdns_packet_name(const void* buf, size_t len, const void* pos, char* name, size_t size)
+{
+	return(mdns_name_unpack(buf, pos, (const uint8_t*)buf + len, name, size));
+}
+
+/*------------------------------------------------------------------------*/
+
+size_t mdns_packet_questions(const void* buf, size_t len)
+{
+	const mdns_hdr_t* hdr = buf;
+	const uint8_t *pos, *end;
+	uint32_t hash;
+	int i;
+
+	if(!mdns_packet_is_query(buf, len)) {
+		return(0);
+	}
+
+	pos = (const uint8_t*)buf + sizeof(*hdr);
+	end = (const uint8_t*)buf + len;
+
+	for(i = ntohs(hdr->qd_cnt); i > 0; -- i) {
+		if(!(pos = mdns_question_skip(buf, pos, end, &hash))) {
+			return(0);
+		}
+	}
+
+	return(pos - (const uint8_t*)buf);
+}
+
+/*------------------------------------------------------------------------*/
+
+/** max number of questions sorted at once, they are kept on stack */
+#ifdef MDNS_STATIC
+#define __MDNS_BATCH_QUESTIONS 64
+#else
+#define __MDNS_BATCH_QUESTIONS 256
+#endif
+
+/** question found in batch */
+typedef struct mdns_batch_question {
+	/** hash of name, see mdns_name_hash() */
+	uint32_t hash;
+
+	/** index of packet in batch */
+	uint32_t packet;
+
+	/** offset of encoded name in packet */
+	uint16_t name;
+
+	/** offset of query header in packet */
+	uint16_t hdr;
+} mdns_batch_question_t;
+
+/*------------------------------------------------------------------------*/
+
+static size_t mdns_batch_dispatch(const void* const* bufs, const size_t* lens, mdns_batch_question_t* q, size_t count, mdns_query_handler handler, void* const* ctxs)
+{
+	mdns_batch_question_t tmp;
+	char root[MDNS_MAX_NAME];
+	const uint8_t* buf;
+	size_t i, j;
+
+	/* insertion sort, batch is small */
+	for(i = 1; i < count; ++ i) {
+		tmp = q[i];
+
+		for(j = i; j > 0 && q[j - 1].hash > tmp.hash; -- j) {
+			q[j] = q[j - 1];
+		}
+
+		q[j] = tmp;
+	}
+
+	/* equal names are asked one after another */
+	for(i = 0; i < count; ++ i) {
+		if(i + 1 < count) {
+			__builtin_prefetch((const uint8_t*)bufs[q[i + 1].packet] + q[i + 1].name);
+		}
+
+		buf = bufs[q[i].packet];
+
+		if(mdns_name_unpack(buf, buf + q[i].name, buf + lens[q[i].packet], root, sizeof(root))) {
+			handler(ctxs[q[i].packet], (const mdns_query_hdr_t*)(buf + q[i].hdr), root);
+		}
+	}
+
+	return(count);
+}
+
+/*------------------------------------------------------------------------*/
+
+size_t mdns_packet_process_batch(const void* const* bufs, const size_t* lens, size_t count, const mdns_handlers_t* handlers, void* const* ctxs, size_t* results)
+{
+	mdns_batch_question_t questions[__MDNS_BATCH_QUESTIONS];
+	const uint8_t *buf, *pos, *next, *end;
+	char root[MDNS_MAX_NAME];
+	const mdns_hdr_t* hdr;
+	size_t i, n = 0, total = 0;
+	uint32_t hash;
+	int j;
+
+	for(i = 0; i < count; ++ i) {
+		/* header and questions of the next packet are loaded meanwhile */
+		if(i + 1 < count) {
+			__builtin_prefetch(bufs[i + 1]);
+			__builtin_prefetch((const uint8_t*)bufs[i + 1] + 64);
+		}
+
+		buf = bufs[i];
+		hdr = bufs[i];
+		end = buf + lens[i];
+		results[i] = 0;
+
+		/* offsets of questions are 16 bits */
+		if(lens[i] < sizeof(*hdr) || lens[i] > UINT16_MAX) {
+			continue;
+		}
+
+		pos = buf + sizeof(*hdr);
+
+		/* names are hashed without unpacking, handler is called after sorting */
+		for(j = ntohs(hdr->qd_cnt); j > 0; -- j) {
+			if(!(next = mdns_question_skip(buf, pos, end, &hash))) {
+				break;
+			}
+
+			if(handlers->q) {
+				if(n == __MDNS_BATCH_QUESTIONS) {
+					total += mdns_batch_dispatch(bufs, lens, questions, n, handlers->q, ctxs);
+					n = 0;
+				}
+
+				questions[n].hash = hash;
+				questions[n].packet = i;
+				questions[n].name = pos - buf;
+				questions[n].hdr = next - sizeof(mdns_query_hdr_t) - buf;
+				++ n;
+			}
+
+			pos = next;
+		}
+
+		/* records are handled in order of packet */
+		if(!j) {
+			pos = mdns_packet_records(buf, pos, end, handlers, ctxs[i], root);
+		}
+
+		results[i] = pos - buf;
+	}
+
+	if(n) {
+		total += mdns_batch_dispatch(bufs, lens, questions, n, handlers->q, ctxs);
+	}
+
+	return(total);
+}
+
+/*------------------------------------------------------------------------*/
+
+/** context of packet dump */
+typedef struct mdns_dump_ctx {
+	/** output */
+	mdns_dump_t* d;
+
+	/** filter or NULL */
+	const mdns_dump_filter_t* f;
+
+	/** prefix of the first line or NULL */
+	const char* label;
+
+	/** source address or NULL */
+	const struct sockaddr* from;
+
+	/** packet */
+	const void* buf;
 
-					break;
-				}
+	/** length of packet */
+	size_t len;
 
-				default: {
-					cur = pos + ntohs(answer_hdr->rd_len);
+	/** header is already dumped */
+	int shown;
+} mdns_dump_ctx_t;
 
-					/* call raw handler */
-					if(handlers->raw) {
-						handlers->raw(ctx, answer_hdr, root, pos, ntohs(answer_hdr->rd_len));
-					}
+/*------------------------------------------------------------------------*/
 
-					break;
-				}
-			}
+static void mdns_dump_header(mdns_dump_ctx_t* c)
+{
+	const struct sockaddr_in6* sin6 = (const struct sockaddr_in6*)c->from;
+	const struct sockaddr_in* sin = (const struct sockaddr_in*)c->from;
+	const mdns_hdr_t* hdr = c->buf;
+	char addr[INET6_ADDRSTRLEN];
 
-			pos += ntohs(answer_hdr->rd_len);
+	if(c->shown) {
+		return;
+	}
 
-			/* check for range */
-			if(pos != cur || pos > end) {
-				goto err;
-			}
-		}
+	c->shown = 1;
+
+	if(c->label && c->from && c->from->sa_family == AF_INET6) {
+		mdns_dump_printf(c->d, "%s from [%s]:%d, length: %zu\n", c->label,
+			inet_ntop(AF_INET6, &sin6->sin6_addr, addr, sizeof(addr)), ntohs(sin6->sin6_port), c->len);
+	} else if(c->label && c->from) {
+		mdns_dump_printf(c->d, "%s from %s:%d, length: %zu\n", c->label,
+			inet_ntop(AF_INET, &sin->sin_addr, addr, sizeof(addr)), ntohs(sin->sin_port), c->len);
+	} else if(c->label) {
+		mdns_dump_printf(c->d, "%s length: %zu\n", c->label, c->len);
 	}
 
-err:
-	return((uintptr_t)pos - (uintptr_t)buf);
+	if(sizeof(*hdr) > c->len) {
+		return;
+	}
+
+	mdns_dump_printf(c->d,
+		"     id: 0x%04x\n"
+		"  flags: 0x%04x\n"
+		"queries: 0x%04x\n"
+		"answers: 0x%04x\n"
+		"auth_rr: 0x%04x\n"
+		" add_rr: 0x%04x\n",
+		ntohs(hdr->id), ntohs(hdr->flags), ntohs(hdr->qd_cnt),
+		ntohs(hdr->an_cnt), ntohs(hdr->ns_cnt), ntohs(hdr->ar_cnt)
+	);
 }
 
 /*------------------------------------------------------------------------*/
 
 static void mdns_dump_query_handler(void* ctx, const mdns_query_hdr_t* h, const char* root)
 {
+	mdns_dump_ctx_t* c = ctx;
+
+	if(!mdns_dump_filter_record(c->f, root, ntohs(h->q_type))) {
+		return;
+	}
+
+	mdns_dump_header(c);
+
 	/* display query header */
-	printf("[Q] class: 0x%04x type: %s (0x%04x) [%s]\n",
+	mdns_dump_printf(c->d, "[Q] class: 0x%04x type: %s (0x%04x) [%s]\n",
 		ntohs(h->q_class), mdns_str_type(ntohs(h->q_type)), ntohs(h->q_type), root
 	);
 }
 
-static void mdns_dump_answer(const mdns_answer_hdr_t* h, const char* root)
+static int mdns_dump_answer(mdns_dump_ctx_t* c, const mdns_answer_hdr_t* h, const char* root)
 {
+	/* records are filtered before formatting */
+	if(!mdns_dump_filter_record(c->f, root, ntohs(h->a_type))) {
+		return(0);
+	}
+
+	mdns_dump_header(c);
+
 	/* display answer header */
-	printf("[A] class: 0x%04x type: %s (0x%04x) ttl: %u len: %u [%s] [",
+	mdns_dump_printf(c->d, "[A] class: 0x%04x type: %s (0x%04x) ttl: %u len: %u [%s] [",
 		ntohs(h->a_class), mdns_str_type(ntohs(h->a_type)),
 		ntohs(h->a_type), ntohl(h->a_ttl), ntohs(h->rd_len), root
 	);
+
+	return(1);
 }
 
 static void mdns_dump_answer_handler_a(void* ctx, const mdns_answer_hdr_t* h, const char* root, struct in_addr* in)
 {
-	mdns_dump_answer(h, root);
+	mdns_dump_ctx_t* c = ctx;
+	char addr[INET_ADDRSTRLEN];
+
+	if(!mdns_dump_answer(c, h, root)) {
+		return;
+	}
 
 	/* IPv4 address */
-	printf("%s]\n", inet_ntoa(*in));
+	mdns_dump_printf(c->d, "%s]\n", inet_ntop(AF_INET, in, addr, sizeof(addr)));
+}
+
+static void mdns_dump_answer_handler_aaaa(void* ctx, const mdns_answer_hdr_t* h, const char* root, struct in6_addr* in6)
+{
+	mdns_dump_ctx_t* c = ctx;
+	char addr[INET6_ADDRSTRLEN];
+
+	if(!mdns_dump_answer(c, h, root)) {
+		return;
+	}
+
+	/* IPv6 address */
+	mdns_dump_printf(c->d, "%s]\n", inet_ntop(AF_INET6, in6, addr, sizeof(addr)));
+}
+
+static void mdns_dump_answer_handler_ptr(void* ctx, const mdns_answer_hdr_t* h, const char* root, const char* ptr)
+{
+	mdns_dump_ctx_t* c = ctx;
+
+	if(!mdns_dump_answer(c, h, root)) {
+		return;
+	}
+
+	/* pointer */
+	mdns_dump_printf(c->d, "%s]\n", ptr);
 }
 
-static void mdns_dump_answer_handler_ptr_text(void* ctx, const mdns_answer_hdr_t* h, const char* root, const char* ptr)
+static void mdns_dump_answer_handler_text(void* ctx, const mdns_answer_hdr_t* h, const char* root, const mdns_text_t* text)
 {
-	mdns_dump_answer(h, root);
+	mdns_dump_ctx_t* c = ctx;
+	mdns_text_iter_t it;
+	const char* str;
+	size_t len;
+	int first = 1;
+
+	if(!mdns_dump_answer(c, h, root)) {
+		return;
+	}
+
+	/* strings are separated by spaces */
+	mdns_text_iter_init(&it, text);
+
+	while(mdns_text_next(&it, &str, &len) > 0) {
+		if(!first) {
+			mdns_dump_str(c->d, " ", 1);
+		}
+
+		mdns_dump_str(c->d, str, len);
+		first = 0;
+	}
 
-	/* text or pointer */
-	printf("%s]\n", ptr);
+	mdns_dump_printf(c->d, "]\n");
 }
 
 static void mdns_dump_answer_handler_srv(void* ctx, const mdns_answer_hdr_t* h, const char* root, mdns_record_srv_t* srv, const char* target)
 {
-	mdns_dump_answer(h, root);
+	mdns_dump_ctx_t* c = ctx;
+
+	if(!mdns_dump_answer(c, h, root)) {
+		return;
+	}
 
 	/* dump service */
-	printf("priority: %d weight: %d port: %d target: \"%s\"]\n",
+	mdns_dump_printf(c->d, "priority: %d weight: %d port: %d target: \"%s\"]\n",
 		ntohs(srv->priority), ntohs(srv->weight), ntohs(srv->port), target
 	);
 }
 
 static void mdns_dump_answer_handler_raw(void* ctx, const mdns_answer_hdr_t* h, const char* root, const void* buf, size_t len)
 {
-	mdns_dump_answer(h, root);
+	mdns_dump_ctx_t* c = ctx;
+
+	if(!mdns_dump_answer(c, h, root)) {
+		return;
+	}
 
 	/* unknown type, just print printable symbols */
-	strdump(buf, len);
-	printf("]\n");
+	mdns_dump_str(c->d, buf, len);
+	mdns_dump_printf(c->d, "]\n");
 }
 
-void mdns_packet_dump(const void* buf, size_t len)
+int mdns_packet_dump_to(mdns_dump_t* d, const mdns_dump_filter_t* f, int dir, const char* label, const struct sockaddr* from, const void* buf, size_t len)
 {
 	const mdns_hdr_t* hdr = buf;
-	size_t ret;
+	mdns_dump_ctx_t c;
+	size_t ret = 0;
 
 	mdns_handlers_t handlers = {
 		.q = mdns_dump_query_handler,
 		.a = mdns_dump_answer_handler_a,
-		.ptr = mdns_dump_answer_handler_ptr_text,
-		.text = mdns_dump_answer_handler_ptr_text,
+		.aaaa = mdns_dump_answer_handler_aaaa,
+		.ptr = mdns_dump_answer_handler_ptr,
+		.text = mdns_dump_answer_handler_text,
 		.srv = mdns_dump_answer_handler_srv,
 		.raw = mdns_dump_answer_handler_raw,
 	};
 
-	if(sizeof(*hdr) > len) {
-		ret = 0;
-		goto err;
+	/* nothing is parsed for skipped source or direction */
+	if(!mdns_dump_filter_packet(f, dir, from)) {
+		return(0);
 	}
 
-	/* print header */
-	printf("     id: 0x%04x\n", ntohs(hdr->id));
-	printf("  flags: 0x%04x\n", ntohs(hdr->flags));
-	printf("queries: 0x%04x\n", ntohs(hdr->qd_cnt));
-	printf("answers: 0x%04x\n", ntohs(hdr->an_cnt));
-	printf("auth_rr: 0x%04x\n", ntohs(hdr->ns_cnt));
-	printf(" add_rr: 0x%04x\n", ntohs(hdr->ar_cnt));
+	c.d = d;
+	c.f = f;
+	c.label = label;
+	c.from = from;
+	c.buf = buf;
+	c.len = len;
+	c.shown = 0;
+
+	/* without filter of records whole packet is dumped */
+	if(!f || (!f->names_count && !f->types_count)) {
+		mdns_dump_header(&c);
+	}
 
 	/* process mdns packet */
-	ret = mdns_packet_process(buf, len, &handlers, NULL);
-	if(ret != len) {
-		goto err;
+	if(sizeof(*hdr) <= len && (ret = mdns_packet_process(buf, len, &handlers, &c)) == len) {
+		goto done;
 	}
 
-	return;
+	if(c.shown) {
+		mdns_dump_printf(d, "failed to parse packet on offset 0x%zx (%p):\n",
+			ret, (void*)((uint8_t*)buf + ret)
+		);
 
-err:
-	printf("failed to parse packet on offset 0x%zx (%p):\n",
-		ret, (void*)((uint8_t*)buf + ret)
-	);
+		mdns_dump_hex(d, buf, len);
+	}
+
+done:
+	if(!c.shown) {
+		return(0);
+	}
+
+	/* one write per packet */
+	mdns_dump_flush(d);
+
+	return(1);
+}
+
+/*------------------------------------------------------------------------*/
+
+void mdns_packet_dump(const void* buf, size_t len)
+{
+	char text[MDNS_MAX_PACKET * 8];
+	mdns_dump_t d;
+
+	/* previous output of stdio goes first */
+	fflush(stdout);
+
+	mdns_dump_init(&d, text, sizeof(text), STDOUT_FILENO);
+	mdns_packet_dump_to(&d, NULL, MDNS_DUMP_IN, NULL, NULL, buf, len);
+}
+
+/*------------------------------------------------------------------------*/
+
+void mdns_text_iter_init(mdns_text_iter_t* it, const mdns_text_t* txt)
+{
+	it->pos = txt->data;
+	it->end = txt->data + txt->len;
+}
+
+/*------------------------------------------------------------------------*/
+
+int mdns_text_next(mdns_text_iter_t* it, const char** str, size_t* len)
+{
+	if(it->pos >= it->end) {
+		return(0);
+	}
+
+	/* string is out of rdata */
+	if(it->pos + *it->pos + 1 > it->end) {
+		it->pos = it->end;
+
+		return(-1);
+	}
+
+	*len = *it->pos;
+	*str = (const char*)it->pos + 1;
+	it->pos += *len + 1;
 
-	hexdump8(buf, len);
+	return(1);
+}
+
+/*------------------------------------------------------------------------*/
+
+int mdns_text_find(const mdns_text_t* txt, const char* key, const char** value, size_t* len)
+{
+	mdns_text_iter_t it;
+	const char* str;
+	size_t key_len, str_len;
+
+	key_len = strlen(key);
+
+	mdns_text_iter_init(&it, txt);
+
+	while(mdns_text_next(&it, &str, &str_len) > 0) {
+		if(str_len < key_len || strncasecmp(str, key, key_len)) {
+			continue;
+		}
+
+		/* boolean attribute */
+		if(str_len == key_len) {
+			*value = NULL;
+			*len = 0;
+
+			return(1);
+		}
+
+		if(str[key_len] == '=') {
+			*value = str + key_len + 1;
+			*len = str_len - key_len - 1;
+
+			return(1);
+		}
+	}
+
+	return(0);
 }
 
 /*------------------------------------------------------------------------*/
@@ -592,7 +1332,7 @@ int mdns_packet_add_answer_in(void* buf, size_t len, uint32_t ttl, const char* r
 
 	/* fill answer header */
 	answer_hdr = (mdns_answer_hdr_t*)buf;
-	answer_hdr->a_class = htons(MDNS_CLASS_IN);
+	answer_hdr->a_class = htons(MDNS_CLASS_IN | MDNS_CLASS_FLUSH);
 	answer_hdr->a_type = htons(MDNS_RECORD_A);
 	answer_hdr->a_ttl = htonl(ttl);
 	answer_hdr->rd_len = htons(sizeof(in));
@@ -617,6 +1357,56 @@ int mdns_packet_add_answer_in(void* buf, size_t len, uint32_t ttl, const char* r
 
 /*------------------------------------------------------------------------*/
 
+int mdns_packet_add_answer_in6(void* buf, size_t len, uint32_t ttl, const char* root, struct in6_addr in6)
+{
+	mdns_hdr_t* hdr = buf;
+	mdns_answer_hdr_t* answer_hdr;
+
+	/* we can't add query if another data present */
+	if(hdr->ns_cnt || hdr->ar_cnt) {
+		return(-1);
+	}
+
+	/* calculate end position in packet */
+	mdns_packet_current(&buf, &len);
+
+	/* pack root name */
+	if(!(buf = mdns_name_pack(buf, &len, root))) {
+		return(-1);
+	}
+
+	/* check free space for answer header */
+	if(sizeof(*answer_hdr) > len) {
+		return(-1);
+	}
+
+	/* fill answer header */
+	answer_hdr = (mdns_answer_hdr_t*)buf;
+	answer_hdr->a_class = htons(MDNS_CLASS_IN | MDNS_CLASS_FLUSH);
+	answer_hdr->a_type = htons(MDNS_RECORD_AAAA);
+	answer_hdr->a_ttl = htonl(ttl);
+	answer_hdr->rd_len = htons(sizeof(in6));
+	buf = (void*)((uintptr_t)buf + sizeof(*answer_hdr));
+	len -= sizeof(*answer_hdr);
+
+	/* check free space for in6 addr */
+	if(sizeof(in6) > len) {
+		return(-1);
+	}
+
+	/* put in6 addr */
+	memcpy(buf, &in6, sizeof(in6));
+	len -= sizeof(in6);
+
+	/* increment answer count */
+	hdr->flags = htons(ntohs(hdr->flags) | MDNS_FLAG_ANSWER);
+	hdr->an_cnt = htons(ntohs(hdr->an_cnt) + 1);
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
 int mdns_packet_add_answer_in_ptr(void* buf, size_t len, uint32_t ttl, const char* root, const char* name)
 {
 	mdns_hdr_t* hdr = buf;
@@ -663,10 +1453,12 @@ int mdns_packet_add_answer_in_ptr(void* buf, size_t len, uint32_t ttl, const cha
 
 /*------------------------------------------------------------------------*/
 
-int mdns_packet_add_answer_in_text(void* buf, size_t len, uint32_t ttl, const char* root, const char* text)
+int mdns_packet_add_answer_in_text(void* buf, size_t len, uint32_t ttl, const char* root, const mdns_text_pair_t* pairs, size_t count)
 {
 	mdns_hdr_t* hdr = buf;
 	mdns_answer_hdr_t* answer_hdr;
+	size_t i, key_len, value_len, str_len, rd_len;
+	uint8_t* pos;
 
 	/* we can't add answer if another data present */
 	if(hdr->ns_cnt || hdr->ar_cnt) {
@@ -688,18 +1480,44 @@ int mdns_packet_add_answer_in_text(void* buf, size_t len, uint32_t ttl, const ch
 
 	/* fill answer header */
 	answer_hdr = (mdns_answer_hdr_t*)buf;
-	answer_hdr->a_class = htons(MDNS_CLASS_IN);
+	answer_hdr->a_class = htons(MDNS_CLASS_IN | MDNS_CLASS_FLUSH);
 	answer_hdr->a_type = htons(MDNS_RECORD_TEXT);
 	answer_hdr->a_ttl = htonl(ttl);
-	answer_hdr->rd_len = htons(strlen(text) + 1); /* TODO: implement compress */
-	buf = (void*)((uintptr_t)buf + sizeof(*answer_hdr));
+	pos = (uint8_t*)answer_hdr + sizeof(*answer_hdr);
 	len -= sizeof(*answer_hdr);
 
-	/* put in text name */
-	if(!(buf = mdns_name_pack(buf, &len, text))) {
-		return(-1);
+	/* each pair is a length prefixed string "key=value" */
+	for(i = 0, rd_len = 0; i < count; ++ i) {
+		key_len = strlen(pairs[i].key);
+		value_len = pairs[i].value ? strlen(pairs[i].value) : 0;
+		str_len = key_len + (pairs[i].value ? value_len + 1 : 0);
+
+		if(!key_len || str_len > 0xff || rd_len + str_len + 1 > len) {
+			return(-1);
+		}
+
+		pos[rd_len ++] = str_len;
+		memcpy(&pos[rd_len], pairs[i].key, key_len);
+		rd_len += key_len;
+
+		if(pairs[i].value) {
+			pos[rd_len ++] = '=';
+			memcpy(&pos[rd_len], pairs[i].value, value_len);
+			rd_len += value_len;
+		}
+	}
+
+	/* empty TXT record has single empty string, RFC 6763 6.1 */
+	if(!count) {
+		if(!len) {
+			return(-1);
+		}
+
+		pos[rd_len ++] = 0;
 	}
 
+	answer_hdr->rd_len = htons(rd_len);
+
 	/* increment answer count */
 	hdr->flags = htons(ntohs(hdr->flags) | MDNS_FLAG_ANSWER);
 	hdr->an_cnt = htons(ntohs(hdr->an_cnt) + 1);
@@ -735,7 +1553,7 @@ int mdns_packet_add_answer_in_srv(void* buf, size_t len, uint32_t ttl, const cha
 
 	/* fill answer header */
 	answer_hdr = (mdns_answer_hdr_t*)buf;
-	answer_hdr->a_class = htons(MDNS_CLASS_IN);
+	answer_hdr->a_class = htons(MDNS_CLASS_IN | MDNS_CLASS_FLUSH);
 	answer_hdr->a_type = htons(MDNS_RECORD_SRV);
 	answer_hdr->a_ttl = htonl(ttl);
 	answer_hdr->rd_len = htons(sizeof(*srv) + strlen(name) + 1); /* TODO: implement compress */
@@ -761,3 +1579,123 @@ int mdns_packet_add_answer_in_srv(void* buf, size_t len, uint32_t ttl, const cha
 
 	return(0);
 }
+
+/*------------------------------------------------------------------------*/
+
+static int mdns_packet_add_rdata(void* buf, size_t len, mdns_section_t section, uint16_t a_class, uint32_t ttl, const char* root, uint16_t type, const void* rdata, size_t rd_len)
+{
+	mdns_hdr_t* hdr = buf;
+	mdns_answer_hdr_t* answer_hdr;
+
+	/* records of next sections can't be present */
+	if((section < MDNS_SECTION_AUTHORITY && hdr->ns_cnt) || (section < MDNS_SECTION_ADDITIONAL && hdr->ar_cnt)) {
+		return(-1);
+	}
+
+	/* calculate end position in packet */
+	mdns_packet_current(&buf, &len);
+
+	/* pack root name */
+	if(!(buf = mdns_name_pack(buf, &len, root))) {
+		return(-1);
+	}
+
+	/* check free space for answer header and rdata */
+	if(sizeof(*answer_hdr) + rd_len > len) {
+		return(-1);
+	}
+
+	/* fill answer header */
+	answer_hdr = (mdns_answer_hdr_t*)buf;
+	answer_hdr->a_class = htons(a_class);
+	answer_hdr->a_type = htons(type);
+	answer_hdr->a_ttl = htonl(ttl);
+	answer_hdr->rd_len = htons(rd_len);
+	buf = (void*)((uintptr_t)buf + sizeof(*answer_hdr));
+
+	/* put in rdata */
+	memcpy(buf, rdata, rd_len);
+
+	/* increment count of section */
+	switch(section) {
+		case MDNS_SECTION_ANSWER:
+			hdr->an_cnt = htons(ntohs(hdr->an_cnt) + 1);
+			break;
+
+		case MDNS_SECTION_AUTHORITY:
+			hdr->ns_cnt = htons(ntohs(hdr->ns_cnt) + 1);
+			break;
+
+		case MDNS_SECTION_ADDITIONAL:
+			hdr->ar_cnt = htons(ntohs(hdr->ar_cnt) + 1);
+			break;
+	}
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+int mdns_packet_add_record(void* buf, size_t len, mdns_section_t section, uint16_t a_class, uint32_t ttl, const char* root, uint16_t type, const void* rdata, size_t rd_len)
+{
+	mdns_hdr_t* hdr = buf;
+
+	if(mdns_packet_add_rdata(buf, len, section, a_class, ttl, root, type, rdata, rd_len)) {
+		return(-1);
+	}
+
+	/* probes carry authority records, but they are queries */
+	if(section != MDNS_SECTION_AUTHORITY) {
+		hdr->flags = htons(ntohs(hdr->flags) | MDNS_FLAG_ANSWER);
+	}
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+int mdns_packet_add_answer_rdata(void* buf, size_t len, uint32_t ttl, const char* root, uint16_t type, const void* rdata, size_t rd_len)
+{
+	return(mdns_packet_add_record(buf, len, MDNS_SECTION_ANSWER, MDNS_CLASS_IN, ttl, root, type, rdata, rd_len));
+}
+
+/*------------------------------------------------------------------------*/
+
+int mdns_packet_add_authority_rdata(void* buf, size_t len, uint32_t ttl, const char* root, uint16_t type, const void* rdata, size_t rd_len)
+{
+	return(mdns_packet_add_record(buf, len, MDNS_SECTION_AUTHORITY, MDNS_CLASS_IN, ttl, root, type, rdata, rd_len));
+}
+
+/*------------------------------------------------------------------------*/
+
+int mdns_packet_add_answer_encoded(void* buf, size_t len, const void* rr, size_t rr_len)
+{
+	mdns_hdr_t* hdr = buf;
+
+	/* we can't add answer if another data present */
+	if(hdr->ns_cnt || hdr->ar_cnt) {
+		return(-1);
+	}
+
+	/* calculate end position in packet */
+	mdns_packet_current(&buf, &len);
+
+	if(rr_len > len) {
+		return(-1);
+	}
+
+	memcpy(buf, rr, rr_len);
+
+	/* increment answer count */
+	hdr->flags = htons(ntohs(hdr->flags) | MDNS_FLAG_ANSWER);
+	hdr->an_cnt = htons(ntohs(hdr->an_cnt) + 1);
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+int mdns_packet_add_additional_rdata(void* buf, size_t len, uint32_t ttl, const char* root, uint16_t type, const void* rdata, size_t rd_len)
+{
+	return(mdns_packet_add_record(buf, len, MDNS_SECTION_ADDITIONAL, MDNS_CLASS_IN, ttl, root, type, rdata, rd_len));
+}